@@ -0,0 +1,36 @@
+#include "deletion.h"
+
+using namespace deletion;
+
+void deletion::init(queue& deletionQueue, timeline::scheduler& frameTimeline)
+{
+    deletionQueue.frameTimeline = &frameTimeline;
+    deletionQueue.entries.clear();
+}
+
+void deletion::push(queue& deletionQueue, std::function<void()> destroy)
+{
+    deletionQueue.entries.push_back({ deletionQueue.frameTimeline->submitted, std::move(destroy) });
+    deletionQueue.pushed++;
+}
+
+void deletion::collect(queue& deletionQueue)
+{
+    //values complete in submission order, the first entry still in use ends the sweep
+    while (!deletionQueue.entries.empty() && timeline::reached(*deletionQueue.frameTimeline, deletionQueue.entries.front().lastUse)) {
+        std::function<void()> destroy = std::move(deletionQueue.entries.front().destroy);
+        deletionQueue.entries.pop_front();
+        destroy();
+        deletionQueue.ran++;
+    }
+}
+
+void deletion::flush(queue& deletionQueue)
+{
+    while (!deletionQueue.entries.empty()) {
+        std::function<void()> destroy = std::move(deletionQueue.entries.front().destroy);
+        deletionQueue.entries.pop_front();
+        destroy();
+        deletionQueue.ran++;
+    }
+}
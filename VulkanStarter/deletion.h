@@ -0,0 +1,38 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <cstdint>
+
+#include "timeline.h"
+
+// Deferred destruction of objects the frames in flight may still be using. Work pushed to the queue is tagged with the
+// last timeline value submitted so far and runs once the GPU has reached it, so replacing a resource (a resized swap
+// chain, its attachments and framebuffers) never needs vkDeviceWaitIdle.
+namespace deletion
+{
+    struct entry
+    {
+        timeline::value lastUse;            // every submit that may use the object signals this value or an earlier one
+        std::function<void()> destroy;
+    };
+
+    struct queue
+    {
+        timeline::scheduler* frameTimeline = nullptr;
+        std::deque<entry> entries;          // in push order, so values never decrease
+        uint64_t pushed = 0;
+        uint64_t ran = 0;
+    };
+
+    void init(queue&, timeline::scheduler&);
+
+    // Destroys the object once everything submitted so far has executed, push it before anything new is submitted.
+    void push(queue&, std::function<void()> destroy);
+
+    // Runs the entries whose values the GPU has reached, never blocks.
+    void collect(queue&);
+
+    // Runs every entry, the device must be idle.
+    void flush(queue&);
+}
@@ -0,0 +1,350 @@
+#include <iostream>
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+
+#include "descriptors.h"
+
+using namespace descriptors;
+
+namespace
+{
+    void hashCombine(size_t& seed, size_t value)
+    {
+        seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    size_t hashContents(VkDescriptorSetLayout layout, const contents& bindings)
+    {
+        size_t seed = std::hash<const void*>()(reinterpret_cast<const void*>(layout));
+        for (const auto& entry : bindings) {
+            hashCombine(seed, entry.binding);
+            hashCombine(seed, entry.type);
+            for (const auto& buffer : entry.buffers) {
+                hashCombine(seed, std::hash<const void*>()(reinterpret_cast<const void*>(buffer.buffer)));
+                hashCombine(seed, static_cast<size_t>(buffer.offset));
+                hashCombine(seed, static_cast<size_t>(buffer.range));
+            }
+            for (const auto& image : entry.images) {
+                hashCombine(seed, std::hash<const void*>()(reinterpret_cast<const void*>(image.imageView)));
+                hashCombine(seed, std::hash<const void*>()(reinterpret_cast<const void*>(image.sampler)));
+                hashCombine(seed, image.imageLayout);
+            }
+        }
+        return seed;
+    }
+
+    bool sameContents(const contents& a, const contents& b)
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].binding != b[i].binding || a[i].type != b[i].type || a[i].buffers.size() != b[i].buffers.size() || a[i].images.size() != b[i].images.size()) {
+                return false;
+            }
+            for (size_t j = 0; j < a[i].buffers.size(); j++) {
+                const VkDescriptorBufferInfo& x = a[i].buffers[j];
+                const VkDescriptorBufferInfo& y = b[i].buffers[j];
+                if (x.buffer != y.buffer || x.offset != y.offset || x.range != y.range) {
+                    return false;
+                }
+            }
+            for (size_t j = 0; j < a[i].images.size(); j++) {
+                const VkDescriptorImageInfo& x = a[i].images[j];
+                const VkDescriptorImageInfo& y = b[i].images[j];
+                if (x.imageView != y.imageView || x.sampler != y.sampler || x.imageLayout != y.imageLayout) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool sameBindings(const std::vector<VkDescriptorSetLayoutBinding>& a, const std::vector<VkDescriptorSetLayoutBinding>& b)
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+
+        for (size_t i = 0; i < a.size(); i++) {
+            if (a[i].binding != b[i].binding || a[i].descriptorType != b[i].descriptorType || a[i].descriptorCount != b[i].descriptorCount
+                || a[i].stageFlags != b[i].stageFlags || a[i].pImmutableSamplers != b[i].pImmutableSamplers) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    poolSpace fullPool(const allocator& setAllocator)
+    {
+        poolSpace full;
+        full.sets = setAllocator.setsPerPool;
+        for (const auto& ratio : setAllocator.ratios) {
+            VkDescriptorPoolSize poolSize = {};
+            poolSize.type = ratio.type;
+            poolSize.descriptorCount = static_cast<uint32_t>(ratio.perSet * setAllocator.setsPerPool + 0.5f);
+            if (poolSize.descriptorCount > 0) {
+                full.descriptors.push_back(poolSize);
+            }
+        }
+        return full;
+    }
+
+    // Descriptors of each type a set of this layout takes from its pool.
+    std::vector<VkDescriptorPoolSize> layoutSizes(const layoutCache& layouts, VkDescriptorSetLayout layout)
+    {
+        for (const auto& cached : layouts.layouts) {
+            if (cached.layout != layout) {
+                continue;
+            }
+
+            std::vector<VkDescriptorPoolSize> sizes;
+            for (const auto& layoutBinding : cached.bindings) {
+                auto size = std::find_if(sizes.begin(), sizes.end(), [&layoutBinding](const VkDescriptorPoolSize& s) { return s.type == layoutBinding.descriptorType; });
+                if (size == sizes.end()) {
+                    sizes.push_back({ layoutBinding.descriptorType, layoutBinding.descriptorCount });
+                }
+                else {
+                    size->descriptorCount += layoutBinding.descriptorCount;
+                }
+            }
+            return sizes;
+        }
+        throw std::runtime_error("failed to allocate descriptor sets, the layout is not in the layout cache!");
+    }
+
+    bool fits(const poolSpace& space, const std::vector<VkDescriptorPoolSize>& sizes)
+    {
+        if (space.sets == 0) {
+            return false;
+        }
+        for (const auto& size : sizes) {
+            auto left = std::find_if(space.descriptors.begin(), space.descriptors.end(), [&size](const VkDescriptorPoolSize& s) { return s.type == size.type; });
+            if (size.descriptorCount > (left == space.descriptors.end() ? 0 : left->descriptorCount)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void take(poolSpace& space, const std::vector<VkDescriptorPoolSize>& sizes)
+    {
+        space.sets--;
+        for (const auto& size : sizes) {
+            for (auto& left : space.descriptors) {
+                if (left.type == size.type) {
+                    left.descriptorCount -= size.descriptorCount;
+                }
+            }
+        }
+    }
+
+    VkDescriptorPool createPool(allocator& setAllocator)
+    {
+        std::vector<VkDescriptorPoolSize> poolSizes = fullPool(setAllocator).descriptors;
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        poolInfo.maxSets = setAllocator.setsPerPool;
+
+        VkDescriptorPool pool;
+        if (vkCreateDescriptorPool(setAllocator.device, &poolInfo, nullptr, &pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create descriptor pool!");
+        }
+
+        setAllocator.stats.pools++;
+        return pool;
+    }
+}
+
+void descriptors::init(allocator& setAllocator, VkDevice device, const layoutCache& layouts, const std::vector<poolRatio>& ratios, uint32_t setsPerPool)
+{
+    setAllocator.device = device;
+    setAllocator.layouts = &layouts;
+    setAllocator.ratios = ratios;
+    setAllocator.setsPerPool = setsPerPool;
+    setAllocator.currentPool = 0;
+}
+
+void descriptors::destroy(allocator& setAllocator)
+{
+    for (auto pool : setAllocator.pools) {
+        vkDestroyDescriptorPool(setAllocator.device, pool, nullptr);
+    }
+    setAllocator.pools.clear();
+    setAllocator.space.clear();
+    setAllocator.cache.clear();
+    setAllocator.currentPool = 0;
+}
+
+VkDescriptorSet descriptors::allocate(allocator& setAllocator, VkDescriptorSetLayout layout)
+{
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &layout;
+
+    std::vector<VkDescriptorPoolSize> sizes = layoutSizes(*setAllocator.layouts, layout);
+    if (!fits(fullPool(setAllocator), sizes)) {
+        throw std::runtime_error("failed to allocate descriptor sets, the pool ratios cannot hold a single set!");
+    }
+
+    //a pool without room is never tried again until the next reset, the set goes to the first one that holds it
+    while (setAllocator.currentPool < setAllocator.pools.size() && !fits(setAllocator.space[setAllocator.currentPool], sizes)) {
+        setAllocator.currentPool++;
+    }
+    if (setAllocator.currentPool == setAllocator.pools.size()) {
+        setAllocator.pools.push_back(createPool(setAllocator));
+        setAllocator.space.push_back(fullPool(setAllocator));
+    }
+
+    allocInfo.descriptorPool = setAllocator.pools[setAllocator.currentPool];
+
+    VkDescriptorSet descriptorSet;
+    if (vkAllocateDescriptorSets(setAllocator.device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate descriptor sets!");
+    }
+
+    take(setAllocator.space[setAllocator.currentPool], sizes);
+    setAllocator.stats.sets++;
+    return descriptorSet;
+}
+
+VkDescriptorSet descriptors::get(allocator& setAllocator, VkDescriptorSetLayout layout, const contents& bindings)
+{
+    size_t hash = hashContents(layout, bindings);
+
+    std::vector<cachedSet>& bucket = setAllocator.cache[hash];
+    for (const auto& cached : bucket) {
+        if (cached.layout == layout && sameContents(cached.bindings, bindings)) {
+            setAllocator.stats.cacheHits++;
+            return cached.set;
+        }
+    }
+
+    setAllocator.stats.cacheMisses++;
+
+    cachedSet cached;
+    cached.layout = layout;
+    cached.bindings = bindings;
+    cached.set = allocate(setAllocator, layout);
+    write(setAllocator.device, cached.set, bindings);
+
+    bucket.push_back(cached);
+    return cached.set;
+}
+
+void descriptors::reset(allocator& setAllocator)
+{
+    for (auto pool : setAllocator.pools) {
+        vkResetDescriptorPool(setAllocator.device, pool, 0);
+    }
+    setAllocator.space.assign(setAllocator.pools.size(), fullPool(setAllocator));
+    setAllocator.cache.clear();
+    setAllocator.currentPool = 0;
+    setAllocator.stats.sets = 0;
+}
+
+allocator descriptors::detach(allocator& setAllocator)
+{
+    allocator detached;
+    detached.device = setAllocator.device;
+    detached.layouts = setAllocator.layouts;
+    detached.setsPerPool = setAllocator.setsPerPool;
+    detached.ratios = setAllocator.ratios;
+    detached.pools.swap(setAllocator.pools);
+    detached.space.swap(setAllocator.space);
+    detached.cache.swap(setAllocator.cache);
+    detached.currentPool = setAllocator.currentPool;
+
+    setAllocator.currentPool = 0;
+    setAllocator.stats.sets = 0;
+    return detached;
+}
+
+void descriptors::init(layoutCache& layouts, VkDevice device)
+{
+    layouts.device = device;
+}
+
+void descriptors::destroy(layoutCache& layouts)
+{
+    for (const auto& cached : layouts.layouts) {
+        vkDestroyDescriptorSetLayout(layouts.device, cached.layout, nullptr);
+    }
+    layouts.layouts.clear();
+}
+
+VkDescriptorSetLayout descriptors::getLayout(layoutCache& layouts, const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    for (const auto& cached : layouts.layouts) {
+        if (sameBindings(cached.bindings, bindings)) {
+            return cached.layout;
+        }
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+    layoutInfo.pBindings = bindings.data();
+
+    cachedLayout cached;
+    cached.bindings = bindings;
+    if (vkCreateDescriptorSetLayout(layouts.device, &layoutInfo, nullptr, &cached.layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    layouts.layouts.push_back(cached);
+    return cached.layout;
+}
+
+void descriptors::addBuffer(contents& bindings, uint32_t bindingIndex, VkDescriptorType type, const VkDescriptorBufferInfo& bufferInfo)
+{
+    binding entry;
+    entry.binding = bindingIndex;
+    entry.type = type;
+    entry.buffers.push_back(bufferInfo);
+    bindings.push_back(entry);
+}
+
+void descriptors::addImages(contents& bindings, uint32_t bindingIndex, VkDescriptorType type, const VkDescriptorImageInfo* imageInfos, uint32_t count)
+{
+    binding entry;
+    entry.binding = bindingIndex;
+    entry.type = type;
+    entry.images.assign(imageInfos, imageInfos + count);
+    bindings.push_back(entry);
+}
+
+void descriptors::write(VkDevice device, VkDescriptorSet descriptorSet, const contents& bindings)
+{
+    std::vector<VkWriteDescriptorSet> descriptorWrites(bindings.size());
+
+    for (size_t i = 0; i < bindings.size(); i++) {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = descriptorSet;
+        descriptorWrites[i].dstBinding = bindings[i].binding;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = bindings[i].type;
+        if (!bindings[i].buffers.empty()) {
+            descriptorWrites[i].descriptorCount = static_cast<uint32_t>(bindings[i].buffers.size());
+            descriptorWrites[i].pBufferInfo = bindings[i].buffers.data();
+        }
+        else {
+            descriptorWrites[i].descriptorCount = static_cast<uint32_t>(bindings[i].images.size());
+            descriptorWrites[i].pImageInfo = bindings[i].images.data();
+        }
+    }
+
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+void descriptors::printStats(const allocator& setAllocator, const char* name)
+{
+    std::cout << name << " descriptors: " << setAllocator.stats.sets << " sets in " << setAllocator.pools.size() << " pools ("
+        << setAllocator.stats.pools << " created), " << setAllocator.stats.cacheHits << " cache hits, " << setAllocator.stats.cacheMisses << " misses" << std::endl;
+}
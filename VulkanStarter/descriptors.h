@@ -0,0 +1,114 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// Descriptor sets grouped by how often they change. Layouts are deduplicated by their bindings. An allocator grows by
+// whole pools sized from per set ratios instead of one pool sized up front, and can release every set at once by
+// resetting its pools, which stay around for the next sets. Without VK_KHR_maintenance1 allocating past a pool's
+// capacity is undefined rather than an error, so the allocator counts what each pool has left and moves on itself.
+// Sets described by the same contents are shared through a cache, so identical sets (one per swap chain image with the
+// same buffers) collapse into one and a set is only written when its contents were never seen before.
+namespace descriptors
+{
+    const uint32_t SETS_PER_POOL = 32;
+
+    struct poolRatio
+    {
+        VkDescriptorType type;
+        float perSet;                       // descriptors of this type per set, on average
+    };
+
+    // Contents of one binding, buffers or images.
+    struct binding
+    {
+        uint32_t binding = 0;
+        VkDescriptorType type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        std::vector<VkDescriptorBufferInfo> buffers;
+        std::vector<VkDescriptorImageInfo> images;
+    };
+
+    typedef std::vector<binding> contents;
+
+    struct cachedSet
+    {
+        VkDescriptorSetLayout layout;
+        contents bindings;
+        VkDescriptorSet set;
+    };
+
+    // What a pool has left.
+    struct poolSpace
+    {
+        uint32_t sets = 0;
+        std::vector<VkDescriptorPoolSize> descriptors;
+    };
+
+    struct allocatorStats
+    {
+        uint32_t pools = 0;
+        uint32_t sets = 0;                  // allocated since the last reset
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
+    };
+
+    struct cachedLayout
+    {
+        std::vector<VkDescriptorSetLayoutBinding> bindings;
+        VkDescriptorSetLayout layout;
+    };
+
+    struct layoutCache
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        std::vector<cachedLayout> layouts;
+    };
+
+    struct allocator
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        const layoutCache* layouts = nullptr;   // where the descriptor counts of the sets' layouts are looked up
+        uint32_t setsPerPool = SETS_PER_POOL;
+        std::vector<poolRatio> ratios;
+        std::vector<VkDescriptorPool> pools;
+        std::vector<poolSpace> space;       // by pool
+        uint32_t currentPool = 0;           // pools before it are full, pools after it are empty
+        std::unordered_map<size_t, std::vector<cachedSet>> cache;   // by contents hash
+        allocatorStats stats;
+    };
+
+    // The layouts of the sets allocated must come from the layout cache.
+    void init(allocator&, VkDevice, const layoutCache&, const std::vector<poolRatio>&, uint32_t setsPerPool = SETS_PER_POOL);
+
+    void destroy(allocator&);
+
+    // Allocates an uncached set, for sets that are later updated in place. Grows a new pool when the current ones are full.
+    VkDescriptorSet allocate(allocator&, VkDescriptorSetLayout);
+
+    // Returns a set with these contents, allocating and writing it only when no cached set matches.
+    VkDescriptorSet get(allocator&, VkDescriptorSetLayout, const contents&);
+
+    // Releases every set of the allocator and empties its cache, none of them may still be in use.
+    void reset(allocator&);
+
+    // Moves the pools and cached sets into the returned allocator and leaves this one empty but usable, for releasing
+    // them once the frames still using the sets have finished. Stats stay with this allocator.
+    allocator detach(allocator&);
+
+    void init(layoutCache&, VkDevice);
+
+    void destroy(layoutCache&);
+
+    // Returns the layout for these bindings, created the first time they are seen.
+    VkDescriptorSetLayout getLayout(layoutCache&, const std::vector<VkDescriptorSetLayoutBinding>&);
+
+    void addBuffer(contents&, uint32_t binding, VkDescriptorType, const VkDescriptorBufferInfo&);
+    void addImages(contents&, uint32_t binding, VkDescriptorType, const VkDescriptorImageInfo* imageInfos, uint32_t count);
+
+    // Writes every binding of the contents into the set.
+    void write(VkDevice, VkDescriptorSet, const contents&);
+
+    void printStats(const allocator&, const char* name);
+}
@@ -0,0 +1,415 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <cmath>
+#include <emmintrin.h> //SSE2, baseline on every x64 target
+
+#include "furgen.h"
+#include "mipgen.h"
+
+using namespace furgen;
+
+namespace
+{
+    const uint32_t CACHE_MAGIC = 0x43525546; // "FURC"
+    const uint32_t CACHE_VERSION = 1;
+
+    struct strandList
+    {
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> length;
+    };
+
+    // Robert Jenkins' 32 bit integer hash on 4 lanes, only needs SSE2 adds, xors and shifts
+    inline __m128i hash4(__m128i a)
+    {
+        a = _mm_add_epi32(_mm_add_epi32(a, _mm_set1_epi32(0x7ed55d16)), _mm_slli_epi32(a, 12));
+        a = _mm_xor_si128(_mm_xor_si128(a, _mm_set1_epi32(static_cast<int>(0xc761c23c))), _mm_srli_epi32(a, 19));
+        a = _mm_add_epi32(_mm_add_epi32(a, _mm_set1_epi32(0x165667b1)), _mm_slli_epi32(a, 5));
+        a = _mm_xor_si128(_mm_add_epi32(a, _mm_set1_epi32(static_cast<int>(0xd3a2646c))), _mm_slli_epi32(a, 9));
+        a = _mm_add_epi32(_mm_add_epi32(a, _mm_set1_epi32(static_cast<int>(0xfd7046c5))), _mm_slli_epi32(a, 3));
+        a = _mm_xor_si128(_mm_xor_si128(a, _mm_set1_epi32(static_cast<int>(0xb55a4f09))), _mm_srli_epi32(a, 16));
+        return a;
+    }
+
+    // maps the top 24 bits of each hash to [0, 1)
+    inline __m128 unitFloat4(__m128i h)
+    {
+        return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(1.0f / 16777216.0f));
+    }
+
+    inline __m128i latticeKey4(__m128i x, __m128i y, uint32_t seed)
+    {
+        return _mm_xor_si128(_mm_add_epi32(x, _mm_slli_epi32(y, 16)), _mm_set1_epi32(static_cast<int>(seed)));
+    }
+
+    // wraps lattice coordinates equal to period back to 0 so the noise tiles
+    inline __m128i wrap4(__m128i i, __m128i period)
+    {
+        return _mm_and_si128(i, _mm_cmplt_epi32(i, period));
+    }
+
+    inline __m128 lerp4(__m128 a, __m128 b, __m128 t)
+    {
+        return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+    }
+
+    // Tileable value noise for 4 points, x and y in lattice units within [0, period)
+    __m128 valueNoise4(__m128 x, __m128 y, int period, uint32_t seed)
+    {
+        __m128i periodVec = _mm_set1_epi32(period);
+        __m128i ix0 = _mm_cvttps_epi32(x);
+        __m128i iy0 = _mm_cvttps_epi32(y);
+        __m128i ix1 = wrap4(_mm_add_epi32(ix0, _mm_set1_epi32(1)), periodVec);
+        __m128i iy1 = wrap4(_mm_add_epi32(iy0, _mm_set1_epi32(1)), periodVec);
+
+        __m128 tx = _mm_sub_ps(x, _mm_cvtepi32_ps(ix0));
+        __m128 ty = _mm_sub_ps(y, _mm_cvtepi32_ps(iy0));
+
+        // smoothstep fade
+        __m128 three = _mm_set1_ps(3.0f);
+        __m128 two = _mm_set1_ps(2.0f);
+        tx = _mm_mul_ps(_mm_mul_ps(tx, tx), _mm_sub_ps(three, _mm_mul_ps(two, tx)));
+        ty = _mm_mul_ps(_mm_mul_ps(ty, ty), _mm_sub_ps(three, _mm_mul_ps(two, ty)));
+
+        __m128 v00 = unitFloat4(hash4(latticeKey4(ix0, iy0, seed)));
+        __m128 v10 = unitFloat4(hash4(latticeKey4(ix1, iy0, seed)));
+        __m128 v01 = unitFloat4(hash4(latticeKey4(ix0, iy1, seed)));
+        __m128 v11 = unitFloat4(hash4(latticeKey4(ix1, iy1, seed)));
+
+        return lerp4(lerp4(v00, v10, tx), lerp4(v01, v11, tx), ty);
+    }
+
+    // Splits [0, count) into contiguous ranges, one per hardware thread
+    template<typename Function>
+    void parallelFor(uint32_t count, Function function)
+    {
+        uint32_t threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), count));
+        uint32_t chunk = (count + threadCount - 1) / threadCount;
+
+        std::vector<std::thread> threads;
+        for (uint32_t begin = 0; begin < count; begin += chunk) {
+            uint32_t end = std::min(begin + chunk, count);
+            threads.emplace_back(function, begin, end);
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // One strand per cell of a jittered grid, so coverage stays even at any density
+    strandList placeStrands(const furParams& params, uint32_t cells)
+    {
+        float cellSize = static_cast<float>(params.size) / static_cast<float>(cells);
+        int noisePeriod = std::max(1, static_cast<int>(std::lround(params.clumpScale)));
+        float noiseScale = static_cast<float>(noisePeriod) / static_cast<float>(params.size);
+
+        strandList strands;
+        strands.x.resize(static_cast<size_t>(cells) * cells);
+        strands.y.resize(static_cast<size_t>(cells) * cells);
+        strands.length.resize(static_cast<size_t>(cells) * cells);
+
+        parallelFor(cells, [&](uint32_t rowBegin, uint32_t rowEnd) {
+            for (uint32_t j = rowBegin; j < rowEnd; j++) {
+                for (uint32_t i = 0; i < cells; i += 4) {
+                    __m128i cellX = _mm_setr_epi32(i, i + 1, i + 2, i + 3);
+                    __m128i cellY = _mm_set1_epi32(j);
+                    __m128i key = latticeKey4(cellX, cellY, params.seed);
+
+                    // keep strands away from the cell border so neighbours rarely merge
+                    __m128 jitterX = _mm_add_ps(_mm_set1_ps(0.1f), _mm_mul_ps(_mm_set1_ps(0.8f), unitFloat4(hash4(key))));
+                    __m128 jitterY = _mm_add_ps(_mm_set1_ps(0.1f), _mm_mul_ps(_mm_set1_ps(0.8f), unitFloat4(hash4(_mm_xor_si128(key, _mm_set1_epi32(static_cast<int>(0x9e3779b9)))))));
+                    __m128 lengthRandom = unitFloat4(hash4(_mm_xor_si128(key, _mm_set1_epi32(static_cast<int>(0x85ebca6b)))));
+
+                    __m128 px = _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(cellX), jitterX), _mm_set1_ps(cellSize));
+                    __m128 py = _mm_mul_ps(_mm_add_ps(_mm_cvtepi32_ps(cellY), jitterY), _mm_set1_ps(cellSize));
+
+                    __m128 clump = valueNoise4(_mm_mul_ps(px, _mm_set1_ps(noiseScale)), _mm_mul_ps(py, _mm_set1_ps(noiseScale)), noisePeriod, params.seed ^ 0x27d4eb2f);
+
+                    __m128 one = _mm_set1_ps(1.0f);
+                    __m128 length = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(_mm_set1_ps(params.lengthVariance), lengthRandom)),
+                                               _mm_sub_ps(one, _mm_mul_ps(_mm_set1_ps(params.clumpStrength), clump)));
+                    length = _mm_min_ps(_mm_max_ps(length, _mm_setzero_ps()), one);
+
+                    alignas(16) float outX[4], outY[4], outLength[4];
+                    _mm_store_ps(outX, px);
+                    _mm_store_ps(outY, py);
+                    _mm_store_ps(outLength, length);
+
+                    for (uint32_t lane = 0; lane < 4 && i + lane < cells; lane++) {
+                        size_t index = static_cast<size_t>(j) * cells + i + lane;
+                        strands.x[index] = outX[lane];
+                        strands.y[index] = outY[lane];
+                        strands.length[index] = outLength[lane];
+                    }
+                }
+            }
+        });
+
+        return strands;
+    }
+
+    // Rasterizes the strands overlapping one texel row. Each strand is a cone: at shell height h its
+    // cross-section radius is strandRadius * (1 - h / length), so the stored height at distance d from
+    // the root centre is length * (1 - d / strandRadius) and strands thin out towards the tips.
+    void splatRow(const furParams& params, const strandList& strands, uint32_t cells, uint32_t y, std::vector<float>& height, std::vector<float>& coverage, int pad)
+    {
+        float size = static_cast<float>(params.size);
+        float cellSize = size / static_cast<float>(cells);
+        float radius = params.strandRadius;
+        float centreY = static_cast<float>(y) + 0.5f;
+        int cellCount = static_cast<int>(cells);
+
+        std::fill(height.begin(), height.end(), 0.0f);
+        std::fill(coverage.begin(), coverage.end(), 0.0f);
+
+        __m128 radiusVec = _mm_set1_ps(radius);
+        __m128 inverseRadius = _mm_set1_ps(1.0f / radius);
+        __m128 zero = _mm_setzero_ps();
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+
+        int firstRow = static_cast<int>(std::floor((centreY - radius) / cellSize)) - 1;
+        int lastRow = static_cast<int>(std::floor((centreY + radius) / cellSize)) + 1;
+
+        for (int row = firstRow; row <= lastRow; row++) {
+            // cell rows outside the texture wrap around, with their strands shifted by a full tile
+            int wrappedRow = ((row % cellCount) + cellCount) % cellCount;
+            float shiftY = static_cast<float>(row - wrappedRow) / static_cast<float>(cells) * size;
+
+            for (uint32_t i = 0; i < cells; i++) {
+                size_t index = static_cast<size_t>(wrappedRow) * cells + i;
+                float dy = centreY - (strands.y[index] + shiftY);
+                if (dy * dy >= radius * radius) {
+                    continue;
+                }
+
+                float sx = strands.x[index];
+                __m128 strandX = _mm_set1_ps(sx);
+                __m128 dy2 = _mm_set1_ps(dy * dy);
+                __m128 length = _mm_set1_ps(strands.length[index]);
+
+                int x0 = static_cast<int>(std::floor(sx - radius));
+                int x1 = static_cast<int>(std::ceil(sx + radius));
+                for (int x = x0; x <= x1; x += 4) {
+                    __m128 dx = _mm_sub_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets), strandX);
+                    __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), dy2));
+
+                    __m128 taper = _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(distance, inverseRadius)), zero);
+                    __m128 texelHeight = _mm_mul_ps(length, taper);
+                    __m128 texelCoverage = _mm_min_ps(_mm_max_ps(_mm_sub_ps(radiusVec, distance), zero), one); //one texel antialiased edge
+
+                    float* h = &height[x + pad];
+                    float* c = &coverage[x + pad];
+                    _mm_storeu_ps(h, _mm_max_ps(_mm_loadu_ps(h), texelHeight));
+                    _mm_storeu_ps(c, _mm_max_ps(_mm_loadu_ps(c), texelCoverage));
+                }
+            }
+        }
+
+        // fold the padding back onto the opposite edge so the map tiles horizontally
+        uint32_t width = params.size;
+        for (int i = 0; i < pad; i++) {
+            height[width + i] = std::max(height[width + i], height[i]);
+            coverage[width + i] = std::max(coverage[width + i], coverage[i]);
+            height[pad + i] = std::max(height[pad + i], height[pad + width + i]);
+            coverage[pad + i] = std::max(coverage[pad + i], coverage[pad + width + i]);
+        }
+    }
+
+    inline uint8_t toUnorm8(float value)
+    {
+        return static_cast<uint8_t>(std::lround(std::min(std::max(value, 0.0f), 1.0f) * 255.0f));
+    }
+
+    // Next level of the chain, filtered by mipgen
+    furMipLevel downsample(const furMipLevel& source)
+    {
+        furMipLevel level;
+        level.width = std::max(1u, source.width / 2);
+        level.height = std::max(1u, source.height / 2);
+        level.texels.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+        mipgen::downsample(source.texels.data(), source.width, source.height, level.texels.data(), false);
+
+        return level;
+    }
+
+    bool sameParams(const furParams& a, const furParams& b)
+    {
+        return a.size == b.size && a.density == b.density && a.strandRadius == b.strandRadius
+            && a.lengthVariance == b.lengthVariance && a.clumpScale == b.clumpScale
+            && a.clumpStrength == b.clumpStrength && a.seed == b.seed;
+    }
+
+    bool readCache(const std::string& path, const furParams& params, furTexture& texture)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        uint32_t magic = 0, version = 0, mipCount = 0;
+        furParams stored;
+        file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        file.read(reinterpret_cast<char*>(&version), sizeof(version));
+        file.read(reinterpret_cast<char*>(&stored), sizeof(stored));
+        file.read(reinterpret_cast<char*>(&mipCount), sizeof(mipCount));
+
+        // a hash collision or an older generator must never hand back the wrong map
+        if (!file || magic != CACHE_MAGIC || version != CACHE_VERSION || !sameParams(stored, params) || mipCount == 0 || mipCount > 32) {
+            return false;
+        }
+
+        texture.mips.resize(mipCount);
+        for (auto& level : texture.mips) {
+            file.read(reinterpret_cast<char*>(&level.width), sizeof(level.width));
+            file.read(reinterpret_cast<char*>(&level.height), sizeof(level.height));
+            if (!file || level.width == 0 || level.height == 0 || level.width > params.size || level.height > params.size) {
+                return false;
+            }
+
+            level.texels.resize(static_cast<size_t>(level.width) * level.height * 4);
+            file.read(reinterpret_cast<char*>(level.texels.data()), level.texels.size());
+        }
+
+        return static_cast<bool>(file);
+    }
+
+    void writeCache(const std::string& path, const furParams& params, const furTexture& texture)
+    {
+        // write beside the target and rename so a crash never leaves a truncated cache behind
+        std::string temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                std::cerr << "furgen: unable to write cache " << temporaryPath << std::endl;
+                return;
+            }
+
+            uint32_t mipCount = static_cast<uint32_t>(texture.mips.size());
+            file.write(reinterpret_cast<const char*>(&CACHE_MAGIC), sizeof(CACHE_MAGIC));
+            file.write(reinterpret_cast<const char*>(&CACHE_VERSION), sizeof(CACHE_VERSION));
+            file.write(reinterpret_cast<const char*>(&params), sizeof(params));
+            file.write(reinterpret_cast<const char*>(&mipCount), sizeof(mipCount));
+
+            for (const auto& level : texture.mips) {
+                file.write(reinterpret_cast<const char*>(&level.width), sizeof(level.width));
+                file.write(reinterpret_cast<const char*>(&level.height), sizeof(level.height));
+                file.write(reinterpret_cast<const char*>(level.texels.data()), level.texels.size());
+            }
+
+            if (!file) {
+                std::cerr << "furgen: failed writing cache " << temporaryPath << std::endl;
+                return;
+            }
+        }
+
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            std::cerr << "furgen: unable to replace cache " << path << ": " << error.message() << std::endl;
+        }
+    }
+}
+
+uint64_t furgen::hashParams(const furParams& params)
+{
+    // FNV-1a over each field, the struct has no padding but hashing fields keeps that from mattering
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    mix(&CACHE_VERSION, sizeof(CACHE_VERSION));
+    mix(&params.size, sizeof(params.size));
+    mix(&params.density, sizeof(params.density));
+    mix(&params.strandRadius, sizeof(params.strandRadius));
+    mix(&params.lengthVariance, sizeof(params.lengthVariance));
+    mix(&params.clumpScale, sizeof(params.clumpScale));
+    mix(&params.clumpStrength, sizeof(params.clumpStrength));
+    mix(&params.seed, sizeof(params.seed));
+    return hash;
+}
+
+furTexture furgen::generate(const furParams& params)
+{
+    if (params.size == 0 || (params.size & (params.size - 1)) != 0) {
+        throw std::runtime_error("fur map size must be a power of two!");
+    }
+    if (params.density <= 0.0f || params.strandRadius <= 0.0f) {
+        throw std::runtime_error("fur map density and strand radius must be positive!");
+    }
+
+    uint32_t cells = std::max(1u, static_cast<uint32_t>(std::lround(params.size * std::sqrt(params.density))));
+    strandList strands = placeStrands(params, cells);
+
+    furTexture texture;
+    texture.mips.resize(1);
+    furMipLevel& base = texture.mips[0];
+    base.width = params.size;
+    base.height = params.size;
+    base.texels.resize(static_cast<size_t>(params.size) * params.size * 4);
+
+    // padding covers the strand radius plus the overshoot of the last 4 wide SIMD chunk
+    int pad = static_cast<int>(std::ceil(params.strandRadius)) + 5;
+    if (static_cast<uint32_t>(pad) > params.size) {
+        throw std::runtime_error("fur strand radius is too large for the map size!");
+    }
+
+    parallelFor(params.size, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        std::vector<float> height(params.size + 2 * pad);
+        std::vector<float> coverage(params.size + 2 * pad);
+
+        for (uint32_t y = rowBegin; y < rowEnd; y++) {
+            splatRow(params, strands, cells, y, height, coverage, pad);
+
+            uint8_t* out = &base.texels[static_cast<size_t>(y) * params.size * 4];
+            for (uint32_t x = 0; x < params.size; x++) {
+                uint8_t h = toUnorm8(height[x + pad]);
+                out[x * 4 + 0] = h;
+                out[x * 4 + 1] = h;
+                out[x * 4 + 2] = h;
+                out[x * 4 + 3] = toUnorm8(coverage[x + pad]);
+            }
+        }
+    });
+
+    while (texture.mips.back().width > 1 || texture.mips.back().height > 1) {
+        texture.mips.push_back(downsample(texture.mips.back()));
+    }
+
+    return texture;
+}
+
+furTexture furgen::loadOrGenerate(const furParams& params, const std::string& cacheDirectory)
+{
+    std::ostringstream name;
+    name << cacheDirectory << "/furmap_" << std::hex << std::setw(16) << std::setfill('0') << hashParams(params) << ".bin";
+    std::string path = name.str();
+
+    furTexture texture;
+    if (readCache(path, params, texture)) {
+        return texture;
+    }
+
+    texture = generate(params);
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+    writeCache(path, params, texture);
+
+    return texture;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Procedural fur density map generator.
+// Texel layout (RGBA8 UNORM): RGB = strand height at this texel (0 = no hair, 1 = reaches the last shell),
+// A = strand coverage. Shells sample R against their layer height and use A as their opacity.
+namespace furgen
+{
+    struct furParams
+    {
+        uint32_t size = 1024;           // width and height of mip 0, must be a power of two
+        float density = 0.08f;          // strands per texel
+        float strandRadius = 1.6f;      // strand radius at the root, in texels
+        float lengthVariance = 0.35f;   // random per-strand length reduction (0 = all strands full length)
+        float clumpScale = 16.0f;       // noise lattice cells across the texture, controls clumping of long/short hair
+        float clumpStrength = 0.5f;     // how much the clump noise shortens strands
+        uint32_t seed = 1337;
+    };
+
+    struct furMipLevel
+    {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> texels;    // width * height * 4 bytes
+    };
+
+    struct furTexture
+    {
+        std::vector<furMipLevel> mips;  // full chain down to 1x1
+    };
+
+    // Generates the density map and its mip chain on all available hardware threads.
+    furTexture generate(const furParams&);
+
+    // Returns the cached map for these parameters from cacheDirectory, generating and writing it if missing or stale.
+    furTexture loadOrGenerate(const furParams&, const std::string& cacheDirectory);
+
+    // Stable 64-bit key of the parameters, used to name the cache file.
+    uint64_t hashParams(const furParams&);
+}
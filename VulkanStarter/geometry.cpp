@@ -0,0 +1,95 @@
+#include <stdexcept>
+#include <cstring>
+
+#include "geometry.h"
+
+using namespace geometry;
+
+namespace
+{
+    void createDeviceBuffer(VkDevice device, memalloc::allocator& memoryAllocator, VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer& buffer, memalloc::allocation& memory)
+    {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create geometry buffer!");
+        }
+
+        memory = memalloc::allocateForBuffer(memoryAllocator, buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    }
+}
+
+void geometry::init(pool& geometryPool, VkDeviceSize vertexStride)
+{
+    geometryPool = pool();
+    geometryPool.vertexStride = vertexStride;
+}
+
+mesh geometry::add(pool& geometryPool, const void* vertices, uint32_t vertexCount, const std::vector<uint32_t>& indices)
+{
+    if (geometryPool.vertexBuffer != VK_NULL_HANDLE) {
+        throw std::runtime_error("cannot add meshes to a built geometry pool!");
+    }
+
+    mesh added;
+    added.vertexOffset = static_cast<int32_t>(geometryPool.vertexCount);
+    added.vertexCount = vertexCount;
+    added.firstIndex = geometryPool.indexCount;
+    added.indexCount = static_cast<uint32_t>(indices.size());
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(vertices);
+    geometryPool.vertexData.insert(geometryPool.vertexData.end(), bytes, bytes + vertexCount * geometryPool.vertexStride);
+    geometryPool.indexData.insert(geometryPool.indexData.end(), indices.begin(), indices.end());
+
+    geometryPool.vertexCount += vertexCount;
+    geometryPool.indexCount += added.indexCount;
+
+    return added;
+}
+
+void geometry::build(pool& geometryPool, VkDevice device, memalloc::allocator& memoryAllocator, upload::context& uploadContext, VkBufferUsageFlags extraVertexUsage)
+{
+    if (geometryPool.vertexCount == 0 || geometryPool.indexCount == 0) {
+        throw std::runtime_error("geometry pool is empty!");
+    }
+
+    VkDeviceSize vertexSize = geometryPool.vertexData.size();
+    VkDeviceSize indexSize = sizeof(uint32_t) * geometryPool.indexData.size();
+
+    createDeviceBuffer(device, memoryAllocator, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | extraVertexUsage, geometryPool.vertexBuffer, geometryPool.vertexMemory);
+    createDeviceBuffer(device, memoryAllocator, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, geometryPool.indexBuffer, geometryPool.indexMemory);
+
+    upload::copyToBuffer(uploadContext, geometryPool.vertexData.data(), vertexSize, geometryPool.vertexBuffer, 0);
+    upload::copyToBuffer(uploadContext, geometryPool.indexData.data(), indexSize, geometryPool.indexBuffer, 0);
+
+    //the upload context copied them into staging memory
+    std::vector<uint8_t>().swap(geometryPool.vertexData);
+    std::vector<uint32_t>().swap(geometryPool.indexData);
+}
+
+void geometry::destroy(pool& geometryPool, VkDevice device, memalloc::allocator& memoryAllocator)
+{
+    vkDestroyBuffer(device, geometryPool.vertexBuffer, nullptr);
+    memalloc::free(memoryAllocator, geometryPool.vertexMemory);
+    vkDestroyBuffer(device, geometryPool.indexBuffer, nullptr);
+    memalloc::free(memoryAllocator, geometryPool.indexMemory);
+
+    geometryPool.vertexBuffer = VK_NULL_HANDLE;
+    geometryPool.indexBuffer = VK_NULL_HANDLE;
+}
+
+void geometry::bind(const pool& geometryPool, VkCommandBuffer commandBuffer)
+{
+    VkDeviceSize offset = 0;
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &geometryPool.vertexBuffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, geometryPool.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void geometry::draw(const mesh& drawn, VkCommandBuffer commandBuffer, uint32_t instanceCount)
+{
+    vkCmdDrawIndexed(commandBuffer, drawn.indexCount, instanceCount, drawn.firstIndex, drawn.vertexOffset, 0);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+#include "memalloc.h"
+#include "upload.h"
+
+// Static geometry pool. Every static mesh shares one device local vertex buffer and one index buffer,
+// so a command buffer binds them once and selects meshes with firstIndex / vertexOffset in the draw.
+// Meshes are added on the host, then the pool is uploaded in one go by build().
+namespace geometry
+{
+    struct mesh
+    {
+        int32_t vertexOffset = 0;       // first vertex of the mesh, the vertexOffset of its draws
+        uint32_t vertexCount = 0;
+        uint32_t firstIndex = 0;
+        uint32_t indexCount = 0;        // indices are local to the mesh
+    };
+
+    struct pool
+    {
+        VkDeviceSize vertexStride = 0;
+        std::vector<uint8_t> vertexData;    // host copies, released by build()
+        std::vector<uint32_t> indexData;
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0;
+
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        memalloc::allocation vertexMemory;
+        memalloc::allocation indexMemory;
+    };
+
+    // Starts an empty pool of vertices that are vertexStride bytes each.
+    void init(pool&, VkDeviceSize vertexStride);
+
+    // Appends a mesh, vertices points at vertexCount vertices of the pool's stride.
+    mesh add(pool&, const void* vertices, uint32_t vertexCount, const std::vector<uint32_t>& indices);
+
+    // Creates the device local buffers and records their upload, extraVertexUsage is added to the vertex buffer usage.
+    void build(pool&, VkDevice, memalloc::allocator&, upload::context&, VkBufferUsageFlags extraVertexUsage);
+
+    void destroy(pool&, VkDevice, memalloc::allocator&);
+
+    // Binds the pool's vertex buffer to binding 0 and its index buffer.
+    void bind(const pool&, VkCommandBuffer);
+
+    // Records an indexed draw of the mesh.
+    void draw(const mesh&, VkCommandBuffer, uint32_t instanceCount);
+}
@@ -26,9 +26,27 @@
 #include <set>
 #include <array>
 #include <chrono>
+#include <thread>
 #include <unordered_map>
 
 #include "diredge.h"
+#include "furgen.h"
+#include "memalloc.h"
+#include "upload.h"
+#include "geometry.h"
+#include "texstream.h"
+#include "texcompress.h"
+#include "materials.h"
+#include "vtex.h"
+#include "uniforms.h"
+#include "descriptors.h"
+#include "pipecache.h"
+#include "pipelines.h"
+#include "timeline.h"
+#include "deletion.h"
+#include "recorder.h"
+#include "rendergraph.h"
+#include "packets.h"
 #include "imgui/imgui.h"
 #include "imgui/imgui.cpp"
 #include "imgui/imgui_impl_vulkan.h"
@@ -51,14 +69,47 @@ const std::string MODEL_PATH = "models/bunny.obj";
 const std::string TEXTURE_PATH = "textures/furmap.gif";
 const std::string FIN_TEXTURE_PATH = "textures/fin.png";
 
-const int MAX_FRAMES_IN_FLIGHT = 2;
+const bool PROCEDURAL_FUR = true; //generates the fur density map with furgen instead of loading TEXTURE_PATH
+const std::string FUR_CACHE_DIRECTORY = "textures/cache"; //generated maps are cached here, keyed by their parameters
+const std::string TEXTURE_CACHE_DIRECTORY = "textures/cache"; //block compressed KTX2 assets, transcoded on first run
+const std::string PIPELINE_CACHE_PATH = "shaders/cache/pipelines.bin"; //driver pipeline cache, rewritten on exit
+
+const uint32_t FRAMES_IN_FLIGHT = 2; //frames recorded ahead of the GPU, deeper pacing trades latency for fewer waits
+const uint32_t FRAME_PACKETS = 2; //packets between the simulation and render threads, one is drawn while the next is built
+
+const VkDeviceSize UPLOAD_ARENA_SIZE = 32 * 1024 * 1024; //staging memory reused by every upload batch
+const bool BATCHED_UPLOADS = true; //false submits and waits after every copy, for comparing startup times
+
+const VkDeviceSize TEXTURE_BUDGET = 64 * 1024 * 1024; //device memory for streamed texture levels
+const VkDeviceSize TEXTURE_UPLOAD_BYTES_PER_FRAME = 8 * 1024 * 1024; //streamed levels staged per frame, bounds the hitch of an upgrade
+
+const bool VIRTUAL_TEXTURING = false; //samples the fur map through the virtual texture page cache instead of the texture table
+const uint32_t VIRTUAL_FUR_SIZE = 16384; //the fur map is repeated across a virtual texture this wide
+const std::string VIRTUAL_FUR_PATH = "textures/cache/furmap_virtual.vtex"; //tiled on first run
+const uint32_t VIRTUAL_CACHE_SLOTS = 32; //32x32 resident pages, a 4096x4096 RGBA8 cache
+
+const int SHADOW_PCF_RADIUS = 1; //3x3 shadow map taps, specialized into every base pass variant
+
+const VkFormat OIT_ACCUM_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT; //weighted premultiplied color sum and weight sum
+const VkFormat OIT_REVEALAGE_FORMAT = VK_FORMAT_R16_SFLOAT; //product of (1 - alpha) over all transparent fragments
+const bool RENDER_FINS = false; //the silhouette draw is disabled, so the render graph culls the empty fin pass
+
+const uint32_t GRASS_PATCHES_PER_SIDE = 512; //262144 grass patches across the ground plane
+const uint32_t GRASS_PATCH_COUNT = GRASS_PATCHES_PER_SIDE * GRASS_PATCHES_PER_SIDE;
+const uint32_t GRASS_SHELL_CAPACITY = 1 << 21; //visible patch layers a single frame can draw
+const uint32_t GRASS_MAX_SHELLS = 16; //shells on patches closer than GRASS_LOD_NEAR
+const uint32_t GRASS_MIN_SHELLS = 4; //shells on patches at GRASS_LOD_FAR
+const float GRASS_LOD_NEAR = 30.0f;
+const float GRASS_LOD_FAR = 200.0f; //patches further than this are not drawn
+const float GRASS_BLADE_HEIGHT = 1.5f; //specialized into grass.vert
 
 const std::vector<const char*> validationLayers = { //includes useful standard validation
 	"VK_LAYER_KHRONOS_validation"
 };
 
 const std::vector<const char*> deviceExtensions = { //declares a list of required device extensions
-	VK_KHR_SWAPCHAIN_EXTENSION_NAME
+	VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+	VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME //paces the frames and uploads
 };
 
 #ifdef NDEBUG //checks whether program is being compiled in debug mode or not (NDEBUG = not debug mode)
@@ -87,6 +138,7 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance, VkDebugUtilsMessengerEXT
 struct QueueFamilyIndices {
 	std::optional<uint32_t> graphicsFamily; //optional value to store the graphics queue family
 	std::optional<uint32_t> presentFamily; //optional value to store the presentation queue family
+	std::optional<uint32_t> transferFamily; //transfer only queue family, uploads use the graphics queue when there is none
 
 	bool isComplete() { //function to check for the existence of both graphics and presentation queue families 
 		return graphicsFamily.has_value() && presentFamily.has_value(); //returns true if both queue families exist
@@ -149,8 +201,10 @@ struct UniformBufferObject {
 	alignas(16) glm::mat4 model;
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 proj;
-	alignas(4) float renderTex;
 	alignas(16) glm::mat4 mvp;
+	alignas(16) glm::mat4 normalMatrix; //inverse transpose of the model matrix, once per frame instead of per vertex
+	alignas(16) glm::vec3 eyePosition;
+	alignas(16) glm::vec3 lightVector; //light position transformed by the view, read by the base pass fragment stage
 };
 
 glm::mat4 biasMatrix(
@@ -166,7 +220,6 @@ struct ShadowBufferObject {
 	alignas(16) glm::mat4 proj;
 	alignas(16) glm::mat4 mvp;
 	alignas(16) glm::mat4 biasmvp;
-	alignas(4) float renderMap;
 };
 
 struct LightingConstants {
@@ -177,6 +230,63 @@ struct LightingConstants {
 	alignas(4) float lightSpecularExponent;
 };
 
+struct DrawConstants {
+	alignas(4) float currentLayer; //shell and fin vertex stages
+	alignas(4) uint32_t material; //index into the material buffer, read by the fragment stages
+};
+
+struct GrassPatch {
+	glm::vec4 positionScale; //xyz patch centre on the ground, w uniform scale
+	glm::vec4 rotationOffset; //xy cos/sin of the yaw, zw texture coordinate offset
+};
+
+struct GrassCullObject {
+	alignas(16) glm::vec4 frustumPlanes[6];
+	alignas(16) glm::vec4 cameraPosition;
+	alignas(4) float patchRadius;
+	alignas(4) float lodNear;
+	alignas(4) float lodFar;
+	alignas(4) uint32_t maxShells;
+	alignas(4) uint32_t minShells;
+	alignas(4) uint32_t patchCount;
+	alignas(4) uint32_t capacity;
+};
+
+struct FurDynamicsObject {
+	alignas(16) glm::mat4 model;
+	alignas(16) glm::mat4 prevModel;
+	alignas(16) glm::mat4 olderModel; //the transform before prevModel
+	alignas(16) glm::vec4 gravity;
+	alignas(16) glm::vec4 wind;
+	alignas(4) float deltaTime;
+	alignas(4) float prevDeltaTime; //between olderModel and prevModel
+	alignas(4) float stiffness;
+	alignas(4) float damping;
+	alignas(4) float inertia;
+	alignas(4) float maxOffset;
+	alignas(4) uint32_t vertexCount;
+};
+
+//everything the render thread needs from one simulation step, built on the main thread and never changed afterwards
+struct FramePacket {
+	UniformBufferObject ubo; //camera and object transforms
+	ShadowBufferObject shadow; //light transforms
+	LightingConstants lighting;
+	FurDynamicsObject furDynamics;
+	GrassCullObject grassCull;
+
+	bool renderTexture;
+	bool renderLighting;
+	bool renderShadowMap;
+	bool renderGrass;
+
+	VkExtent2D framebufferExtent; //the window when the packet was built, sizes swap chains the surface leaves open
+	bool framebufferResized;
+
+	std::vector<ImDrawList*> uiDrawLists; //copies of the UI's draw lists, ImGui reuses its own for the next frame
+	ImDrawData uiDrawData; //points at uiDrawLists
+};
+
 namespace std {
 	template<> struct hash<Vertex> {
 		size_t operator()(Vertex const& vertex) const {
@@ -205,94 +315,154 @@ private:
 
 	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE; //creates the physical device object and sets to null
 	VkDevice device; //creates the device object
+	bool textureCompressionBC = false; //BC formats enabled on the device
+	memalloc::allocator memoryAllocator; //pools device memory for every buffer and image
+	upload::context uploadContext; //batches staging copies and layout transitions into one submit
 
 	VkQueue graphicsQueue; //creates the graphics queue
 	VkQueue presentQueue; //creates the presentation queue
+	VkQueue transferQueue; //dedicated transfer queue for uploads, the graphics queue when the device has none
+	uint32_t graphicsFamily;
+	uint32_t transferFamily;
 
 	VkSwapchainKHR swapChain; //creates the swap chain object
 	std::vector<VkImage> swapChainImages; //creates the vector of swap chain images
 	VkFormat swapChainImageFormat;
 	VkExtent2D swapChainExtent;
 	std::vector<VkImageView> swapChainImageViews; //creates the vector of swap chain image views
-	std::vector<VkFramebuffer> swapChainFramebuffers; //creates the vector of swap chain image buffers
-
-	VkRenderPass renderPass; //creates the render pass
-	VkDescriptorSetLayout descriptorSetLayout; //creates the object to contain the descriptor bindings
-	VkPipelineLayout pipelineLayout; //creates the pipeline layout
-	VkPipeline basePipeline; //creates the graphics pipeline
-	VkPipeline shellPipeline; //creates the shell pipeline
-	VkPipeline finPipeline; //creates the fin pipeline
-	VkPipeline shadowPipeline; //creates the shadow pipeline
-
-	struct FrameBufferAttachment {
-		VkImage image;
-		VkDeviceMemory memory;
-		VkImageView view;
-	};
 
-	struct shadowPass {
-		VkFramebuffer frameBuffer;
-		FrameBufferAttachment depth;
-		VkRenderPass renderPass;
-		VkSampler depthSampler;
-	} shadowPass;
-
-	VkCommandPool commandPool; //creates the command pool
-
-	VkImage depthImage;
-	VkDeviceMemory depthImageMemory;
-	VkImageView depthImageView;
-
-	VkImage textureImage;
-	VkImage textureImageFin;
-	VkDeviceMemory textureImageMemory;
-	VkDeviceMemory textureImageFinMemory;
-	VkImageView textureImageView;
-	VkImageView textureImageFinView;
+	rendergraph::graph frameGraph; //the render passes, their framebuffers and the swap chain sized attachments
+	rendergraph::resource swapChainTarget;
+	rendergraph::resource depthTarget;
+	rendergraph::resource shadowMap;
+	rendergraph::resource oitAccum; //OIT accumulation and revealage, only live inside the main render pass
+	rendergraph::resource oitRevealage;
+	uint32_t shadowNode; //passes of the frame graph
+	uint32_t baseNode;
+	uint32_t finNode;
+	uint32_t shellNode;
+	uint32_t resolveNode;
+	pipecache::cache pipelineCache; //shared by every pipeline, persisted between runs
+	descriptors::layoutCache setLayouts; //every descriptor set layout, deduplicated by bindings
+	VkDescriptorSetLayout staticSetLayout; //set 0, materials and scene buffers, written once
+	VkDescriptorSetLayout frameSetLayout; //set 1, uniforms and swap chain sized attachments
+	VkPipelineLayout pipelineLayout; //shared by every graphics pipeline
+	pipelines::registry pipelineRegistry; //compiles the graphics pipelines on worker threads
+	std::array<pipelines::handle, 8> basePipelines; //one base pass variant per texturing, lighting and shadow view toggle
+	pipelines::handle shellPipeline; //the shell pipeline
+	pipelines::handle finPipeline; //the fin pipeline
+	pipelines::handle shadowPipeline; //the shadow pipeline
+	pipelines::handle oitResolvePipeline; //the OIT resolve pipeline
+
+	VkDescriptorSetLayout furDynamicsDescriptorSetLayout; //creates the layout for the fur simulation bindings
+	VkPipelineLayout furDynamicsPipelineLayout; //creates the fur simulation pipeline layout
+	VkPipeline furDynamicsPipeline; //creates the fur simulation compute pipeline
+
+	pipelines::handle grassPipeline; //the instanced grass shell pipeline
+	VkDescriptorSetLayout grassCullDescriptorSetLayout; //creates the layout for the grass culling bindings
+	VkPipelineLayout grassCullPipelineLayout; //creates the grass culling pipeline layout
+	VkPipeline grassCullPipeline; //creates the grass culling compute pipeline
+
+	VkSampler shadowSampler; //reads the shadow map in the base pass
+
+	std::vector<VkCommandPool> commandPools; //one per frame in flight, reset as a whole once its last frame has completed
+
+	texstream::streamer textureStreamer;
+	uint32_t furTexture;
+	uint32_t finTexture;
 	VkSampler textureSampler;
+	materials::library materialLibrary; //texture table, atlas pages and the material buffer
+	uint32_t furMaterial;
+	uint32_t finMaterial;
+	vtex::pager virtualTextures; //page cache, page table and feedback of the virtual textures
 
 	std::vector<Vertex> vertices;
 	std::vector<Vertex> quadVertices;
 	std::vector<uint32_t> indices;
 	std::vector<uint32_t> quadIndices;
-	std::vector<VkBuffer> vertexBuffers;
-	std::vector<VkBuffer> quadVertexBuffers;
-	std::vector<VkDeviceMemory> vertexBuffersMemory;
-	std::vector<VkDeviceMemory> quadVertexBuffersMemory;
-	std::vector<VkBuffer> indexBuffers;
-	std::vector<VkBuffer> quadIndexBuffers;
-	std::vector<VkDeviceMemory> indexBuffersMemory;
-	std::vector<VkDeviceMemory> quadIndexBuffersMemory;
-
-	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
-
-	std::vector<VkBuffer> shadowUniformBuffers;
-	std::vector<VkDeviceMemory> shadowUniformBuffersMemory;
-
-	std::vector<VkBuffer> lightingBuffers;
-	std::vector<VkDeviceMemory> lightingBuffersMemory;
-
-	VkDescriptorPool descriptorPool;
+	geometry::pool geometryPool; //one vertex and one index buffer shared by every static mesh and swap chain image
+	geometry::mesh modelMesh;
+	geometry::mesh silhouetteMesh;
+	geometry::mesh grassPatchMesh;
+
+	uniforms::ring uniformRing; //every uniform block, one slice per frame in flight
+	uint32_t uboBlock;
+	uint32_t shadowBlock;
+	uint32_t lightingBlock;
+	uint32_t furDynamicsBlock;
+	uint32_t grassCullBlock;
+
+	VkBuffer furStateBuffer;
+	memalloc::allocation furStateBufferMemory;
+
+	VkBuffer grassPatchBuffer;
+	memalloc::allocation grassPatchBufferMemory;
+	VkBuffer grassShellBuffer;
+	memalloc::allocation grassShellBufferMemory;
+	VkBuffer grassDrawBuffer;
+	memalloc::allocation grassDrawBufferMemory;
+	float grassPatchRadius;
+
+	descriptors::allocator staticDescriptors; //lives as long as the device
+	descriptors::allocator swapChainDescriptors; //its pools are released with the swap chain they were allocated for
 	VkDescriptorPool imgui_descriptorPool;
-	std::vector<VkDescriptorSet> descriptorSets;
-
-	VkDescriptorSet shadowDescriptorSet;
-
-	std::vector<VkCommandBuffer> commandBuffers; //creates the vector of command buffers
-
-	std::vector<VkSemaphore> imageAvailableSemaphores;
-	std::vector<VkSemaphore> renderFinishedSemaphores;
-	std::vector<VkFence> inFlightFences;
-	std::vector<VkFence> imagesInFlight;
-	size_t currentFrame = 0; //counter for current frame
+	std::vector<VkDescriptorSet> staticSets; //one per frame in flight, texture streaming patches them in place
+	std::vector<VkDescriptorSet> frameSets; //one per swap chain image, they differ in the feedback buffer only
+
+	VkDescriptorSet furDynamicsDescriptorSet;
+	VkDescriptorSet grassCullDescriptorSet;
+
+	std::vector<VkCommandBuffer> commandBuffers; //the primary buffer of each frame in flight, allocated once
+	recorder::pool commandRecorder; //records the passes into secondary command buffers on worker threads
+	std::vector<std::vector<recorder::cached>> passCaches; //reused secondaries of each frame in flight, per swap chain image and pass
+	std::vector<uint64_t> passVersions; //bumped when a cached pass would record different commands
+	uint32_t lastBasePermutation = 0;
+
+	timeline::scheduler frameTimeline; //every graphics submit signals its next value, reused resources wait for their own
+	std::vector<VkSemaphore> presentSemaphores; //one per swap chain image, signalled by its frame and waited on by the present
+	std::vector<timeline::value> imageValues; //last frame rendered to each swap chain image, guards its feedback buffer
+	uint32_t currentFrame = 0; //frame in flight being recorded
+
+	packets::queue packetQueue; //frame packets from the main thread to the render thread
+	std::array<FramePacket, FRAME_PACKETS> framePackets; //indexed by queue slot
+	std::thread renderThread;
+	std::string renderError; //thrown again on the main thread once the render thread has stopped
+
+	bool windowResized = false; //main thread, set by GLFW and handed over in the next packet
+	bool framebufferResized = false; //render thread, the swap chain is recreated after this frame's present
+	VkExtent2D framebufferExtent = {}; //render thread, the window size of the packet being drawn
+	bool imguiRebuildPending = false; //render thread, the surface format changed and the UI pipeline is stale
+
+	//the size dependent objects of a swap chain, destroyed once no frame in flight uses them
+	struct RetiredSwapChain {
+		VkSwapchainKHR swapChain;
+		std::vector<VkImageView> imageViews;
+		std::vector<VkSemaphore> presentSemaphores; //the presents of its last frames wait on them
+		rendergraph::attachments attachments; //framebuffers and the frame graph's images
+		descriptors::allocator frameDescriptors;
+	};
 
-	bool framebufferResized = false;
+	deletion::queue deletionQueue; //objects replaced while frames using them may still be in flight
+	uint32_t swapChainRecreations = 0;
+	double slowestRecreationMilliseconds = 0.0;
+	uint64_t frameCount = 0; //for the average frame time printed on exit
+	double frameMilliseconds = 0.0;
 
 	bool renderTexture = true;
 	bool renderLighting = true;
 	bool renderShadowMap = false;
 
+	float windStrength = 2.0f;
+
+	//simulation state carried between packets, main thread only and set up by mainLoop()
+	std::chrono::high_resolution_clock::time_point simulationStart;
+	float previousTime = 0.0f;
+	float previousDeltaTime = 0.0f;
+	glm::mat4 previousModel = glm::mat4(1.0f); //the last two model transforms give the fur roots their acceleration
+	glm::mat4 olderModel = glm::mat4(1.0f);
+
+	bool renderGrass = true;
+
 	diredge::diredgeMesh mesh;
 
 	void initWindow() {
@@ -304,11 +474,15 @@ private:
 		glfwSetWindowUserPointer(window, this);
 		glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
 		glfwSetKeyCallback(window, key_callback);
+
+		int width, height;
+		glfwGetFramebufferSize(window, &width, &height);
+		framebufferExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) }; //for the first swap chain
 	}
 
 	static void framebufferResizeCallback(GLFWwindow* window, int width, int height) {
 		auto app = reinterpret_cast<VulkanApplication*>(glfwGetWindowUserPointer(window));
-		app->framebufferResized = true;
+		app->windowResized = true;
 	}
 
 	static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
@@ -345,37 +519,55 @@ private:
 	}
 
 	void initVulkan() {
+		auto startupStart = std::chrono::high_resolution_clock::now();
+
 		createInstance(); //initialises vulkan library
 		setupDebugMessenger(); //sets up the debug messenger
 		createSurface(); //creates the surface
 		pickPhysicalDevice(); //selects the physical device
 		createLogicalDevice(); //creates the logical device
+		timeline::init(frameTimeline, device, FRAMES_IN_FLIGHT); //creates the timeline semaphore that paces the frames
+		memalloc::init(memoryAllocator, physicalDevice, device); //sets up the device memory sub-allocator
+		deletion::init(deletionQueue, frameTimeline); //destroys replaced objects once the timeline passes their last use
 		createSwapChain(); //creates the swap chain
 		createImageViews(); //creates the image views
-		createRenderPass(); //creates the render pass
-		createShadowRenderPass(); //creates the shadow render pass
+		createFrameGraph(); //declares the passes, the graph creates their render passes
 		createDescriptorSetLayout(); //creates the layout for the descriptor set
-		createBasePipeline(); //creates the graphics pipeline
-		createShellPipeline(); //creates the shell pipeline
-		createFinPipeline(); //creates the fin pipeline
-		createShadowPipeline(); //creates the shadow pipeline
+		pipecache::init(pipelineCache, physicalDevice, device, PIPELINE_CACHE_PATH); //loads last run's pipeline cache if it suits this driver
+		createPipelineLayout(); //creates the layout every graphics pipeline shares
+		pipelines::init(pipelineRegistry, device, pipelineCache, pipelineLayout); //starts the pipeline compile workers
+		requestGraphicsPipelines(); //queues the graphics pipelines, they compile while the rest of startup runs
+
+		auto pipelinesStart = std::chrono::high_resolution_clock::now();
+		createFurDynamicsPipeline(); //creates the fur simulation compute pipeline
+		createGrassCullPipeline(); //creates the grass culling compute pipeline
+		pipecache::recordCreation(pipelineCache, 2, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelinesStart).count());
 		createCommandPool(); //creates the command pool
-		createDepthResources(); //creates the depth resources
-		createShadowImage();
-		createFramebuffers(); //creates the frame buffers
-		createTextureImage(); //creates the texture image
-		createTextureImageView(); //creates the texture image view
+		recorder::init(commandRecorder, device, graphicsFamily, FRAMES_IN_FLIGHT); //starts the recording workers and their command pools
+		upload::init(uploadContext, memoryAllocator, frameTimeline, device, graphicsQueue, graphicsFamily, transferQueue, transferFamily, UPLOAD_ARENA_SIZE, !BATCHED_UPLOADS); //creates the upload context
+		rendergraph::createAttachments(frameGraph, swapChainExtent, swapChainImageViews); //creates the attachments and frame buffers
 		createSamplers(); //creates the texture samplers
+		createTextures(); //registers the streamed textures, they start as placeholders
 		loadModel(); //loads the obj file
-		createVertexBuffers(); //creates the vertex buffer
-		createIndexBuffers(); //creates the index buffer
-		createUniformBuffers(); //creates the uniform buffers
-		createLightingBuffers(); //creates the lighting buffers
-		createDescriptorPool(); //creates the descriptor pool
-		createDescriptorSets(); //creates the descriptor sets
+		createGeometryPool(); //creates the shared vertex and index buffers
+		createFurStateBuffer(); //creates the simulated hair state
+		createGrassField(); //creates the grass patches and culling buffers
+		createUniformRing(); //creates the uniform ring, it outlives the swap chain
+		createDescriptorAllocators(); //creates the descriptor allocators and the ImGui pool
+		createStaticDescriptorSets(); //creates the sets that survive swap chain recreation
+		vtex::resetFeedback(virtualTextures, static_cast<uint32_t>(swapChainImages.size())); //creates a feedback buffer per image
+		createFrameDescriptorSets(); //creates the per image sets
 		//createCommandBuffers(); //creates the command buffers
-		createSyncObjects(); //creates the sync objects
+		createSyncObjects(); //creates the present semaphores
 		initImGui();
+
+		//one submit for everything staged above, the first frame is queued behind it so nothing waits on the CPU
+		upload::submit(uploadContext);
+
+		double startupMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startupStart).count();
+		std::cout << "startup took " << startupMilliseconds << " ms with a " << (pipelineCache.warm ? "warm" : "cold") << " pipeline cache" << std::endl;
+		pipecache::printStats(pipelineCache);
+		upload::printStats(uploadContext);
 	}
 
 	void initImGui()
@@ -390,28 +582,96 @@ private:
 
 		// Setup Platform/Renderer bindings
 		ImGui_ImplGlfw_InitForVulkan(window, true);
+		initImGuiRenderer();
+	}
+
+	//builds the UI pipeline against the resolve node's render pass and uploads the font atlas with the next upload batch
+	void initImGuiRenderer()
+	{
 		ImGui_ImplVulkan_InitInfo init_info = {};
 		init_info.Instance = instance;
 		init_info.PhysicalDevice = physicalDevice;
 		init_info.Device = device;
 		init_info.QueueFamily = 1;
 		init_info.Queue = graphicsQueue;
-		init_info.PipelineCache = VK_NULL_HANDLE;
+		init_info.PipelineCache = pipelineCache.handle;
 		init_info.DescriptorPool = imgui_descriptorPool;
+		init_info.Subpass = rendergraph::subpass(frameGraph, resolveNode); //drawn after the OIT resolve so the UI stays on top
 		init_info.Allocator = nullptr;
 		init_info.MinImageCount = static_cast<uint32_t>(swapChainImages.size());
-		init_info.ImageCount = static_cast<uint32_t>(swapChainImages.size());
+		init_info.ImageCount = std::max(static_cast<uint32_t>(swapChainImages.size()), FRAMES_IN_FLIGHT); //its vertex buffers rotate with this count, not the timeline
 		//init_info.CheckVkResultFn = check_vk_result;
-		ImGui_ImplVulkan_Init(&init_info, renderPass);
+		ImGui_ImplVulkan_Init(&init_info, rendergraph::renderPass(frameGraph, resolveNode));
 
-		VkCommandBuffer command_buffer = beginSingleTimeCommands();
-		ImGui_ImplVulkan_CreateFontsTexture(command_buffer);
-		endSingleTimeCommands(command_buffer);
+		ImGui_ImplVulkan_CreateFontsTexture(upload::commands(uploadContext)); //goes out with the open upload batch, at startup with the rest of the startup uploads
 	}
 
+	//its backend only rebuilds the pipeline on init, the render thread calls this with the main thread parked
+	void rebuildImGuiRenderer()
+	{
+		ImGui_ImplVulkan_Shutdown(); //every frame that drew the UI or uploaded its font has completed
+		vkResetDescriptorPool(device, imgui_descriptorPool, 0); //init allocates the font set again
+		initImGuiRenderer(); //sets the font's texture id in the shared context
+		upload::submit(uploadContext); //the font goes out ahead of the next frame's submit
+	}
+
+	//the main thread polls GLFW, runs the UI and the simulation and publishes a packet per frame, the render thread
+	//draws them, so building packet N+1 overlaps recording and submitting packet N
 	void mainLoop() {
+		simulationStart = std::chrono::high_resolution_clock::now();
+		previousTime = 0.0f;
+		previousDeltaTime = 1.0f / 60.0f;
+		previousModel = glm::mat4(1.0f); //the model transform at time 0, the roots start at rest
+		olderModel = previousModel;
+
+		packets::init(packetQueue, FRAME_PACKETS);
+		renderThread = std::thread(&VulkanApplication::renderLoop, this);
+
+		try {
+			simulationLoop();
+		}
+		catch (...) {
+			packets::close(packetQueue);
+			renderThread.join();
+			throw;
+		}
+
+		packets::close(packetQueue); //the render thread draws what is queued and stops
+		renderThread.join();
+		vkDeviceWaitIdle(device);
+
+		if (!renderError.empty()) {
+			throw std::runtime_error(renderError);
+		}
+	}
+
+	void simulationLoop() {
+		auto frameStart = std::chrono::high_resolution_clock::now();
 		while (!glfwWindowShouldClose(window)) { //loops until window is closed by the user
+			auto frameEnd = std::chrono::high_resolution_clock::now();
+			if (frameCount > 0) {
+				frameMilliseconds += std::chrono::duration<double, std::milli>(frameEnd - frameStart).count();
+			}
+			frameStart = frameEnd;
+			frameCount++;
+
+			//blocks while the render thread is behind, so the input below is as fresh as the packet can be
+			uint32_t slot;
+			if (!packets::waitWrite(packetQueue, slot)) {
+				return; //the render thread stopped on an error
+			}
+
 			glfwPollEvents(); //checks for events
+			int width = 0, height = 0;
+			glfwGetFramebufferSize(window, &width, &height);
+			while ((width == 0 || height == 0) && !glfwWindowShouldClose(window)) { //minimised, nothing to draw until it is back
+				glfwWaitEvents();
+				glfwGetFramebufferSize(window, &width, &height);
+			}
+			if (glfwWindowShouldClose(window)) {
+				return;
+			}
+
 			ImGui_ImplVulkan_NewFrame();
 			ImGui_ImplGlfw_NewFrame();
 			ImGui::NewFrame();
@@ -428,6 +688,11 @@ private:
 					renderLighting = false;
 				}
 			}
+			ImGui::SliderFloat("Wind", &windStrength, 0.0f, 10.0f);
+			if (ImGui::Button("Toggle grass"))
+			{
+				renderGrass = !renderGrass;
+			}
 			if (ImGui::Button("Toggle shadows"))
 			{
 				if (!renderShadowMap)
@@ -441,91 +706,153 @@ private:
 			}
 			ImGui::End();
 			ImGui::Render();
-			drawFrame(); //calls the function to draw the frame
+
+			buildFramePacket(framePackets[slot], width, height);
+			packets::publish(packetQueue); //immutable from here until the render thread releases it
 		}
-		vkDeviceWaitIdle(device);
 	}
 
-	void cleanupSwapChain() {
-		vkDestroyImageView(device, depthImageView, nullptr);
-		vkDestroyImage(device, depthImage, nullptr);
-		vkFreeMemory(device, depthImageMemory, nullptr);
+	//draws the packets in order, errors stop the loop and are thrown again by mainLoop()
+	void renderLoop() {
+		try {
+			uint32_t slot;
+			while (packets::waitRead(packetQueue, slot)) {
+				drawFrame(framePackets[slot]);
+				packets::release(packetQueue);
 
-		vkDestroyImageView(device, shadowPass.depth.view, nullptr);
-		vkDestroyImage(device, shadowPass.depth.image, nullptr);
-		vkFreeMemory(device, shadowPass.depth.memory, nullptr);
+				if (imguiRebuildPending) {
+					packets::pause(packetQueue); //the main thread uses the ImGui context while it builds a packet
+					rebuildImGuiRenderer();
+					packets::resume(packetQueue);
+					imguiRebuildPending = false;
+				}
+			}
+		}
+		catch (const std::exception& e) {
+			renderError = e.what();
+			packets::close(packetQueue);
+		}
+	}
 
-		for (auto framebuffer : swapChainFramebuffers) {
-			vkDestroyFramebuffer(device, framebuffer, nullptr);
+	//frees the UI copies of the packet that last used the slot, ImGui's allocator is only used on the main thread
+	void freeFramePacket(FramePacket& packet) {
+		for (ImDrawList* drawList : packet.uiDrawLists) {
+			IM_DELETE(drawList);
 		}
+		packet.uiDrawLists.clear();
+		packet.uiDrawData.Clear();
+	}
 
-		vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()), commandBuffers.data());
+	//takes the size dependent objects out of the members, which the next swap chain overwrites
+	RetiredSwapChain detachSwapChain() {
+		RetiredSwapChain retired;
+		retired.swapChain = swapChain;
+		retired.imageViews = swapChainImageViews;
+		retired.presentSemaphores = presentSemaphores;
+		retired.attachments = rendergraph::detachAttachments(frameGraph);
+		retired.frameDescriptors = descriptors::detach(swapChainDescriptors); //the new sets come from fresh pools
+		return retired;
+	}
 
-		vkDestroyPipeline(device, basePipeline, nullptr);
-		vkDestroyPipeline(device, shellPipeline, nullptr);
-		vkDestroyPipeline(device, finPipeline, nullptr);
-		vkDestroyPipeline(device, shadowPipeline, nullptr);
-		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-		vkDestroyRenderPass(device, renderPass, nullptr);
-		vkDestroyRenderPass(device, shadowPass.renderPass, nullptr);
+	void destroySwapChain(RetiredSwapChain& retired) {
+		rendergraph::destroyAttachments(frameGraph, retired.attachments);
+
+		descriptors::destroy(retired.frameDescriptors);
 
-		for (auto imageView : swapChainImageViews) {
+		for (auto imageView : retired.imageViews) {
 			vkDestroyImageView(device, imageView, nullptr);
 		}
 
-		vkDestroySwapchainKHR(device, swapChain, nullptr);
-
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-			vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-			vkDestroyBuffer(device, shadowUniformBuffers[i], nullptr);
-			vkFreeMemory(device, shadowUniformBuffersMemory[i], nullptr);
-			vkDestroyBuffer(device, lightingBuffers[i], nullptr);
-			vkFreeMemory(device, lightingBuffersMemory[i], nullptr);
+		for (VkSemaphore semaphore : retired.presentSemaphores) {
+			vkDestroySemaphore(device, semaphore, nullptr);
 		}
 
-		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-		vkDestroyDescriptorPool(device, imgui_descriptorPool, nullptr);
+		vkDestroySwapchainKHR(device, retired.swapChain, nullptr);
+	}
+
+	void cleanupSwapChain() {
+		RetiredSwapChain retired = detachSwapChain();
+		destroySwapChain(retired);
+	}
+
+	//blocks until every submitted frame has finished, for the rare changes that cannot wait for the deletion queue
+	void waitForFramesInFlight() {
+		timeline::wait(frameTimeline, frameTimeline.submitted);
 	}
 
 	void cleanup() {
+		for (FramePacket& packet : framePackets) {
+			freeFramePacket(packet);
+		}
+		packets::printStats(packetQueue);
+
 		cleanupSwapChain();
+		deletion::flush(deletionQueue); //the device is idle, swap chains replaced in the last frames go too
+		std::cout << "frames: " << frameCount << ", " << (frameCount > 1 ? frameMilliseconds / (frameCount - 1) : 0.0) << " ms on average" << std::endl;
+		std::cout << "swap chain: " << swapChainRecreations << " recreations, slowest " << slowestRecreationMilliseconds << " ms" << std::endl;
+
+		pipelines::clear(pipelineRegistry); //every graphics pipeline was built against the render passes below
+		rendergraph::printStats(frameGraph);
+		rendergraph::destroy(frameGraph);
 
 		vkDestroySampler(device, textureSampler, nullptr);
-		vkDestroySampler(device, shadowPass.depthSampler, nullptr);
+		vkDestroySampler(device, shadowSampler, nullptr);
 		
-		vkDestroyImageView(device, textureImageView, nullptr);
-		vkDestroyImage(device, textureImage, nullptr);
-		vkFreeMemory(device, textureImageMemory, nullptr);
+		texstream::printStats(textureStreamer);
+		texstream::destroy(textureStreamer);
+		materials::destroy(materialLibrary, device, memoryAllocator);
+		vtex::printStats(virtualTextures);
+		vtex::destroy(virtualTextures);
+
+		descriptors::printStats(staticDescriptors, "static");
+		descriptors::printStats(swapChainDescriptors, "swap chain");
+		descriptors::destroy(staticDescriptors);
+		descriptors::destroy(swapChainDescriptors);
+		vkDestroyDescriptorPool(device, imgui_descriptorPool, nullptr);
+		descriptors::destroy(setLayouts);
 
-		vkDestroyImageView(device, textureImageFinView, nullptr);
-		vkDestroyImage(device, textureImageFin, nullptr);
-		vkFreeMemory(device, textureImageFinMemory, nullptr);
+		pipelines::printStats(pipelineRegistry);
+		pipelines::destroy(pipelineRegistry);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 
-		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+		vkDestroyPipeline(device, furDynamicsPipeline, nullptr);
+		vkDestroyPipelineLayout(device, furDynamicsPipelineLayout, nullptr);
 
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			vkDestroyBuffer(device, indexBuffers[i], nullptr);
-			vkFreeMemory(device, indexBuffersMemory[i], nullptr);
+		vkDestroyBuffer(device, furStateBuffer, nullptr);
+		memalloc::free(memoryAllocator, furStateBufferMemory);
 
-			vkDestroyBuffer(device, quadIndexBuffers[i], nullptr);
-			vkFreeMemory(device, quadIndexBuffersMemory[i], nullptr);
+		vkDestroyPipeline(device, grassCullPipeline, nullptr);
+		vkDestroyPipelineLayout(device, grassCullPipelineLayout, nullptr);
 
-			vkDestroyBuffer(device, vertexBuffers[i], nullptr);
-			vkFreeMemory(device, vertexBuffersMemory[i], nullptr);
+		vkDestroyBuffer(device, grassPatchBuffer, nullptr);
+		memalloc::free(memoryAllocator, grassPatchBufferMemory);
+		vkDestroyBuffer(device, grassShellBuffer, nullptr);
+		memalloc::free(memoryAllocator, grassShellBufferMemory);
+		vkDestroyBuffer(device, grassDrawBuffer, nullptr);
+		memalloc::free(memoryAllocator, grassDrawBufferMemory);
 
-			vkDestroyBuffer(device, quadVertexBuffers[i], nullptr);
-			vkFreeMemory(device, quadVertexBuffersMemory[i], nullptr);
-		}
-		
+		geometry::destroy(geometryPool, device, memoryAllocator);
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-			vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-			vkDestroyFence(device, inFlightFences[i], nullptr);
+		uniforms::printStats(uniformRing);
+		uniforms::destroy(uniformRing);
+
+		recorder::printStats(commandRecorder);
+		recorder::destroy(commandRecorder);
+		for (VkCommandPool commandPool : commandPools) {
+			vkDestroyCommandPool(device, commandPool, nullptr); //frees the primary buffers
 		}
 
-		vkDestroyCommandPool(device, commandPool, nullptr);
+		upload::destroy(uploadContext);
+
+		timeline::printStats(frameTimeline);
+		timeline::destroy(frameTimeline);
+
+		memalloc::printStats(memoryAllocator);
+		memalloc::destroy(memoryAllocator);
+
+		pipecache::printStats(pipelineCache);
+		pipecache::save(pipelineCache); //holds ImGui's pipeline and every recreated one too
+		pipecache::destroy(pipelineCache);
 
 		vkDestroyDevice(device, nullptr);
 
@@ -542,33 +869,46 @@ private:
 	}
 
 	void recreateSwapChain() {
-		int width = 0, height = 0;
-		glfwGetFramebufferSize(window, &width, &height);
-		while (width == 0 || height == 0) {
-			glfwGetFramebufferSize(window, &width, &height);
-			glfwWaitEvents();
+		//the main thread stops building packets while the window is minimised, a packet from just before finds it here
+		VkSurfaceCapabilitiesKHR capabilities;
+		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &capabilities);
+		if (capabilities.currentExtent.width == 0 || capabilities.currentExtent.height == 0) {
+			return;
 		}
 
-		vkDeviceWaitIdle(device);
+		auto recreationStart = std::chrono::high_resolution_clock::now();
 
-		cleanupSwapChain();
+		//no vkDeviceWaitIdle, frames in flight keep the old objects until the timeline passes them
+		VkFormat oldFormat = swapChainImageFormat;
+		size_t oldImageCount = swapChainImages.size();
+		RetiredSwapChain retired = detachSwapChain();
+
+		createSwapChain(retired.swapChain); //hands the old swap chain over, it is retired rather than torn down
+		deletion::push(deletionQueue, [this, retired]() mutable { destroySwapChain(retired); });
+
+		//the render passes and pipelines only depend on formats, a resize keeps them
+		if (swapChainImageFormat != oldFormat) {
+			waitForFramesInFlight();
+			pipelines::clear(pipelineRegistry);
+			rendergraph::setFormat(frameGraph, swapChainTarget, swapChainImageFormat);
+			rendergraph::compile(frameGraph);
+			requestGraphicsPipelines();
+			imguiRebuildPending = true; //its pipeline was built against the destroyed render pass, rebuilt between packets
+		}
 
-		createSwapChain();
+		if (swapChainImages.size() != oldImageCount) {
+			waitForFramesInFlight(); //the feedback buffers are per image and written by the frames in flight
+			vtex::resetFeedback(virtualTextures, static_cast<uint32_t>(swapChainImages.size()));
+		}
 		createImageViews();
-		createRenderPass();
-		createShadowRenderPass();
-		createBasePipeline();
-		createShellPipeline();
-		createFinPipeline();
-		createShadowPipeline();
-		createDepthResources();
-		createShadowImage();
-		createFramebuffers();
-		createUniformBuffers();
-		createLightingBuffers();
-		createDescriptorPool();
-		createDescriptorSets();
-		createCommandBuffers();
+		createSyncObjects(); //the old present semaphores went with the retired swap chain
+		rendergraph::createAttachments(frameGraph, swapChainExtent, swapChainImageViews);
+		createFrameDescriptorSets();
+		invalidateRecordedPasses(); //the cached secondaries bound the old framebuffers and frame sets
+
+		double recreationMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recreationStart).count();
+		slowestRecreationMilliseconds = std::max(slowestRecreationMilliseconds, recreationMilliseconds);
+		swapChainRecreations++;
 	}
 
 	void createInstance() {
@@ -664,6 +1004,9 @@ private:
 
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos; //declares a vector of queue information structs
 		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+		if (indices.transferFamily.has_value()) {
+			uniqueQueueFamilies.insert(indices.transferFamily.value());
+		}
 
 		float queuePriority = 1.0f; //sets the priority of the queue
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
@@ -675,11 +1018,23 @@ private:
 			queueCreateInfos.push_back(queueCreateInfo);
 		}
 
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+
 		VkPhysicalDeviceFeatures deviceFeatures = {}; //struct for device features
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC; //textures fall back to RGBA8 without it
+		deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE; //materials index the texture table with a push constant
+		deviceFeatures.fragmentStoresAndAtomics = VIRTUAL_TEXTURING ? VK_TRUE : VK_FALSE; //virtual texture feedback is written by the fragment shaders
+		textureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+
+		VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {}; //required by every device exposing the extension
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+		timelineFeatures.timelineSemaphore = VK_TRUE;
 
 		VkDeviceCreateInfo createInfo = {}; //struct for device information
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO; //specifies the struct type
+		createInfo.pNext = &timelineFeatures; //enables timeline semaphores
 
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
@@ -703,9 +1058,13 @@ private:
 
 		vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue); //retrieves the queue handle for the graphics family 
 		vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue); //retrieves the queue handle for the presentation family
+
+		graphicsFamily = indices.graphicsFamily.value();
+		transferFamily = indices.transferFamily.value_or(graphicsFamily); //falls back to uploading on the graphics queue
+		vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
 	}
 
-	void createSwapChain() {
+	void createSwapChain(VkSwapchainKHR oldSwapChain = VK_NULL_HANDLE) {
 		SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice); //queries the swap chain details and stores them in a struct
 
 		VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats); //calls the function to select the surface format from the available formats
@@ -745,7 +1104,7 @@ private:
 		createInfo.presentMode = presentMode;
 		createInfo.clipped = VK_TRUE;
 
-		createInfo.oldSwapchain = VK_NULL_HANDLE; //sets old swap chain to null
+		createInfo.oldSwapchain = oldSwapChain; //lets the presentation engine reuse the old swap chain's resources
 
 		if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) != VK_SUCCESS) { //if creation of swap chain unsuccessful
 			throw std::runtime_error("failed to create swap chain!"); //throws runtime error
@@ -763,746 +1122,334 @@ private:
 		swapChainImageViews.resize(swapChainImages.size());
 
 		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
-		}
-	}
-
-	void createRenderPass() {
-		VkAttachmentDescription colorAttachment = {}; //struct for color attachment information
-		colorAttachment.format = swapChainImageFormat;
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkAttachmentDescription depthAttachment = {};
-		depthAttachment.format = findDepthFormat();
-		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference colorAttachmentRef = {}; //struct for color attachment reference information
-		colorAttachmentRef.attachment = 0;
-		colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference depthAttachmentRef = {};
-		depthAttachmentRef.attachment = 1;
-		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpasses[3] = {}; //struct for subpass information
-		subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpasses[0].colorAttachmentCount = 1;
-		subpasses[0].pColorAttachments = &colorAttachmentRef;
-		subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
-
-		subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpasses[1].colorAttachmentCount = 1;
-		subpasses[1].pColorAttachments = &colorAttachmentRef;
-		subpasses[1].pDepthStencilAttachment = &depthAttachmentRef;
-
-		subpasses[2].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpasses[2].colorAttachmentCount = 1;
-		subpasses[2].pColorAttachments = &colorAttachmentRef;
-		subpasses[2].pDepthStencilAttachment = &depthAttachmentRef;
-
-		VkSubpassDependency dependencies[3] = {}; //struct for dependency information
-		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependencies[0].dstSubpass = 0;
-		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].srcAccessMask = 0;
-		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;;
-
-		dependencies[1].srcSubpass = 0;
-		dependencies[1].dstSubpass = 1;
-		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].srcAccessMask = 0;
-		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-		dependencies[2].srcSubpass = 1;
-		dependencies[2].dstSubpass = 2;
-		dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[2].srcAccessMask = 0;
-		dependencies[2].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependencies[2].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-		std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
-		VkRenderPassCreateInfo renderPassInfo = {}; //struct for render pass information
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		renderPassInfo.pAttachments = attachments.data();
-		renderPassInfo.subpassCount = 3;
-		renderPassInfo.pSubpasses = subpasses;
-		renderPassInfo.dependencyCount = 3;
-		renderPassInfo.pDependencies = dependencies;
-
-		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create render pass!"); //throws runtime error
-		}
-	}
-
-	void createShadowRenderPass() {
-		VkAttachmentDescription attachments[1];
-		attachments[0].format = VK_FORMAT_D32_SFLOAT;
-		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
-		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		attachments[0].flags = 0;
-
-		VkAttachmentReference shadowAttachmentRef;
-		shadowAttachmentRef.attachment = 0;
-		shadowAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass[1];
-		subpass[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass[0].flags = 0;
-		subpass[0].inputAttachmentCount = 0;
-		subpass[0].pInputAttachments = NULL;
-		subpass[0].colorAttachmentCount = 0;
-		subpass[0].pColorAttachments = NULL;
-		subpass[0].pResolveAttachments = NULL;
-		subpass[0].pDepthStencilAttachment = &shadowAttachmentRef;
-		subpass[0].preserveAttachmentCount = 0;
-		subpass[0].pPreserveAttachments = NULL;
-
-		VkRenderPassCreateInfo renderPassInfo = {}; //struct for render pass information
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		renderPassInfo.attachmentCount = 1;
-		renderPassInfo.pAttachments = attachments;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = subpass;
-		renderPassInfo.dependencyCount = 0;
-		renderPassInfo.pDependencies = NULL;
-
-		if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &shadowPass.renderPass) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create shadow render pass!"); //throws runtime error
+			swapChainImageViews[i] = createImageView(swapChainImages[i], swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 		}
 	}
 
-	void createDescriptorSetLayout() {
-		VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-		uboLayoutBinding.binding = 0;
-		uboLayoutBinding.descriptorCount = 1;
-		uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		uboLayoutBinding.pImmutableSamplers = nullptr;
-		uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-		VkDescriptorSetLayoutBinding lightingLayoutBinding = {};
-		lightingLayoutBinding.binding = 1;
-		lightingLayoutBinding.descriptorCount = 1;
-		lightingLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		lightingLayoutBinding.pImmutableSamplers = nullptr;
-		lightingLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-		VkDescriptorSetLayoutBinding samplerLayoutBinding = {};
-		samplerLayoutBinding.binding = 2;
-		samplerLayoutBinding.descriptorCount = 2;
-		samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		samplerLayoutBinding.pImmutableSamplers = nullptr;
-		samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-		VkDescriptorSetLayoutBinding shadowLayoutBinding = {};
-		shadowLayoutBinding.binding = 3;
-		shadowLayoutBinding.descriptorCount = 1;
-		shadowLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		shadowLayoutBinding.pImmutableSamplers = nullptr;
-		shadowLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-		VkDescriptorSetLayoutBinding inputLayoutBinding = {};
-		inputLayoutBinding.binding = 4;
-		inputLayoutBinding.descriptorCount = 1;
-		inputLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		inputLayoutBinding.pImmutableSamplers = nullptr;
-		inputLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-		std::array<VkDescriptorSetLayoutBinding, 5> bindings = { uboLayoutBinding, lightingLayoutBinding, samplerLayoutBinding, shadowLayoutBinding, inputLayoutBinding };
-		VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-		layoutInfo.pBindings = bindings.data();
-
-		if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create descriptor set layout!");
-		}
-	}
-
-	void createFinPipeline() {
-		auto vertShaderCode = readFile("shaders/finvert.spv"); //stores the vertex shader path
-		auto fragShaderCode = readFile("shaders/finfrag.spv"); //stores the fragment shader path
-
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode); //sets the vertex shader module by using the shader path
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode); //sets the fragment shader module using the shader path
-
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {}; //struct for vertex shader stage information
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main";
-
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo = {}; //struct for fragment shader stage information
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main";
-
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo }; //array for the vertex/fragment shader stage information
-
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {}; //struct for vertex input information
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+	//declares what every pass reads and writes, the graph derives the render passes, their dependencies and which
+	//attachments can share memory. Only the swap chain format is baked in, a resize keeps the render passes
+	void createFrameGraph() {
+		rendergraph::init(frameGraph, device, memoryAllocator);
 
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		VkClearValue clearColor = {};
+		clearColor.color = { 0.16f, 0.56f, 0.81f, 1.0f };
+		VkClearValue clearDepth = {};
+		clearDepth.depthStencil = { 1.0f, 0 };
+		VkClearValue clearAccum = {};
+		clearAccum.color = { 0.0f, 0.0f, 0.0f, 0.0f };
+		VkClearValue clearRevealage = {};
+		clearRevealage.color = { 1.0f, 0.0f, 0.0f, 0.0f }; //nothing transparent covers the pixel yet
 
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {}; //struct for input assembly information
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
+		VkFormat depthFormat = findDepthFormat();
+		swapChainTarget = rendergraph::importImage(frameGraph, "swap chain", swapChainImageFormat, &clearColor);
+		depthTarget = rendergraph::addImage(frameGraph, "depth", depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, &clearDepth);
+		shadowMap = rendergraph::addImage(frameGraph, "shadow map", depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, &clearDepth);
+		oitAccum = rendergraph::addImage(frameGraph, "OIT accumulation", OIT_ACCUM_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, &clearAccum);
+		oitRevealage = rendergraph::addImage(frameGraph, "OIT revealage", OIT_REVEALAGE_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, &clearRevealage);
 
-		VkViewport viewport = {}; //struct containing information about the viewport
-		viewport.x = 0.0f; //sets the x position that the viewport starts from
-		viewport.y = 0.0f; //sets the y position that the viewport starts from
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f; //sets the minimum depth of the viewport
-		viewport.maxDepth = 1.0f; //sets the maximum depth of the viewport
+		using rendergraph::usage;
+		shadowNode = rendergraph::addPass(frameGraph, "shadow", { { shadowMap, usage::depthWrite } });
+		baseNode = rendergraph::addPass(frameGraph, "base", { { swapChainTarget, usage::colorWrite }, { depthTarget, usage::depthWrite }, { shadowMap, usage::sampled } });
+		finNode = rendergraph::addPass(frameGraph, "fin", { { oitAccum, usage::colorWrite }, { oitRevealage, usage::colorWrite }, { depthTarget, usage::depthRead } }, RENDER_FINS);
+		shellNode = rendergraph::addPass(frameGraph, "shell", { { oitAccum, usage::colorWrite }, { oitRevealage, usage::colorWrite }, { depthTarget, usage::depthRead } }); //the grass draws too
+		resolveNode = rendergraph::addPass(frameGraph, "OIT resolve", { { oitAccum, usage::inputRead }, { oitRevealage, usage::inputRead }, { swapChainTarget, usage::colorWrite } }); //and ImGui
 
-		VkRect2D scissor = {}; //struct for scissor information
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
+		rendergraph::compile(frameGraph);
+	}
 
-		VkPipelineViewportStateCreateInfo viewportState = {}; //struct for viewport state information
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
-
-		VkPipelineRasterizationStateCreateInfo rasterizer = {}; //struct for rasterizer information
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE;
-		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterizer.lineWidth = 1.0f;
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterizer.depthBiasEnable = VK_FALSE;
-
-		VkPipelineMultisampleStateCreateInfo multisampling = {}; //struct for multisampling information
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = VK_FALSE;
-		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-		depthStencil.depthBoundsTestEnable = VK_FALSE;
-		depthStencil.stencilTestEnable = VK_FALSE;
-
-		VkPipelineColorBlendAttachmentState colorBlendAttachment = {}; //struct for color blend attachment information
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-		VkPipelineColorBlendStateCreateInfo colorBlending = {}; //struct for color blending information
-		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = VK_LOGIC_OP_COPY;
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f;
-		colorBlending.blendConstants[1] = 0.0f;
-		colorBlending.blendConstants[2] = 0.0f;
-		colorBlending.blendConstants[3] = 0.0f;
+	//sets are split by how often they change, the static set is never rewritten by swap chain recreation
+	//and per draw data goes through push constants, so one bind of both sets covers every graphics draw
+	void createDescriptorSetLayout() {
+		descriptors::init(setLayouts, device);
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings(7);
+		bindings[0].binding = 0; //material texture table
+		bindings[0].descriptorCount = materials::MAX_TEXTURES;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[1].binding = 1; //materials
+		bindings[1].descriptorCount = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[2].binding = 2; //virtual texture page table
+		bindings[2].descriptorCount = 1;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[3].binding = 3; //virtual texture page cache, UNORM and SRGB views
+		bindings[3].descriptorCount = 2;
+		bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[3].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[4].binding = 4; //simulated hair state
+		bindings[4].descriptorCount = 1;
+		bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[4].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		bindings[5].binding = 5; //grass patches
+		bindings[5].descriptorCount = 1;
+		bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[5].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		bindings[6].binding = 6; //visible grass patch layers
+		bindings[6].descriptorCount = 1;
+		bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[6].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		staticSetLayout = descriptors::getLayout(setLayouts, bindings);
+
+		bindings[0].binding = 0; //camera
+		bindings[0].descriptorCount = 1;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[1].binding = 1; //lighting, read per fragment rather than copied into varyings
+		bindings[1].descriptorCount = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[2].binding = 2; //shadow camera
+		bindings[2].descriptorCount = 1;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		bindings[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		bindings[3].binding = 3; //shadow map
+		bindings[3].descriptorCount = 1;
+		bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[3].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[4].binding = 4; //OIT accumulation
+		bindings[4].descriptorCount = 1;
+		bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		bindings[4].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[5].binding = 5; //OIT revealage
+		bindings[5].descriptorCount = 1;
+		bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		bindings[5].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		bindings[6].binding = 6; //virtual texture feedback
+		bindings[6].descriptorCount = 1;
+		bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[6].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		frameSetLayout = descriptors::getLayout(setLayouts, bindings);
+	}
+
+	void createFurDynamicsPipeline() {
+		std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+		bindings[0].binding = 0; //rest pose vertices
+		bindings[0].descriptorCount = 1;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[1].binding = 1; //simulated hair state
+		bindings[1].descriptorCount = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[2].binding = 2; //simulation parameters
+		bindings[2].descriptorCount = 1;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		furDynamicsDescriptorSetLayout = descriptors::getLayout(setLayouts, std::vector<VkDescriptorSetLayoutBinding>(bindings.begin(), bindings.end()));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {}; //struct for pipeline layout information
-		VkPushConstantRange pushConstantInfo = { 0 };
-		pushConstantInfo.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		pushConstantInfo.offset = 0;
-		pushConstantInfo.size = sizeof(float);
-
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantInfo;
+		pipelineLayoutInfo.pSetLayouts = &furDynamicsDescriptorSetLayout;
 
-		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) { //if creation of pipeline layout unsuccessful
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &furDynamicsPipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!"); //throws runtime error
 		}
 
-		VkGraphicsPipelineCreateInfo pipelineInfo = {}; //struct for pipeline information
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = &depthStencil;
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 2;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &finPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphics pipeline!"); //throws runtime error
-		}
-
-		vkDestroyShaderModule(device, fragShaderModule, nullptr); //destroys the fragment shader module
-		vkDestroyShaderModule(device, vertShaderModule, nullptr); //destroys the vertex shader module
-	}
-
-	void createShellPipeline() {
-		auto vertShaderCode = readFile("shaders/shellvert.spv"); //stores the vertex shader path
-		auto fragShaderCode = readFile("shaders/shellfrag.spv"); //stores the fragment shader path
-
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode); //sets the vertex shader module by using the shader path
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode); //sets the fragment shader module using the shader path
-
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {}; //struct for vertex shader stage information
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main";
-
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo = {}; //struct for fragment shader stage information
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main";
+		auto compShaderCode = readFile("shaders/furdynamicscomp.spv"); //stores the compute shader path
+		VkShaderModule compShaderModule = createShaderModule(compShaderCode);
 
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo }; //array for the vertex/fragment shader stage information
-
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {}; //struct for vertex input information
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
+		VkPipelineShaderStageCreateInfo compShaderStageInfo = {}; //struct for compute shader stage information
+		compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		compShaderStageInfo.module = compShaderModule;
+		compShaderStageInfo.pName = "main";
 
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		VkComputePipelineCreateInfo pipelineInfo = {}; //struct for pipeline information
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = compShaderStageInfo;
+		pipelineInfo.layout = furDynamicsPipelineLayout;
 
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {}; //struct for input assembly information
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-		VkViewport viewport = {}; //struct containing information about the viewport
-		viewport.x = 0.0f; //sets the x position that the viewport starts from
-		viewport.y = 0.0f; //sets the y position that the viewport starts from
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f; //sets the minimum depth of the viewport
-		viewport.maxDepth = 1.0f; //sets the maximum depth of the viewport
-
-		VkRect2D scissor = {}; //struct for scissor information
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
-
-		VkPipelineViewportStateCreateInfo viewportState = {}; //struct for viewport state information
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
-
-		VkPipelineRasterizationStateCreateInfo rasterizer = {}; //struct for rasterizer information
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE;
-		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterizer.lineWidth = 1.0f;
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterizer.depthBiasEnable = VK_FALSE;
-
-		VkPipelineMultisampleStateCreateInfo multisampling = {}; //struct for multisampling information
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = VK_TRUE;
-		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-		depthStencil.depthBoundsTestEnable = VK_FALSE;
-		depthStencil.stencilTestEnable = VK_FALSE;
-
-		VkPipelineColorBlendAttachmentState colorBlendAttachment = {}; //struct for color blend attachment information
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-		VkPipelineColorBlendStateCreateInfo colorBlending = {}; //struct for color blending information
-		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = VK_LOGIC_OP_COPY;
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f;
-		colorBlending.blendConstants[1] = 0.0f;
-		colorBlending.blendConstants[2] = 0.0f;
-		colorBlending.blendConstants[3] = 0.0f;
-
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {}; //struct for pipeline layout information
-		VkPushConstantRange pushConstantInfo = { 0 };
-		pushConstantInfo.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		pushConstantInfo.offset = 0;
-		pushConstantInfo.size = sizeof(float);
-
-		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantInfo;
-
-		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) { //if creation of pipeline layout unsuccessful
-			throw std::runtime_error("failed to create pipeline layout!"); //throws runtime error
+		if (vkCreateComputePipelines(device, pipelineCache.handle, 1, &pipelineInfo, nullptr, &furDynamicsPipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!"); //throws runtime error
 		}
 
-		VkGraphicsPipelineCreateInfo pipelineInfo = {}; //struct for pipeline information
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = &depthStencil;
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 1;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &shellPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphics pipeline!"); //throws runtime error
-		}
-
-		vkDestroyShaderModule(device, fragShaderModule, nullptr); //destroys the fragment shader module
-		vkDestroyShaderModule(device, vertShaderModule, nullptr); //destroys the vertex shader module
+		vkDestroyShaderModule(device, compShaderModule, nullptr); //destroys the compute shader module
 	}
 
-	void createBasePipeline() {
-		auto vertShaderCode = readFile("shaders/vert.spv"); //stores the vertex shader path
-		auto fragShaderCode = readFile("shaders/frag.spv"); //stores the fragment shader path
-
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode); //sets the vertex shader module by using the shader path
-		VkShaderModule fragShaderModule = createShaderModule(fragShaderCode); //sets the fragment shader module using the shader path
-
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {}; //struct for vertex shader stage information
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main";
-
-		VkPipelineShaderStageCreateInfo fragShaderStageInfo = {}; //struct for fragment shader stage information
-		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		fragShaderStageInfo.module = fragShaderModule;
-		fragShaderStageInfo.pName = "main";
-
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo }; //array for the vertex/fragment shader stage information
-
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {}; //struct for vertex input information
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	void createGrassCullPipeline() {
+		std::array<VkDescriptorSetLayoutBinding, 4> bindings = {};
+		bindings[0].binding = 0; //grass patches
+		bindings[0].descriptorCount = 1;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		bindings[1].binding = 1; //visible patch layers
+		bindings[1].descriptorCount = 1;
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {}; //struct for input assembly information
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
+		bindings[2].binding = 2; //indirect draw command
+		bindings[2].descriptorCount = 1;
+		bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-		VkViewport viewport = {}; //struct containing information about the viewport
-		viewport.x = 0.0f; //sets the x position that the viewport starts from
-		viewport.y = 0.0f; //sets the y position that the viewport starts from
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f; //sets the minimum depth of the viewport
-		viewport.maxDepth = 1.0f; //sets the maximum depth of the viewport
-
-		VkRect2D scissor = {}; //struct for scissor information
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
+		bindings[3].binding = 3; //frustum and level of detail parameters
+		bindings[3].descriptorCount = 1;
+		bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-		VkPipelineViewportStateCreateInfo viewportState = {}; //struct for viewport state information
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
-
-		VkPipelineRasterizationStateCreateInfo rasterizer = {}; //struct for rasterizer information
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE;
-		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterizer.lineWidth = 1.0f;
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterizer.depthBiasEnable = VK_FALSE;
-
-		VkPipelineMultisampleStateCreateInfo multisampling = {}; //struct for multisampling information
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = VK_TRUE;
-		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-		depthStencil.depthBoundsTestEnable = VK_FALSE;
-		depthStencil.stencilTestEnable = VK_FALSE;
-
-		VkPipelineColorBlendAttachmentState colorBlendAttachment = {}; //struct for color blend attachment information
-		colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-		colorBlendAttachment.blendEnable = VK_TRUE;
-		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-		colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-		colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-		VkPipelineColorBlendStateCreateInfo colorBlending = {}; //struct for color blending information
-		colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-		colorBlending.logicOpEnable = VK_FALSE;
-		colorBlending.logicOp = VK_LOGIC_OP_COPY;
-		colorBlending.attachmentCount = 1;
-		colorBlending.pAttachments = &colorBlendAttachment;
-		colorBlending.blendConstants[0] = 0.0f;
-		colorBlending.blendConstants[1] = 0.0f;
-		colorBlending.blendConstants[2] = 0.0f;
-		colorBlending.blendConstants[3] = 0.0f;
+		grassCullDescriptorSetLayout = descriptors::getLayout(setLayouts, std::vector<VkDescriptorSetLayoutBinding>(bindings.begin(), bindings.end()));
 
 		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {}; //struct for pipeline layout information
-		VkPushConstantRange pushConstantInfo = { 0 };
-		pushConstantInfo.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-		pushConstantInfo.offset = 0;
-		pushConstantInfo.size = sizeof(float);
-
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-		pipelineLayoutInfo.pushConstantRangeCount = 1;
-		pipelineLayoutInfo.pPushConstantRanges = &pushConstantInfo;
+		pipelineLayoutInfo.pSetLayouts = &grassCullDescriptorSetLayout;
 
-		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) { //if creation of pipeline layout unsuccessful
+		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &grassCullPipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!"); //throws runtime error
 		}
 
-		VkGraphicsPipelineCreateInfo pipelineInfo = {}; //struct for pipeline information
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 2;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = &depthStencil;
-		pipelineInfo.pColorBlendState = &colorBlending;
-		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = renderPass;
-		pipelineInfo.subpass = 0;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &basePipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphics pipeline!"); //throws runtime error
-		}
-
-		vkDestroyShaderModule(device, fragShaderModule, nullptr); //destroys the fragment shader module
-		vkDestroyShaderModule(device, vertShaderModule, nullptr); //destroys the vertex shader module
-	}
-
-	void createShadowPipeline() {
-		auto vertShaderCode = readFile("shaders/shadowvert.spv"); //stores the vertex shader path
-
-		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode); //sets the vertex shader module by using the shader path
-
-		VkPipelineShaderStageCreateInfo vertShaderStageInfo = {}; //struct for vertex shader stage information
-		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		vertShaderStageInfo.module = vertShaderModule;
-		vertShaderStageInfo.pName = "main";
-
-		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo }; //array for the vertex/fragment shader stage information
+		auto compShaderCode = readFile("shaders/grasscullcomp.spv"); //stores the compute shader path
+		VkShaderModule compShaderModule = createShaderModule(compShaderCode);
 
-		VkPipelineVertexInputStateCreateInfo vertexInputInfo = {}; //struct for vertex input information
-		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		VkPipelineShaderStageCreateInfo compShaderStageInfo = {}; //struct for compute shader stage information
+		compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		compShaderStageInfo.module = compShaderModule;
+		compShaderStageInfo.pName = "main";
 
-		auto bindingDescription = Vertex::getBindingDescription();
-		auto attributeDescriptions = Vertex::getAttributeDescriptions();
-
-		vertexInputInfo.vertexBindingDescriptionCount = 1;
-		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-		vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-		vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+		VkComputePipelineCreateInfo pipelineInfo = {}; //struct for pipeline information
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage = compShaderStageInfo;
+		pipelineInfo.layout = grassCullPipelineLayout;
 
-		VkPipelineInputAssemblyStateCreateInfo inputAssembly = {}; //struct for input assembly information
-		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-		inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-		VkViewport viewport = {}; //struct containing information about the viewport
-		viewport.x = 0.0f; //sets the x position that the viewport starts from
-		viewport.y = 0.0f; //sets the y position that the viewport starts from
-		viewport.width = (float)swapChainExtent.width;
-		viewport.height = (float)swapChainExtent.height;
-		viewport.minDepth = 0.0f; //sets the minimum depth of the viewport
-		viewport.maxDepth = 1.0f; //sets the maximum depth of the viewport
-
-		VkRect2D scissor = {}; //struct for scissor information
-		scissor.offset = { 0, 0 };
-		scissor.extent = swapChainExtent;
+		if (vkCreateComputePipelines(device, pipelineCache.handle, 1, &pipelineInfo, nullptr, &grassCullPipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!"); //throws runtime error
+		}
 
-		VkPipelineViewportStateCreateInfo viewportState = {}; //struct for viewport state information
-		viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-		viewportState.viewportCount = 1;
-		viewportState.pViewports = &viewport;
-		viewportState.scissorCount = 1;
-		viewportState.pScissors = &scissor;
-
-		VkPipelineRasterizationStateCreateInfo rasterizer = {}; //struct for rasterizer information
-		rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-		rasterizer.depthClampEnable = VK_FALSE;
-		rasterizer.rasterizerDiscardEnable = VK_FALSE;
-		rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-		rasterizer.lineWidth = 1.0f;
-		rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-		rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-		rasterizer.depthBiasEnable = VK_FALSE;
-
-		VkPipelineMultisampleStateCreateInfo multisampling = {}; //struct for multisampling information
-		multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-		multisampling.sampleShadingEnable = VK_FALSE;
-		multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-
-		VkPipelineDepthStencilStateCreateInfo depthStencil = {};
-		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = VK_TRUE;
-		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
-		depthStencil.depthBoundsTestEnable = VK_FALSE;
-		depthStencil.stencilTestEnable = VK_FALSE;
+		vkDestroyShaderModule(device, compShaderModule, nullptr); //destroys the compute shader module
+	}
 
-		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {}; //struct for pipeline layout information
+	void createPipelineLayout() {
 		VkPushConstantRange pushConstantInfo = { 0 };
-		pushConstantInfo.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantInfo.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 		pushConstantInfo.offset = 0;
-		pushConstantInfo.size = sizeof(float);
+		pushConstantInfo.size = sizeof(DrawConstants);
 
+		VkDescriptorSetLayout setLayoutHandles[] = { staticSetLayout, frameSetLayout }; //least frequently changed first
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = {}; //struct for pipeline layout information
 		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		pipelineLayoutInfo.setLayoutCount = 1;
-		pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+		pipelineLayoutInfo.setLayoutCount = 2;
+		pipelineLayoutInfo.pSetLayouts = setLayoutHandles;
 		pipelineLayoutInfo.pushConstantRangeCount = 1;
 		pipelineLayoutInfo.pPushConstantRanges = &pushConstantInfo;
 
 		if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) { //if creation of pipeline layout unsuccessful
 			throw std::runtime_error("failed to create pipeline layout!"); //throws runtime error
 		}
-
-		VkGraphicsPipelineCreateInfo pipelineInfo = {}; //struct for pipeline information
-		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-		pipelineInfo.stageCount = 1;
-		pipelineInfo.pStages = shaderStages;
-		pipelineInfo.pVertexInputState = &vertexInputInfo;
-		pipelineInfo.pInputAssemblyState = &inputAssembly;
-		pipelineInfo.pViewportState = &viewportState;
-		pipelineInfo.pRasterizationState = &rasterizer;
-		pipelineInfo.pMultisampleState = &multisampling;
-		pipelineInfo.pDepthStencilState = &depthStencil;
-		pipelineInfo.layout = pipelineLayout;
-		pipelineInfo.renderPass = shadowPass.renderPass;
-		pipelineInfo.subpass = 0;
-		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &shadowPipeline) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create graphics pipeline!"); //throws runtime error
-		}
-
-		vkDestroyShaderModule(device, vertShaderModule, nullptr); //destroys the vertex shader module
 	}
 
-	void createFramebuffers() {
-		swapChainFramebuffers.resize(swapChainImageViews.size()); //gets number of image views and sets number of frame buffers
-
-		for (size_t i = 0; i < swapChainImageViews.size(); i++) { //iterates through image views
-			std::array<VkImageView, 2> attachments = {
-				swapChainImageViews[i],
-				depthImageView,
-			};
-
-			VkFramebufferCreateInfo framebufferInfo = {};
-			framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			framebufferInfo.renderPass = renderPass;
-			framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-			framebufferInfo.pAttachments = attachments.data();
-			framebufferInfo.width = swapChainExtent.width;
-			framebufferInfo.height = swapChainExtent.height;
-			framebufferInfo.layers = 1;
-
-			if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to create framebuffer!"); //throws runtime error
-			}
-		}
+	//describes every graphics pipeline of the current render passes, the registry compiles them in the background
+	uint32_t basePermutation(bool textured, bool lit, bool shadowDebug) {
+		return (textured ? 1 : 0) | (lit ? 2 : 0) | (shadowDebug ? 4 : 0); //index into basePipelines
+	}
 
-		VkFramebufferCreateInfo framebufferInfo = {};
-		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferInfo.renderPass = shadowPass.renderPass;
-		framebufferInfo.attachmentCount = 1;
-		framebufferInfo.pAttachments = &shadowPass.depth.view;
-		framebufferInfo.width = swapChainExtent.width;
-		framebufferInfo.height = swapChainExtent.height;
-		framebufferInfo.layers = 1;
+	void requestGraphicsPipelines() {
+		auto attributeDescriptions = Vertex::getAttributeDescriptions();
 
-		if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &shadowPass.frameBuffer) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create framebuffer!"); //throws runtime error
-		}
+		pipelines::graphicsState meshState = {}; //the model's vertex layout, back faces culled
+		meshState.vertexBindings = { Vertex::getBindingDescription() };
+		meshState.vertexAttributes.assign(attributeDescriptions.begin(), attributeDescriptions.end());
+		meshState.cullMode = VK_CULL_MODE_BACK_BIT;
+
+		uint32_t virtualFeedback = VIRTUAL_TEXTURING ? VK_TRUE : VK_FALSE; //constant 0 of material.glsl
+
+		//render passes and subpass indices come from the frame graph, culled passes get no pipeline
+		pipelines::graphicsState state = meshState;
+		state.vertexShader = "shaders/vert.spv";
+		state.fragmentShader = "shaders/frag.spv";
+		state.depth = pipelines::depthMode::testWrite;
+		state.blend = pipelines::blendMode::alpha;
+		state.renderPass = rendergraph::renderPass(frameGraph, baseNode);
+		state.subpass = rendergraph::subpass(frameGraph, baseNode);
+
+		//every toggle combination is a specialization of shader.frag, compiled up front so toggling never waits
+		//the default variant is queued first and stands in for the others until they are ready
+		uint32_t defaultVariant = basePermutation(true, true, false);
+		for (uint32_t i = 0; i < basePipelines.size(); i++) {
+			uint32_t permutation = (defaultVariant + i) % basePipelines.size();
+			bool textured = (permutation & 1) != 0;
+			bool lit = (permutation & 2) != 0;
+			bool shadowDebug = (permutation & 4) != 0;
+			state.specialization = { virtualFeedback, textured ? VK_TRUE : VK_FALSE, lit ? VK_TRUE : VK_FALSE, shadowDebug ? VK_TRUE : VK_FALSE, static_cast<uint32_t>(SHADOW_PCF_RADIUS) };
+			basePipelines[permutation] = pipelines::request(pipelineRegistry, state, i == 0 ? pipelines::NO_PIPELINE : basePipelines[defaultVariant]);
+		}
+
+		//transparent layers test against the base depth without writing it and accumulate into the OIT targets
+		state = meshState;
+		state.vertexShader = "shaders/finvert.spv";
+		state.fragmentShader = "shaders/finfrag.spv";
+		state.depth = pipelines::depthMode::test;
+		state.blend = pipelines::blendMode::oit;
+		state.specialization = { virtualFeedback }; //the fin, shell and grass shaders sample materials too
+		finPipeline = pipelines::NO_PIPELINE;
+		if (!rendergraph::culled(frameGraph, finNode)) {
+			state.renderPass = rendergraph::renderPass(frameGraph, finNode);
+			state.subpass = rendergraph::subpass(frameGraph, finNode);
+			finPipeline = pipelines::request(pipelineRegistry, state);
+		}
+
+		state.vertexShader = "shaders/shellvert.spv";
+		state.fragmentShader = "shaders/shellfrag.spv";
+		state.renderPass = rendergraph::renderPass(frameGraph, shellNode);
+		state.subpass = rendergraph::subpass(frameGraph, shellNode);
+		shellPipeline = pipelines::request(pipelineRegistry, state);
+
+		state.vertexShader = "shaders/grassvert.spv";
+		state.fragmentShader = "shaders/grassfrag.spv";
+		state.cullMode = VK_CULL_MODE_NONE; //blades are seen from both sides
+		state.specialization = { virtualFeedback, glm::floatBitsToUint(GRASS_BLADE_HEIGHT) };
+		grassPipeline = pipelines::request(pipelineRegistry, state);
+
+		state = meshState;
+		state.vertexShader = "shaders/shadowvert.spv"; //depth only, no fragment stage
+		state.depth = pipelines::depthMode::testWrite;
+		state.blend = pipelines::blendMode::none;
+		state.renderPass = rendergraph::renderPass(frameGraph, shadowNode);
+		state.subpass = rendergraph::subpass(frameGraph, shadowNode);
+		shadowPipeline = pipelines::request(pipelineRegistry, state);
+
+		pipelines::graphicsState resolveState = {}; //fullscreen triangle generated in the vertex shader
+		resolveState.vertexShader = "shaders/oitvert.spv";
+		resolveState.fragmentShader = "shaders/oitfrag.spv";
+		resolveState.cullMode = VK_CULL_MODE_NONE;
+		resolveState.depth = pipelines::depthMode::none; //resolve subpass has no depth attachment
+		resolveState.blend = pipelines::blendMode::alpha; //composites the average transparent color by its total coverage
+		resolveState.renderPass = rendergraph::renderPass(frameGraph, resolveNode);
+		resolveState.subpass = rendergraph::subpass(frameGraph, resolveNode);
+		oitResolvePipeline = pipelines::request(pipelineRegistry, resolveState);
+	}
+
+	//binds the pipeline or its fallback, false while neither has compiled so the caller skips its draws
+	bool bindPipeline(VkCommandBuffer commandBuffer, pipelines::handle pipeline) {
+		VkPipeline handle = pipelines::get(pipelineRegistry, pipeline);
+		if (handle == VK_NULL_HANDLE) {
+			return false;
+		}
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, handle);
+		return true;
 	}
 
 	void createCommandPool() {
@@ -1510,25 +1457,29 @@ private:
 
 		VkCommandPoolCreateInfo poolInfo = {}; //struct for pool information
 		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; //rerecorded every frame, only ever reset with the whole pool
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
-		if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create command pool!");
-		}
-	}
+		commandPools.resize(FRAMES_IN_FLIGHT);
+		commandBuffers.resize(FRAMES_IN_FLIGHT);
+		passCaches.resize(FRAMES_IN_FLIGHT);
+		passVersions.assign(FRAMES_IN_FLIGHT, 0);
 
-	void createDepthResources() {
-		VkFormat depthFormat = findDepthFormat();
-
-		createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthImageMemory);
-		depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-	}
+		for (size_t i = 0; i < FRAMES_IN_FLIGHT; i++) {
+			if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPools[i]) != VK_SUCCESS) {
+				throw std::runtime_error("failed to create command pool!");
+			}
 
-	void createShadowImage() {
-		VkFormat depthFormat = findDepthFormat();
+			VkCommandBufferAllocateInfo allocInfo = {}; //struct for command buffer allocation information
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = commandPools[i];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
 
-		createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shadowPass.depth.image, shadowPass.depth.memory);
-		shadowPass.depth.view = createImageView(shadowPass.depth.image, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+			if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffers[i]) != VK_SUCCESS) { //if command buffers were not successfully allocated
+				throw std::runtime_error("failed to allocate command buffers!"); //throws runtime error
+			}
+		}
 	}
 
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
@@ -1559,63 +1510,101 @@ private:
 		return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 	}
 
-	void createTextureImage() {
-		int texWidth, texHeight, texChannels;
-		stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		VkDeviceSize imageSize = texWidth * texHeight * 4;
+	//the decodes run on the streaming worker, the first frames sample the placeholders and the mip tails
+	//every texture takes a slot of the material texture table, small images share atlas pages
+	void createTextures() {
+		texstream::init(textureStreamer, physicalDevice, device, memoryAllocator, uploadContext, TEXTURE_BUDGET, TEXTURE_UPLOAD_BYTES_PER_FRAME);
 
-		if (!pixels) {
-			throw std::runtime_error("failed to load texture image!");
-		}
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(device, stagingBufferMemory);
-
-		stbi_image_free(pixels);
+		VkFormat colorFormat = texcompress::chooseFormat(physicalDevice, textureCompressionBC, VK_FORMAT_BC7_SRGB_BLOCK, VK_FORMAT_R8G8B8A8_SRGB);
+		materials::init(materialLibrary, textureStreamer, textureSampler, 0, colorFormat, TEXTURE_CACHE_DIRECTORY);
+		vtex::init(virtualTextures, device, memoryAllocator, uploadContext, VIRTUAL_TEXTURING ? VIRTUAL_CACHE_SLOTS : 1); //the bindings exist either way
+		uint32_t furImage;
 
-		createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+		VkComponentMapping identity = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
 
-		transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		if (VIRTUAL_TEXTURING) {
+			furImage = addVirtualFur();
+		}
+		else if (PROCEDURAL_FUR) {
+			//BC5 holds the height in red and the coverage in green, the view hands the shaders RRRG as they expect RGB height and A coverage
+			VkFormat furFormat = texcompress::chooseFormat(physicalDevice, textureCompressionBC, VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_R8G8B8A8_UNORM); //heights and coverage are linear data
+			VkComponentMapping furSwizzle = identity;
+			if (furFormat == VK_FORMAT_BC5_UNORM_BLOCK) {
+				furSwizzle = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G };
+			}
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
+			furImage = materials::addStreamed(materialLibrary, "fur", furFormat, furSwizzle, 0x00000000, [furFormat]() { //the placeholder grows no hair, the fur map repeats so it is never atlased
+				furgen::furParams furSettings = {}; //tuned defaults, change these to restyle the fur
+				std::string cachePath = texcompress::cachePath(TEXTURE_CACHE_DIRECTORY, "furmap_" + std::to_string(furgen::hashParams(furSettings)), furFormat);
 
-		pixels = stbi_load(FIN_TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-		imageSize = texWidth * texHeight * 4;
+				return texcompress::loadOrTranscode(cachePath, "", furFormat, [&furSettings]() {
+					furgen::furTexture furMap = furgen::loadOrGenerate(furSettings, FUR_CACHE_DIRECTORY);
 
-		if (!pixels) {
-			throw std::runtime_error("failed to load texture image!");
+					std::vector<texstream::mipLevel> mips(furMap.mips.size());
+					for (size_t level = 0; level < mips.size(); level++) {
+						mips[level].width = furMap.mips[level].width;
+						mips[level].height = furMap.mips[level].height;
+						mips[level].texels = std::move(furMap.mips[level].texels);
+					}
+					return mips;
+				});
+			});
+		}
+		else {
+			furImage = materials::addStreamed(materialLibrary, "fur", colorFormat, identity, 0x00000000, [colorFormat]() {
+				return texcompress::loadOrTranscode(texcompress::cachePath(TEXTURE_CACHE_DIRECTORY, "furmap", colorFormat), TEXTURE_PATH, colorFormat, []() {
+					return texcompress::decodeImage(TEXTURE_PATH);
+				});
+			});
 		}
 
-		createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		uint32_t finImage = materials::addImage(materialLibrary, FIN_TEXTURE_PATH); //small enough for an atlas page
 
-		vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vkUnmapMemory(device, stagingBufferMemory);
+		furMaterial = materials::addMaterial(materialLibrary, furImage);
+		finMaterial = materials::addMaterial(materialLibrary, finImage);
 
-		stbi_image_free(pixels);
+		materials::build(materialLibrary, device, memoryAllocator, uploadContext);
 
-		createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImageFin, textureImageFinMemory);
+		furTexture = materials::streamedTexture(materialLibrary, furImage);
+		finTexture = materials::streamedTexture(materialLibrary, finImage);
+	}
 
-		transitionImageLayout(textureImageFin, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		copyBufferToImage(stagingBuffer, textureImageFin, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
-		transitionImageLayout(textureImageFin, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	//there is no map of that size to ship, so the fur map is repeated across VIRTUAL_FUR_SIZE texels and tiled once
+	uint32_t addVirtualFur() {
+		vtex::fileHeader header;
+		if (!vtex::readHeader(VIRTUAL_FUR_PATH, header)) {
+			std::vector<uint8_t> source;
+			uint32_t sourceWidth, sourceHeight;
+			bool srgb;
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
-	}
+			if (PROCEDURAL_FUR) {
+				furgen::furTexture furMap = furgen::loadOrGenerate(furgen::furParams(), FUR_CACHE_DIRECTORY);
+				sourceWidth = furMap.mips[0].width;
+				sourceHeight = furMap.mips[0].height;
+				source = std::move(furMap.mips[0].texels);
+				srgb = false; //heights and coverage are linear data
+			}
+			else {
+				std::vector<texstream::mipLevel> decoded = texcompress::decodeImage(TEXTURE_PATH);
+				sourceWidth = decoded[0].width;
+				sourceHeight = decoded[0].height;
+				source = std::move(decoded[0].texels);
+				srgb = true;
+			}
+
+			vtex::tile(VIRTUAL_FUR_PATH, VIRTUAL_FUR_SIZE, VIRTUAL_FUR_SIZE, srgb, true, [&](uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t* rgba) {
+				for (uint32_t row = 0; row < height; row++) {
+					for (uint32_t column = 0; column < width; column++) {
+						const uint8_t* texel = &source[(((y + row) % sourceHeight) * sourceWidth + (x + column) % sourceWidth) * 4];
+						memcpy(rgba + (row * width + column) * 4, texel, 4);
+					}
+				}
+			});
+		}
 
-	void createTextureImageView() {
-		textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
-		textureImageFinView = createImageView(textureImageFin, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+		uint32_t layer = vtex::add(virtualTextures, VIRTUAL_FUR_PATH);
+		const vtex::fileHeader& tiled = vtex::header(virtualTextures, layer);
+		return materials::addVirtual(materialLibrary, layer, tiled.width, tiled.height, tiled.levels, tiled.srgb != 0);
 	}
 
 	void createSamplers() {
@@ -1633,6 +1622,9 @@ private:
 		samplerInfo.compareEnable = VK_FALSE;
 		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
 		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.mipLodBias = 0.0f;
+		samplerInfo.minLod = 0.0f; //level 0 of a streamed view is its top resident level
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE; //every streamed texture carries its chain down to 1x1, sizes are only known once decoded
 
 		if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create texture sampler!");
@@ -1654,14 +1646,14 @@ private:
 		shadowSamplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
 		shadowSamplerInfo.mipLodBias = 0.0f;
 		shadowSamplerInfo.minLod = 0.0f;
-		shadowSamplerInfo.maxLod = 100.0f;
+		shadowSamplerInfo.maxLod = 0.0f; //the shadow map has a single level
 
-		if (vkCreateSampler(device, &shadowSamplerInfo, nullptr, &shadowPass.depthSampler) != VK_SUCCESS) {
+		if (vkCreateSampler(device, &shadowSamplerInfo, nullptr, &shadowSampler) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create texture sampler!");
 		}
 	}
 
-	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags) {
+	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels) {
 		VkImageViewCreateInfo viewInfo = {};
 		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 		viewInfo.image = image;
@@ -1669,7 +1661,7 @@ private:
 		viewInfo.format = format;
 		viewInfo.subresourceRange.aspectMask = aspectFlags;
 		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.levelCount = mipLevels;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 1;
 
@@ -1681,14 +1673,14 @@ private:
 		return imageView;
 	}
 
-	void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, memalloc::allocation& imageMemory) {
 		VkImageCreateInfo imageInfo = {};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
 		imageInfo.extent.width = width;
 		imageInfo.extent.height = height;
 		imageInfo.extent.depth = 1;
-		imageInfo.mipLevels = 1;
+		imageInfo.mipLevels = mipLevels;
 		imageInfo.arrayLayers = 1;
 		imageInfo.format = format;
 		imageInfo.tiling = tiling;
@@ -1701,91 +1693,7 @@ private:
 			throw std::runtime_error("failed to create image!");
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetImageMemoryRequirements(device, image, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate image memory!");
-		}
-
-		vkBindImageMemory(device, image, imageMemory, 0);
-	}
-
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkImageMemoryBarrier barrier = {};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.oldLayout = oldLayout;
-		barrier.newLayout = newLayout;
-		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-		barrier.image = image;
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = 1;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-
-		VkPipelineStageFlags sourceStage;
-		VkPipelineStageFlags destinationStage;
-
-		if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-			barrier.srcAccessMask = 0;
-			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-			destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		}
-		else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-			sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		}
-		else {
-			throw std::invalid_argument("unsupported layout transition!");
-		}
-
-		vkCmdPipelineBarrier(
-			commandBuffer,
-			sourceStage, destinationStage,
-			0,
-			0, nullptr,
-			0, nullptr,
-			1, &barrier
-		);
-
-		endSingleTimeCommands(commandBuffer);
-	}
-
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-		VkBufferImageCopy region = {};
-		region.bufferOffset = 0;
-		region.bufferRowLength = 0;
-		region.bufferImageHeight = 0;
-		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		region.imageSubresource.mipLevel = 0;
-		region.imageSubresource.baseArrayLayer = 0;
-		region.imageSubresource.layerCount = 1;
-		region.imageOffset = { 0, 0, 0 };
-		region.imageExtent = {
-			width,
-			height,
-			1
-		};
-
-		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-		endSingleTimeCommands(commandBuffer);
+		imageMemory = memalloc::allocateForImage(memoryAllocator, image, tiling, properties); //suballocates and binds, large images get dedicated memory
 	}
 
 	//checks which edges are silhouette edges and creates quads based on these vertices
@@ -2032,314 +1940,222 @@ private:
 		indices.push_back(uniqueVertices[vertexC]);
 	}
 
-	void createVertexBuffers() {
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-
-		vertexBuffers.resize(swapChainImages.size());
-		vertexBuffersMemory.resize(swapChainImages.size());
-
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	//packs every static mesh into the geometry pool, the silhouette quads are static too so one copy serves every swap chain image
+	void createGeometryPool() {
+		geometry::init(geometryPool, sizeof(Vertex));
 
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, vertices.data(), (size_t)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemory);
+		modelMesh = geometry::add(geometryPool, vertices.data(), static_cast<uint32_t>(vertices.size()), indices); //first, so the fur pass binds it at offset 0
+		silhouetteMesh = geometry::add(geometryPool, quadVertices.data(), static_cast<uint32_t>(quadVertices.size()), quadIndices);
 
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffers[i], vertexBuffersMemory[i]);
-
-			copyBuffer(stagingBuffer, vertexBuffers[i], bufferSize);
+		//unit grass patch, scaled and rotated per instance in grass.vert
+		std::vector<Vertex> patchVertices(4);
+		std::vector<uint32_t> patchIndices = { 0, 1, 2, 2, 3, 0 };
+		glm::vec2 corners[4] = { { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f } };
+		for (size_t i = 0; i < patchVertices.size(); i++) {
+			patchVertices[i].pos = glm::vec3(corners[i].x, 0.0f, corners[i].y);
+			patchVertices[i].color = { 0.309f, 0.949f, 0.270f };
+			patchVertices[i].texCoord = corners[i] + glm::vec2(0.5f);
+			patchVertices[i].normal = { 0.0f, 1.0f, 0.0f };
 		}
+		grassPatchMesh = geometry::add(geometryPool, patchVertices.data(), static_cast<uint32_t>(patchVertices.size()), patchIndices);
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
-
-		bufferSize = sizeof(quadVertices[0]) * quadVertices.size();
-
-		quadVertexBuffers.resize(swapChainImages.size());
-		quadVertexBuffersMemory.resize(swapChainImages.size());
-
-		VkBuffer stagingBufferQuads;
-		VkDeviceMemory stagingBufferMemoryQuads;
-
-		bufferSize = sizeof(quadVertices[0]) * quadVertices.size();
-
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferQuads, stagingBufferMemoryQuads);
-
-		vkMapMemory(device, stagingBufferMemoryQuads, 0, bufferSize, 0, &data);
-		memcpy(data, quadVertices.data(), (size_t)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemoryQuads);
-
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, quadVertexBuffers[i], quadVertexBuffersMemory[i]);
-
-			copyBuffer(stagingBufferQuads, quadVertexBuffers[i], bufferSize);
-		}
-
-		vkDestroyBuffer(device, stagingBufferQuads, nullptr);
-		vkFreeMemory(device, stagingBufferMemoryQuads, nullptr);
+		geometry::build(geometryPool, device, memoryAllocator, uploadContext, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT); //the fur simulation reads the model's vertices
 	}
 
-	void updateSilhouetteVertexBuffers(uint32_t imageIndex) {
-		VkDeviceSize bufferSize = sizeof(quadVertices[0]) * quadVertices.size();
-
-		VkBuffer stagingBufferQuads;
-		VkDeviceMemory stagingBufferMemoryQuads;
-
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferQuads, stagingBufferMemoryQuads);
-
-		void* data;
-		vkMapMemory(device, stagingBufferMemoryQuads, 0, bufferSize, 0, &data);
-		memcpy(data, quadVertices.data(), (size_t)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemoryQuads);
+	void createFurStateBuffer() {
+		VkDeviceSize bufferSize = sizeof(glm::vec4) * 2 * vertices.size();
 
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, quadVertexBuffers[imageIndex], quadVertexBuffersMemory[imageIndex]);
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, furStateBuffer, furStateBufferMemory);
 
-		copyBuffer(stagingBufferQuads, quadVertexBuffers[imageIndex], bufferSize);
-
-		vkDestroyBuffer(device, stagingBufferQuads, nullptr);
-		vkFreeMemory(device, stagingBufferMemoryQuads, nullptr);
+		//hair starts at rest
+		vkCmdFillBuffer(upload::commands(uploadContext), furStateBuffer, 0, VK_WHOLE_SIZE, 0);
 	}
 
-	void createIndexBuffers() {
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-
-		indexBuffers.resize(swapChainImages.size());
-		indexBuffersMemory.resize(swapChainImages.size());
+	//scatters the grass patches over the ground plane on a jittered grid and creates the buffers the culling pass fills
+	void createGrassField() {
+		const float fieldSize = 200.0f; //matches the ground plane built in loadModel
+		const float groundHeight = -15.0f;
+		float spacing = fieldSize / GRASS_PATCHES_PER_SIDE;
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+		std::vector<GrassPatch> patches(GRASS_PATCH_COUNT);
+		uint32_t state = 0x9e3779b9u;
+		auto random = [&state]() { //xorshift, the field only needs to look irregular
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return (state >> 8) * (1.0f / 16777216.0f);
+		};
 
-		void* data;
-		vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-		memcpy(data, indices.data(), (size_t)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemory);
+		for (uint32_t z = 0; z < GRASS_PATCHES_PER_SIDE; z++) {
+			for (uint32_t x = 0; x < GRASS_PATCHES_PER_SIDE; x++) {
+				float yaw = random() * glm::radians(360.0f);
+				float scale = spacing * (1.2f + 0.3f * random()); //patches overlap so no ground shows between them
 
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffers[i], indexBuffersMemory[i]);
-
-			copyBuffer(stagingBuffer, indexBuffers[i], bufferSize);
+				GrassPatch& patch = patches[z * GRASS_PATCHES_PER_SIDE + x];
+				patch.positionScale = glm::vec4(-fieldSize * 0.5f + (x + random()) * spacing, groundHeight + 0.01f, -fieldSize * 0.5f + (z + random()) * spacing, scale);
+				patch.rotationOffset = glm::vec4(cos(yaw), sin(yaw), random(), random());
+			}
 		}
 
-		vkDestroyBuffer(device, stagingBuffer, nullptr);
-		vkFreeMemory(device, stagingBufferMemory, nullptr);
-
-		bufferSize = sizeof(quadIndices[0]) * quadIndices.size();
+		//bounding sphere around the patch centre, in units of the patch scale
+		float minimumScale = spacing * 1.2f;
+		grassPatchRadius = glm::length(glm::vec2(0.5f, 0.5f)) + GRASS_BLADE_HEIGHT / minimumScale;
 
-		quadIndexBuffers.resize(swapChainImages.size());
-		quadIndexBuffersMemory.resize(swapChainImages.size());
-
-		VkBuffer stagingBufferQuads;
-		VkDeviceMemory stagingBufferMemoryQuads;
-
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferQuads, stagingBufferMemoryQuads);
-
-		vkMapMemory(device, stagingBufferMemoryQuads, 0, bufferSize, 0, &data);
-		memcpy(data, quadIndices.data(), (size_t)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemoryQuads);
-
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, quadIndexBuffers[i], quadIndexBuffersMemory[i]);
-
-			copyBuffer(stagingBufferQuads, quadIndexBuffers[i], bufferSize);
-		}
+		VkDeviceSize bufferSize = sizeof(GrassPatch) * patches.size();
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, grassPatchBuffer, grassPatchBufferMemory);
+		upload::copyToBuffer(uploadContext, patches.data(), bufferSize, grassPatchBuffer, 0);
 
-		vkDestroyBuffer(device, stagingBufferQuads, nullptr);
-		vkFreeMemory(device, stagingBufferMemoryQuads, nullptr);
+		createBuffer(sizeof(glm::uvec2) * GRASS_SHELL_CAPACITY, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, grassShellBuffer, grassShellBufferMemory);
+		createBuffer(sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, grassDrawBuffer, grassDrawBufferMemory);
 	}
 
-	void updateSilhouetteIndexBuffers(uint32_t imageIndex) {
-		VkDeviceSize bufferSize = sizeof(quadIndices[0]) * quadIndices.size();
+	void createUniformRing() {
+		uniforms::init(uniformRing, physicalDevice, device, memoryAllocator, frameTimeline, FRAMES_IN_FLIGHT);
 
-		VkBuffer stagingBufferQuads;
-		VkDeviceMemory stagingBufferMemoryQuads;
+		uboBlock = uniforms::addBlock(uniformRing, sizeof(UniformBufferObject));
+		shadowBlock = uniforms::addBlock(uniformRing, sizeof(ShadowBufferObject));
+		lightingBlock = uniforms::addBlock(uniformRing, sizeof(LightingConstants));
+		furDynamicsBlock = uniforms::addBlock(uniformRing, sizeof(FurDynamicsObject));
+		grassCullBlock = uniforms::addBlock(uniformRing, sizeof(GrassCullObject));
 
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferQuads, stagingBufferMemoryQuads);
-
-		void* data;
-		vkMapMemory(device, stagingBufferMemoryQuads, 0, bufferSize, 0, &data);
-		memcpy(data, quadIndices.data(), (size_t)bufferSize);
-		vkUnmapMemory(device, stagingBufferMemoryQuads);
-
-		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, quadIndexBuffers[imageIndex], quadIndexBuffersMemory[imageIndex]);
-
-		copyBuffer(stagingBufferQuads, quadIndexBuffers[imageIndex], bufferSize);
-
-		vkDestroyBuffer(device, stagingBufferQuads, nullptr);
-		vkFreeMemory(device, stagingBufferMemoryQuads, nullptr);
+		uniforms::create(uniformRing);
 	}
 
-	void createUniformBuffers() {
-		VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-
-		uniformBuffers.resize(swapChainImages.size());
-		uniformBuffersMemory.resize(swapChainImages.size());
-
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
-		}
-
-		bufferSize = sizeof(ShadowBufferObject);
-
-		shadowUniformBuffers.resize(swapChainImages.size());
-		shadowUniformBuffersMemory.resize(swapChainImages.size());
-
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, shadowUniformBuffers[i], shadowUniformBuffersMemory[i]);
-		}
-	}
-
-	void createLightingBuffers() {
-		VkDeviceSize bufferSize = sizeof(LightingConstants);
-
-		lightingBuffers.resize(swapChainImages.size());
-		lightingBuffersMemory.resize(swapChainImages.size());
+	void createDescriptorAllocators() {
+		//average descriptors per set, pools grow by whole pools when these run out
+		std::vector<descriptors::poolRatio> staticRatios = {
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, (materials::MAX_TEXTURES + 3) / 2.0f }, //the compute sets hold none
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f },
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f }
+		};
+		descriptors::init(staticDescriptors, device, setLayouts, staticRatios, 8);
 
-		for (size_t i = 0; i < swapChainImages.size(); i++) {
-			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, lightingBuffers[i], lightingBuffersMemory[i]);
-		}
-	}
+		std::vector<descriptors::poolRatio> swapChainRatios = {
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 3.0f },
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f },
+			{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 2.0f },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f }
+		};
+		descriptors::init(swapChainDescriptors, device, setLayouts, swapChainRatios, 4);
 
-	void createDescriptorPool() {
-		std::array<VkDescriptorPoolSize, 5> poolSizes = {};
-		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
-		poolSizes[1].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[1].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
-		poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[2].descriptorCount = static_cast<uint32_t>(swapChainImages.size()) * 2;
-		poolSizes[3].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[3].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
-		poolSizes[4].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		poolSizes[4].descriptorCount = static_cast<uint32_t>(swapChainImages.size());
+		//ImGui allocates a single set for its font atlas
+		VkDescriptorPoolSize imguiPoolSize = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 };
 
 		VkDescriptorPoolCreateInfo poolInfo = {};
 		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
-
-		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create descriptor pool!");
-		}
-
-		std::array<VkDescriptorPoolSize, 11> pool_sizes = {};
-		pool_sizes[0] = { VK_DESCRIPTOR_TYPE_SAMPLER, 1000 };
-		pool_sizes[1] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000 };
-		pool_sizes[2] = { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000 };
-		pool_sizes[3] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000 };
-		pool_sizes[4] = { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000 };
-		pool_sizes[5] = { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000 };
-		pool_sizes[6] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000 };
-		pool_sizes[7] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000 };
-		pool_sizes[8] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000 };
-		pool_sizes[9] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000 };
-		pool_sizes[10] = { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000 };
-
-		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-		poolInfo.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
-		poolInfo.pPoolSizes = pool_sizes.data();
-		poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &imguiPoolSize;
+		poolInfo.maxSets = 1;
 
 		if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &imgui_descriptorPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create descriptor pool!");
 		}
 	}
 
-	void createDescriptorSets() {
-		std::vector<VkDescriptorSetLayout> layouts(swapChainImages.size(), descriptorSetLayout);
-		VkDescriptorSetAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-		allocInfo.descriptorPool = descriptorPool;
-		allocInfo.descriptorSetCount = static_cast<uint32_t>(swapChainImages.size());
-		allocInfo.pSetLayouts = layouts.data();
-
-		descriptorSets.resize(swapChainImages.size());
-		if (vkAllocateDescriptorSets(device, &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate descriptor sets!");
-		}
+	void createStaticDescriptorSets() {
+		VkDescriptorImageInfo imageInfo[materials::MAX_TEXTURES];
+		materials::textureTable(materialLibrary, imageInfo); //every slot is written, the unused ones with the default image
+
+		VkDescriptorBufferInfo materialBufferInfo = {};
+		materialBufferInfo.buffer = materialLibrary.materialBuffer;
+		materialBufferInfo.offset = 0;
+		materialBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorImageInfo pageTableInfo = vtex::pageTableInfo(virtualTextures);
+
+		VkDescriptorImageInfo pageCacheInfo[2];
+		vtex::cacheInfos(virtualTextures, pageCacheInfo);
+
+		VkDescriptorBufferInfo furStateBufferInfo = {};
+		furStateBufferInfo.buffer = furStateBuffer;
+		furStateBufferInfo.offset = 0;
+		furStateBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo grassPatchBufferInfo = {};
+		grassPatchBufferInfo.buffer = grassPatchBuffer;
+		grassPatchBufferInfo.offset = 0;
+		grassPatchBufferInfo.range = VK_WHOLE_SIZE;
+
+		VkDescriptorBufferInfo grassShellBufferInfo = {};
+		grassShellBufferInfo.buffer = grassShellBuffer;
+		grassShellBufferInfo.offset = 0;
+		grassShellBufferInfo.range = VK_WHOLE_SIZE;
+
+		descriptors::contents staticContents;
+		descriptors::addImages(staticContents, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageInfo, materials::MAX_TEXTURES);
+		descriptors::addBuffer(staticContents, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, materialBufferInfo);
+		descriptors::addImages(staticContents, 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &pageTableInfo, 1);
+		descriptors::addImages(staticContents, 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, pageCacheInfo, 2);
+		descriptors::addBuffer(staticContents, 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, furStateBufferInfo);
+		descriptors::addBuffer(staticContents, 5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, grassPatchBufferInfo);
+		descriptors::addBuffer(staticContents, 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, grassShellBufferInfo);
+
+		//not cached, the streamer rewrites texture table entries in place once the set's frame has finished
+		texstream::resetBindings(textureStreamer, FRAMES_IN_FLIGHT);
+		staticSets.resize(FRAMES_IN_FLIGHT);
+		for (uint32_t frame = 0; frame < FRAMES_IN_FLIGHT; frame++) {
+			staticSets[frame] = descriptors::allocate(staticDescriptors, staticSetLayout);
+			descriptors::write(device, staticSets[frame], staticContents);
+			texstream::markBound(textureStreamer, frame);
+		}
+
+		//the compute sets hold the same buffers for every frame, the uniform ring slice comes from the dynamic offset
+		VkDescriptorBufferInfo vertexBufferInfo = {};
+		vertexBufferInfo.buffer = geometryPool.vertexBuffer;
+		vertexBufferInfo.offset = modelMesh.vertexOffset * sizeof(Vertex);
+		vertexBufferInfo.range = modelMesh.vertexCount * sizeof(Vertex);
+
+		descriptors::contents furContents;
+		descriptors::addBuffer(furContents, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vertexBufferInfo);
+		descriptors::addBuffer(furContents, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, furStateBufferInfo);
+		descriptors::addBuffer(furContents, 2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniforms::bufferInfo(uniformRing, furDynamicsBlock));
+		furDynamicsDescriptorSet = descriptors::get(staticDescriptors, furDynamicsDescriptorSetLayout, furContents);
+
+		VkDescriptorBufferInfo grassDrawBufferInfo = {};
+		grassDrawBufferInfo.buffer = grassDrawBuffer;
+		grassDrawBufferInfo.offset = 0;
+		grassDrawBufferInfo.range = VK_WHOLE_SIZE;
+
+		descriptors::contents grassContents;
+		descriptors::addBuffer(grassContents, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, grassPatchBufferInfo);
+		descriptors::addBuffer(grassContents, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, grassShellBufferInfo);
+		descriptors::addBuffer(grassContents, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, grassDrawBufferInfo);
+		descriptors::addBuffer(grassContents, 3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniforms::bufferInfo(uniformRing, grassCullBlock));
+		grassCullDescriptorSet = descriptors::get(staticDescriptors, grassCullDescriptorSetLayout, grassContents);
+	}
+
+	void createFrameDescriptorSets() {
+		VkDescriptorImageInfo shadowImageInfo = {};
+		shadowImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		shadowImageInfo.imageView = rendergraph::view(frameGraph, shadowMap);
+		shadowImageInfo.sampler = shadowSampler;
+
+		VkDescriptorImageInfo oitImageInfo[2] = {};
+		oitImageInfo[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		oitImageInfo[0].imageView = rendergraph::view(frameGraph, oitAccum);
+		oitImageInfo[0].sampler = VK_NULL_HANDLE;
+
+		oitImageInfo[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		oitImageInfo[1].imageView = rendergraph::view(frameGraph, oitRevealage);
+		oitImageInfo[1].sampler = VK_NULL_HANDLE;
+
+		frameSets.resize(swapChainImages.size());
 
 		for (size_t i = 0; i < swapChainImages.size(); i++) {
+			descriptors::contents frameContents;
+			descriptors::addBuffer(frameContents, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniforms::bufferInfo(uniformRing, uboBlock)); //the draws add the slice of the frame in flight
+			descriptors::addBuffer(frameContents, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniforms::bufferInfo(uniformRing, lightingBlock));
+			descriptors::addBuffer(frameContents, 2, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uniforms::bufferInfo(uniformRing, shadowBlock));
+			descriptors::addImages(frameContents, 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, &shadowImageInfo, 1);
+			descriptors::addImages(frameContents, 4, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, &oitImageInfo[0], 1);
+			descriptors::addImages(frameContents, 5, VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, &oitImageInfo[1], 1);
+			descriptors::addBuffer(frameContents, 6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, vtex::feedbackInfo(virtualTextures, static_cast<uint32_t>(i)));
+
+			frameSets[i] = descriptors::get(swapChainDescriptors, frameSetLayout, frameContents);
+		}
+	}
 
-			VkDescriptorBufferInfo bufferInfo = {};
-			bufferInfo.buffer = uniformBuffers[i];
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
-
-			VkDescriptorBufferInfo shadowBufferInfo = {};
-			shadowBufferInfo.buffer = shadowUniformBuffers[i];
-			shadowBufferInfo.offset = 0;
-			shadowBufferInfo.range = sizeof(ShadowBufferObject);
-
-			VkDescriptorBufferInfo lightingBufferInfo = {};
-			lightingBufferInfo.buffer = lightingBuffers[i];
-			lightingBufferInfo.offset = 0;
-			lightingBufferInfo.range = sizeof(LightingConstants);
-
-			VkDescriptorImageInfo imageInfo[2];
-			imageInfo[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo[0].imageView = textureImageView;
-			imageInfo[0].sampler = textureSampler;
-
-			imageInfo[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo[1].imageView = textureImageFinView;
-			imageInfo[1].sampler = textureSampler;
-
-			VkDescriptorImageInfo shadowImageInfo = {};
-			shadowImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			shadowImageInfo.imageView = shadowPass.depth.view;
-			shadowImageInfo.sampler = shadowPass.depthSampler;
-
-			std::array<VkWriteDescriptorSet, 5> descriptorWrites = {};
-
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = descriptorSets[i];
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[1].dstSet = descriptorSets[i];
-			descriptorWrites[1].dstBinding = 1;
-			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].pBufferInfo = &lightingBufferInfo;
-
-			descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[2].dstSet = descriptorSets[i];
-			descriptorWrites[2].dstBinding = 2;
-			descriptorWrites[2].dstArrayElement = 0;
-			descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[2].descriptorCount = 2;
-			descriptorWrites[2].pImageInfo = imageInfo;
-
-			descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[3].dstSet = descriptorSets[i];
-			descriptorWrites[3].dstBinding = 3;
-			descriptorWrites[3].dstArrayElement = 0;
-			descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[3].descriptorCount = 1;
-			descriptorWrites[3].pBufferInfo = &shadowBufferInfo;
-
-			descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[4].dstSet = descriptorSets[i];
-			descriptorWrites[4].dstBinding = 4;
-			descriptorWrites[4].dstArrayElement = 0;
-			descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[4].descriptorCount = 1;
-			descriptorWrites[4].pImageInfo = &shadowImageInfo;
-
-			vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-		}
-	}
-
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, memalloc::allocation& bufferMemory) {
 		VkBufferCreateInfo bufferInfo = {};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
@@ -2350,318 +2166,403 @@ private:
 			throw std::runtime_error("failed to create buffer!");
 		}
 
-		VkMemoryRequirements memRequirements;
-		vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-		VkMemoryAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-		if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate buffer memory!");
-		}
-
-		vkBindBufferMemory(device, buffer, bufferMemory, 0);
+		bufferMemory = memalloc::allocateForBuffer(memoryAllocator, buffer, properties); //suballocates and binds
 	}
 
-	VkCommandBuffer beginSingleTimeCommands() {
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = commandPool;
-		allocInfo.commandBufferCount = 1;
-
-		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
+	//dynamic state, geometry and descriptor sets a secondary command buffer must bind before drawing, none is inherited
+	void beginSecondary(VkCommandBuffer commandBuffer, VkDescriptorSet frameSet, const std::array<uint32_t, 3>& frameOffsets) {
+		//dynamic in every graphics pipeline, both render passes cover the swap chain extent
+		VkViewport viewport = {};
+		viewport.width = (float)swapChainExtent.width;
+		viewport.height = (float)swapChainExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		VkRect2D scissor = {};
+		scissor.offset = { 0, 0 };
+		scissor.extent = swapChainExtent;
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		geometry::bind(geometryPool, commandBuffer);
 
-		return commandBuffer;
+		std::array<VkDescriptorSet, 2> sceneSets = { staticSets[currentFrame], frameSet };
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, static_cast<uint32_t>(sceneSets.size()), sceneSets.data(), static_cast<uint32_t>(frameOffsets.size()), frameOffsets.data());
 	}
 
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-		vkEndCommandBuffer(commandBuffer);
-
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
-
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue);
-
-		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	void pushDrawConstants(VkCommandBuffer commandBuffer, const DrawConstants& drawConstants) {
+		vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(drawConstants), &drawConstants);
 	}
 
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-		VkCommandBufferAllocateInfo allocInfo = {};
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandPool = commandPool;
-		allocInfo.commandBufferCount = 1;
-
-		VkCommandBuffer commandBuffer;
-		vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-		vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-		VkBufferCopy copyRegion = {};
-		copyRegion.size = size;
-		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-		vkEndCommandBuffer(commandBuffer);
+	//every cached secondary is recorded again the next time its frame in flight uses it
+	void invalidateRecordedPasses() {
+		for (uint64_t& version : passVersions) {
+			version++;
+		}
+	}
 
-		VkSubmitInfo submitInfo = {};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffer;
+	//records the passes into secondary command buffers on the recorder's workers, the primary buffer runs the compute
+	//work and executes them inside the render passes. Only the UI changes every frame, the scene passes are cached per
+	//frame in flight and swap chain image and recorded again when passVersions says their commands changed
+	void createCommandBuffers(uint32_t imageIndex, const FramePacket& packet) {
+		const uint32_t CACHED_PASSES = 5; //shadow, base, fin, shell and grass
+		std::vector<recorder::cached>& caches = passCaches[currentFrame];
+		if (caches.size() < swapChainImages.size() * CACHED_PASSES) {
+			caches.resize(swapChainImages.size() * CACHED_PASSES); //never shrinks, the recorder frees the buffers it replaces
+		}
+		recorder::cached* imageCaches = &caches[imageIndex * CACHED_PASSES];
+		uint64_t passVersion = passVersions[currentFrame];
 
-		vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-		vkQueueWaitIdle(graphicsQueue);
+		//every uniform binding reads the slice of the current frame in flight, the frame set has three of them
+		uint32_t uniformOffset = uniforms::frameOffset(uniformRing);
+		std::array<uint32_t, 3> frameOffsets = { uniformOffset, uniformOffset, uniformOffset };
+		VkDescriptorSet frameSet = frameSets[imageIndex];
 
-		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-	}
+		//every pass draws only once its pipeline has compiled, the render passes still run and clear
+		std::vector<recorder::pass> passes;
+		std::vector<uint32_t> passNodes; //the frame graph pass each secondary is executed in
 
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+		//inherits the render pass, subpass and framebuffer the frame graph gave the pass
+		auto graphDraws = [this, imageIndex, passVersion](uint32_t node, recorder::cached* cache) {
+			recorder::pass draws;
+			draws.renderPass = rendergraph::renderPass(frameGraph, node);
+			draws.subpass = rendergraph::subpass(frameGraph, node);
+			draws.framebuffer = rendergraph::framebuffer(frameGraph, node, imageIndex);
+			draws.cache = cache;
+			draws.version = passVersion;
+			return draws;
+		};
 
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
+		recorder::pass shadowDraws = graphDraws(shadowNode, &imageCaches[0]);
+		shadowDraws.record = [this, frameSet, frameOffsets](VkCommandBuffer commandBuffer) {
+			beginSecondary(commandBuffer, frameSet, frameOffsets);
+			if (bindPipeline(commandBuffer, shadowPipeline)) {
+				geometry::draw(modelMesh, commandBuffer, 1);
+			}
+		};
+		passes.push_back(shadowDraws);
+		passNodes.push_back(shadowNode);
+
+		//Base subpass
+		uint32_t basePermutationIndex = basePermutation(packet.renderTexture, packet.renderLighting, packet.renderShadowMap);
+		recorder::pass baseDraws = graphDraws(baseNode, &imageCaches[1]);
+		baseDraws.record = [this, frameSet, frameOffsets, basePermutationIndex](VkCommandBuffer commandBuffer) {
+			beginSecondary(commandBuffer, frameSet, frameOffsets);
+			if (bindPipeline(commandBuffer, basePipelines[basePermutationIndex])) {
+				DrawConstants drawConstants = {};
+				drawConstants.material = furMaterial; //switching material is a push, the descriptor set stays bound
+				pushDrawConstants(commandBuffer, drawConstants);
+
+				geometry::draw(modelMesh, commandBuffer, 1);
 			}
+		};
+		passes.push_back(baseDraws);
+		passNodes.push_back(baseNode);
+
+		//Fin subpass, culled by the frame graph unless RENDER_FINS
+		if (!rendergraph::culled(frameGraph, finNode)) {
+			recorder::pass finDraws = graphDraws(finNode, &imageCaches[2]);
+			finDraws.record = [this, frameSet, frameOffsets](VkCommandBuffer commandBuffer) {
+				beginSecondary(commandBuffer, frameSet, frameOffsets);
+				if (bindPipeline(commandBuffer, finPipeline)) {
+					DrawConstants drawConstants = {};
+					drawConstants.material = finMaterial;
+					pushDrawConstants(commandBuffer, drawConstants);
+
+					//geometry::draw(silhouetteMesh, commandBuffer, 1);
+				}
+			};
+			passes.push_back(finDraws);
+			passNodes.push_back(finNode);
 		}
 
-		throw std::runtime_error("failed to find suitable memory type!");
-	}
-
-	void createCommandBuffers() {
-		commandBuffers.resize(swapChainFramebuffers.size()); //gets number of frame buffers
+		//Shell subpass, layers are accumulated unsorted into the OIT targets
+		recorder::pass shellDraws = graphDraws(shellNode, &imageCaches[3]);
+		shellDraws.record = [this, frameSet, frameOffsets](VkCommandBuffer commandBuffer) {
+			beginSecondary(commandBuffer, frameSet, frameOffsets);
+			if (bindPipeline(commandBuffer, shellPipeline)) {
+				float maxLayer = 1.0f;
+				float noOfLayers = 40.0f;
 
-		VkCommandBufferAllocateInfo allocInfo = {}; //struct for command buffer allocation information
-		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-		allocInfo.commandPool = commandPool;
-		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
+				DrawConstants drawConstants = {};
+				drawConstants.currentLayer = 0.0f;
+				drawConstants.material = furMaterial;
+				pushDrawConstants(commandBuffer, drawConstants);
 
-		if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) != VK_SUCCESS) { //if command buffers were not successfully allocated
-			throw std::runtime_error("failed to allocate command buffers!"); //throws runtime error
+				while (drawConstants.currentLayer <= maxLayer)
+				{
+					geometry::draw(modelMesh, commandBuffer, 1);
+					drawConstants.currentLayer += (maxLayer / noOfLayers);
+					pushDrawConstants(commandBuffer, drawConstants);
+				}
+			}
+		};
+		passes.push_back(shellDraws);
+		passNodes.push_back(shellNode);
+
+		//Grass field, every visible patch layer in a single draw whatever the patch count, recorded beside the shells
+		if (packet.renderGrass) {
+			recorder::pass grassDraws = shellDraws;
+			grassDraws.cache = &imageCaches[4];
+			grassDraws.record = [this, frameSet, frameOffsets](VkCommandBuffer commandBuffer) {
+				beginSecondary(commandBuffer, frameSet, frameOffsets);
+				if (bindPipeline(commandBuffer, grassPipeline)) {
+					DrawConstants drawConstants = {};
+					drawConstants.material = furMaterial; //grass reuses the fur map for its blade heights
+					pushDrawConstants(commandBuffer, drawConstants);
+
+					vkCmdDrawIndexedIndirect(commandBuffer, grassDrawBuffer, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+				}
+			};
+			passes.push_back(grassDraws);
+			passNodes.push_back(shellNode);
 		}
 
-		for (size_t i = 0; i < commandBuffers.size(); i++) { //iterates through command buffers
-			VkCommandBufferBeginInfo beginInfo = {}; //struct for command buffer beginning information
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-
-			if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-				throw std::runtime_error("failed to begin recording command buffer!"); //throws runtime error
+		//OIT resolve subpass, ImGui draws on top in the same secondary
+		recorder::pass resolveDraws = graphDraws(resolveNode, nullptr); //the ImGui draw data changes every frame
+		ImDrawData uiDrawData = packet.uiDrawData; //the packet's copy, the main thread is already building the next UI
+		resolveDraws.record = [this, frameSet, frameOffsets, uiDrawData](VkCommandBuffer commandBuffer) mutable {
+			beginSecondary(commandBuffer, frameSet, frameOffsets);
+			if (bindPipeline(commandBuffer, oitResolvePipeline)) {
+				vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 			}
 
-			//SHADOW PASS
-
-			VkRenderPassBeginInfo renderPassInfo = {}; //struct for render pass information
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = shadowPass.renderPass;
-			renderPassInfo.framebuffer = shadowPass.frameBuffer;
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = swapChainExtent;
-
-			std::array<VkClearValue, 1> shadowClearValues = {};
-			shadowClearValues[0].depthStencil = { 1.0f, 0 };
-
-			renderPassInfo.clearValueCount = static_cast<uint32_t>(shadowClearValues.size());
-			renderPassInfo.pClearValues = shadowClearValues.data();
-
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			VkBuffer vertexBuff[] = { vertexBuffers[i] };
-			VkDeviceSize offsets[] = { 0 };
-
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline);
-
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuff, offsets);
-
-			vkCmdBindIndexBuffer(commandBuffers[i], indexBuffers[i], 0, VK_INDEX_TYPE_UINT32);
-
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
-
-			vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-
-			vkCmdEndRenderPass(commandBuffers[i]);
-
-			//MAIN PASS
-
-			renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			renderPassInfo.renderPass = renderPass;
-			renderPassInfo.framebuffer = swapChainFramebuffers[i];
-			renderPassInfo.renderArea.offset = { 0, 0 };
-			renderPassInfo.renderArea.extent = swapChainExtent;
-
-			std::array<VkClearValue, 2> clearValues = {};
-			clearValues[0].color = { 0.16f, 0.56f, 0.81f, 1.0f };
-			clearValues[1].depthStencil = { 1.0f, 0 };
-
-			renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-			renderPassInfo.pClearValues = clearValues.data();
-
-			vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-			//Base subpass
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, basePipeline);
-
-			VkBuffer quadVertexBuff[] = { quadVertexBuffers[i] };
-
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuff, offsets);
-
-			vkCmdBindIndexBuffer(commandBuffers[i], indexBuffers[i], 0, VK_INDEX_TYPE_UINT32);
-
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
-
-			vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-
 			// Record Imgui Draw Data and draw funcs into command buffer
-			ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffers[i]);
-
-			vkCmdNextSubpass(commandBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
-
-			//Fin subpass
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, finPipeline);
-
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, quadVertexBuff, offsets);
-
-			vkCmdBindIndexBuffer(commandBuffers[i], quadIndexBuffers[i], 0, VK_INDEX_TYPE_UINT32);
-
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
-
-			//vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(quadIndices.size()), 1, 0, 0, 0);
-
-			vkCmdNextSubpass(commandBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
-			
-			//Shell subpass
-			vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, shellPipeline);
-
-			vkCmdBindVertexBuffers(commandBuffers[i], 0, 1, vertexBuff, offsets);
-
-			vkCmdBindIndexBuffer(commandBuffers[i], indexBuffers[i], 0, VK_INDEX_TYPE_UINT32);
+			ImGui_ImplVulkan_RenderDrawData(&uiDrawData, commandBuffer);
+		};
+		passes.push_back(resolveDraws);
+		passNodes.push_back(resolveNode);
 
-			vkCmdBindDescriptorSets(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+		recorder::record(commandRecorder, passes);
 
-			float currentLayer = 0.0f;
-			float maxLayer = 1.0f;
-			float noOfLayers = 40.0f;
+		VkCommandBuffer commandBuffer = commandBuffers[currentFrame];
 
-			vkCmdPushConstants(commandBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(currentLayer), &currentLayer);
+		VkCommandBufferBeginInfo beginInfo = {}; //struct for command buffer beginning information
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-			while (currentLayer <= maxLayer)
-			{
-				//vkCmdDrawIndexed(commandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-				currentLayer += (maxLayer / noOfLayers);
-				vkCmdPushConstants(commandBuffers[i], pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(currentLayer), &currentLayer);
+		if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+			throw std::runtime_error("failed to begin recording command buffer!"); //throws runtime error
+		}
+
+		//FUR DYNAMICS
+		//previous frame's shell draws must finish reading the hair state before it is overwritten
+		VkBufferMemoryBarrier furBarrier = {};
+		furBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		furBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		furBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		furBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		furBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		furBarrier.buffer = furStateBuffer;
+		furBarrier.offset = 0;
+		furBarrier.size = VK_WHOLE_SIZE;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &furBarrier, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, furDynamicsPipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, furDynamicsPipelineLayout, 0, 1, &furDynamicsDescriptorSet, 1, &uniformOffset);
+		vkCmdDispatch(commandBuffer, (static_cast<uint32_t>(vertices.size()) + 63) / 64, 1, 1);
+
+		furBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		furBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 1, &furBarrier, 0, nullptr);
+
+		//GRASS CULLING
+		if (packet.renderGrass) {
+			//the previous frame's indirect draw must be done with the command and the visible list before they are rebuilt
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+			VkDrawIndexedIndirectCommand grassDraw = {};
+			grassDraw.indexCount = grassPatchMesh.indexCount;
+			grassDraw.instanceCount = 0; //one instance per visible patch layer, counted up by grasscull.comp
+			grassDraw.firstIndex = grassPatchMesh.firstIndex;
+			grassDraw.vertexOffset = grassPatchMesh.vertexOffset;
+			vkCmdUpdateBuffer(commandBuffer, grassDrawBuffer, 0, sizeof(grassDraw), &grassDraw);
+
+			VkBufferMemoryBarrier grassBarriers[2] = {};
+			grassBarriers[0].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			grassBarriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			grassBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			grassBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			grassBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			grassBarriers[0].buffer = grassDrawBuffer;
+			grassBarriers[0].offset = 0;
+			grassBarriers[0].size = VK_WHOLE_SIZE;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, grassBarriers, 0, nullptr);
+
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, grassCullPipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, grassCullPipelineLayout, 0, 1, &grassCullDescriptorSet, 1, &uniformOffset);
+			vkCmdDispatch(commandBuffer, (GRASS_PATCH_COUNT + 63) / 64, 1, 1);
+
+			grassBarriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			grassBarriers[0].dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+			grassBarriers[1] = grassBarriers[0];
+			grassBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			grassBarriers[1].buffer = grassShellBuffer;
+
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 0, nullptr, 2, grassBarriers, 0, nullptr);
+		}
+
+		//RENDER PASSES
+		//the frame graph begins its render passes and subpasses, each subpass executes the secondaries recorded for it
+		rendergraph::record(frameGraph, commandBuffer, imageIndex, [&passes, &passNodes, commandBuffer](uint32_t node) {
+			for (size_t p = 0; p < passes.size(); p++) {
+				if (passNodes[p] == node) {
+					vkCmdExecuteCommands(commandBuffer, 1, &passes[p].commandBuffer);
+				}
 			}
-			
-			vkCmdEndRenderPass(commandBuffers[i]);
+		});
 
-			if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-				throw std::runtime_error("failed to record command buffer!");
-			}
+		vtex::recordFeedbackBarrier(commandBuffer);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to record command buffer!");
 		}
 	}
 
+	//the acquire semaphores and the frame pacing belong to the timeline, only presenting needs a semaphore per image:
+	//an image is only acquired again once its present has waited, so its semaphore is free by then
 	void createSyncObjects() {
-		imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-		inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-		imagesInFlight.resize(swapChainImages.size(), VK_NULL_HANDLE);
+		presentSemaphores.resize(swapChainImages.size());
+		imageValues.resize(swapChainImages.size(), 0); //a kept feedback buffer still waits for the old image's last frame
 
 		VkSemaphoreCreateInfo semaphoreInfo = {}; //struct for semaphore information
 		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-		VkFenceCreateInfo fenceInfo = {}; //struct for fence information
-		fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphores[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-				vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) != VK_SUCCESS) {
+		for (size_t i = 0; i < presentSemaphores.size(); i++) {
+			if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &presentSemaphores[i]) != VK_SUCCESS) {
 				throw std::runtime_error("failed to create synchronization objects for a frame!"); //throws runtime error
 			}
 		}
 	}
 
-	void updateUniformBuffer(uint32_t currentImage) {
-		static auto startTime = std::chrono::high_resolution_clock::now();
+	//the simulation step of a frame: transforms, light and UI, copied into the packet the render thread will draw
+	void buildFramePacket(FramePacket& packet, int width, int height) {
+		freeFramePacket(packet);
+
+		ImDrawData* drawData = ImGui::GetDrawData();
+		for (int i = 0; i < drawData->CmdListsCount; i++) {
+			packet.uiDrawLists.push_back(drawData->CmdLists[i]->CloneOutput());
+		}
+		packet.uiDrawData = *drawData;
+		packet.uiDrawData.CmdLists = packet.uiDrawLists.data();
+
+		packet.renderTexture = renderTexture;
+		packet.renderLighting = renderLighting;
+		packet.renderShadowMap = renderShadowMap;
+		packet.renderGrass = renderGrass;
+		packet.framebufferExtent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+		packet.framebufferResized = windowResized;
+		windowResized = false;
 
 		auto currentTime = std::chrono::high_resolution_clock::now();
-		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+		float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - simulationStart).count();
+
+		glm::vec3 eyePosition = glm::vec3(0.0f, 40.0f, 70.0f);
+		glm::vec3 lightPosition = glm::vec3(20.0f, 80.0f, 40.0f);
 
 		UniformBufferObject ubo = {};
 		ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		ubo.view = glm::lookAt(glm::vec3(0.0f, 40.0f, 70.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		ubo.proj = glm::perspective(glm::radians(70.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 250.0f);
+		ubo.view = glm::lookAt(eyePosition, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		ubo.proj = glm::perspective(glm::radians(70.0f), width / (float)height, 0.1f, 250.0f);
 		ubo.proj[1][1] *= -1;
-		ubo.renderTex = 1.0f;
-		if (!renderTexture) {
-			ubo.renderTex = 0.0f;
-		}
 		ubo.mvp = ubo.proj * ubo.view * ubo.model;
+		ubo.normalMatrix = glm::transpose(glm::inverse(ubo.model));
+		ubo.eyePosition = eyePosition;
+		ubo.lightVector = glm::vec3(ubo.view * glm::vec4(lightPosition, 1.0f));
 
-		void* data;
-		vkMapMemory(device, uniformBuffersMemory[currentImage], 0, sizeof(ubo), 0, &data);
-		memcpy(data, &ubo, sizeof(ubo));
-		vkUnmapMemory(device, uniformBuffersMemory[currentImage]);
+		packet.ubo = ubo;
 
 		ShadowBufferObject shadow = {};
 		shadow.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(10.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		shadow.view = glm::lookAt(glm::vec3(20.0f, 80.0f, 40.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-		shadow.proj = glm::perspective(glm::radians(70.0f), swapChainExtent.width / (float)swapChainExtent.height, 0.1f, 250.0f);
+		shadow.view = glm::lookAt(lightPosition, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		shadow.proj = glm::perspective(glm::radians(70.0f), width / (float)height, 0.1f, 250.0f);
 		shadow.mvp = shadow.proj * shadow.view * shadow.model;
 		shadow.biasmvp = biasMatrix * shadow.mvp;
-		shadow.renderMap = 0.0f;
-		if (!renderShadowMap) {
-			shadow.renderMap = 1.0f;
-		}
-
-		vkMapMemory(device, shadowUniformBuffersMemory[currentImage], 0, sizeof(shadow), 0, &data);
-		memcpy(data, &shadow, sizeof(shadow));
-		vkUnmapMemory(device, shadowUniformBuffersMemory[currentImage]);
-
-		LightingConstants lighting = {};
-		if (renderLighting) {
-			lighting.lightPosition = glm::vec3(20.0f, 80.0f, 40.0f);
-			lighting.lightAmbient = glm::vec3(0.8f, 0.8f, 0.8f);
-			lighting.lightDiffuse = glm::vec3(1.0f, 1.0f, 1.0f);
-			lighting.lightSpecular = glm::vec3(0.288f, 0.288f, 0.288f);
-			lighting.lightSpecularExponent = 28.0f;
-		}
-		else {
-			lighting.lightPosition = glm::vec3(20.0f, 40.0f, 40.0f);
-			lighting.lightAmbient = glm::vec3(0.0f, 0.0f, 0.0f);
-			lighting.lightDiffuse = glm::vec3(0.0f, 0.0f, 0.0f);
-			lighting.lightSpecular = glm::vec3(0.0f, 0.0f, 0.0f);
-			lighting.lightSpecularExponent = 0.0f;
-		}
-		
-		vkMapMemory(device, lightingBuffersMemory[currentImage], 0, sizeof(lighting), 0, &data);
-		memcpy(data, &lighting, sizeof(lighting));
-		vkUnmapMemory(device, lightingBuffersMemory[currentImage]);
-	}
 
-	void drawFrame() {
-		vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+		packet.shadow = shadow;
+
+		LightingConstants lighting = {}; //unlit variants skip the lighting, so the constants stay the same
+		lighting.lightPosition = lightPosition;
+		lighting.lightAmbient = glm::vec3(0.8f, 0.8f, 0.8f);
+		lighting.lightDiffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+		lighting.lightSpecular = glm::vec3(0.288f, 0.288f, 0.288f);
+		lighting.lightSpecularExponent = 28.0f;
+
+		packet.lighting = lighting;
+
+		FurDynamicsObject furDynamics = {};
+		furDynamics.model = ubo.model;
+		furDynamics.prevModel = previousModel;
+		furDynamics.olderModel = olderModel;
+		furDynamics.gravity = glm::vec4(0.0f, -9.8f, 0.0f, 0.0f);
+		furDynamics.wind = glm::vec4(glm::normalize(glm::vec3(1.0f, 0.0f, 0.3f)) * windStrength * (0.6f + 0.4f * sin(time * 1.3f)), 0.0f);
+		furDynamics.deltaTime = glm::clamp(time - previousTime, 1.0f / 240.0f, 1.0f / 30.0f); //keeps the integration stable through hitches
+		furDynamics.prevDeltaTime = previousDeltaTime;
+		furDynamics.stiffness = 9.8f; //rests at the old fixed gravity offset
+		furDynamics.damping = 2.0f;
+		furDynamics.inertia = 1.0f; //the full pseudo force of the accelerating root
+		furDynamics.maxOffset = 1.5f;
+		furDynamics.vertexCount = static_cast<uint32_t>(vertices.size());
+
+		olderModel = previousModel;
+		previousModel = ubo.model;
+		previousTime = time;
+		previousDeltaTime = furDynamics.deltaTime;
+
+		packet.furDynamics = furDynamics;
+
+		//frustum planes pointing inwards, extracted from the rows of the view projection (Gribb & Hartmann)
+		glm::mat4 viewProj = ubo.proj * ubo.view;
+		glm::vec4 rows[4];
+		for (int row = 0; row < 4; row++) {
+			rows[row] = glm::vec4(viewProj[0][row], viewProj[1][row], viewProj[2][row], viewProj[3][row]);
+		}
+
+		GrassCullObject grassCull = {};
+		grassCull.frustumPlanes[0] = rows[3] + rows[0]; //left
+		grassCull.frustumPlanes[1] = rows[3] - rows[0]; //right
+		grassCull.frustumPlanes[2] = rows[3] + rows[1]; //bottom
+		grassCull.frustumPlanes[3] = rows[3] - rows[1]; //top
+		grassCull.frustumPlanes[4] = rows[2]; //near, depth range is zero to one
+		grassCull.frustumPlanes[5] = rows[3] - rows[2]; //far
+		for (auto& plane : grassCull.frustumPlanes) {
+			plane /= glm::length(glm::vec3(plane));
+		}
+		grassCull.cameraPosition = glm::inverse(ubo.view)[3];
+		grassCull.patchRadius = grassPatchRadius;
+		grassCull.lodNear = GRASS_LOD_NEAR;
+		grassCull.lodFar = GRASS_LOD_FAR;
+		grassCull.maxShells = GRASS_MAX_SHELLS;
+		grassCull.minShells = GRASS_MIN_SHELLS;
+		grassCull.patchCount = GRASS_PATCH_COUNT;
+		grassCull.capacity = GRASS_SHELL_CAPACITY;
+
+		packet.grassCull = grassCull;
+	}
+
+	void updateUniformBuffer(const FramePacket& packet) {
+		uniforms::write(uniformRing, uboBlock, &packet.ubo);
+		uniforms::write(uniformRing, shadowBlock, &packet.shadow);
+		uniforms::write(uniformRing, lightingBlock, &packet.lighting); //the ring skips it once every slice holds these contents
+		uniforms::write(uniformRing, furDynamicsBlock, &packet.furDynamics);
+		uniforms::write(uniformRing, grassCullBlock, &packet.grassCull);
+	}
+
+	void drawFrame(const FramePacket& packet) {
+		framebufferExtent = packet.framebufferExtent;
+		framebufferResized = framebufferResized || packet.framebufferResized;
+
+		deletion::collect(deletionQueue); //objects whose last use the GPU has passed are free now, nothing waits here
 
 		uint32_t imageIndex;
-		VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+		VkSemaphore imageAvailable = timeline::acquireSemaphore(frameTimeline);
+		VkResult result = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailable, VK_NULL_HANDLE, &imageIndex);
 
 		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			timeline::releaseSemaphore(frameTimeline, imageAvailable, 0); //left unsignalled
 			recreateSwapChain();
 			return;
 		}
@@ -2669,38 +2570,59 @@ private:
 			throw std::runtime_error("failed to acquire swap chain image!");
 		}
 
-		updateUniformBuffer(imageIndex);
-		//createSilhouetteVertices();
-		//updateSilhouetteVertexBuffers(imageIndex);
-		//updateSilhouetteIndexBuffers(imageIndex);
-		createCommandBuffers();
+		//the feedback buffer of this image is read back, the last frame rendered to it must be done
+		timeline::wait(frameTimeline, imageValues[imageIndex]);
+
+		vtex::readFeedback(virtualTextures, imageIndex); //pages that image's last frame asked for
+		vtex::update(virtualTextures);
+
+		if (!VIRTUAL_TEXTURING) {
+			texstream::touch(textureStreamer, furTexture); //sampled by the base and shell passes, the fin pass is disabled
+		}
+		texstream::update(textureStreamer); //submits new levels ahead of this frame on the graphics queue
 
-		if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-			vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+		uint32_t compiledPipelines = pipelineRegistry.compiled;
+		pipelines::collect(pipelineRegistry); //pipelines compiled since the last frame are drawn from this one
+		uint32_t basePermutationIndex = basePermutation(packet.renderTexture, packet.renderLighting, packet.renderShadowMap);
+		if (pipelineRegistry.compiled != compiledPipelines || basePermutationIndex != lastBasePermutation) {
+			invalidateRecordedPasses(); //a draw that was skipped or drew with a fallback or another variant
+			lastBasePermutation = basePermutationIndex;
 		}
-		imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+
+		//everything above overlaps the GPU's work on this slot's last frame, its resources are reused from here on
+		currentFrame = timeline::beginFrame(frameTimeline);
+		if (texstream::updateDescriptors(textureStreamer, currentFrame, staticSets[currentFrame])) {
+			passVersions[currentFrame]++; //the cached passes of this frame in flight bound the set before it was written
+		}
+
+		uniforms::beginFrame(uniformRing, currentFrame); //checks the slice's own tag, the slot's wait above already covers it
+		updateUniformBuffer(packet);
+
+		vkResetCommandPool(device, commandPools[currentFrame], 0); //this slot's primary has completed
+		recorder::beginFrame(commandRecorder, currentFrame); //and so have its secondaries
+		createCommandBuffers(imageIndex, packet);
 
 		VkSubmitInfo submitInfo = {};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore waitSemaphores[] = { imageAvailableSemaphores[currentFrame] };
+		VkSemaphore waitSemaphores[] = { imageAvailable };
 		VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 		submitInfo.waitSemaphoreCount = 1;
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = waitStages;
 
 		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
+		submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
 
-		VkSemaphore signalSemaphores[] = { renderFinishedSemaphores[currentFrame] };
+		VkSemaphore signalSemaphores[] = { presentSemaphores[imageIndex] };
 		submitInfo.signalSemaphoreCount = 1;
 		submitInfo.pSignalSemaphores = signalSemaphores;
 
-		vkResetFences(device, 1, &inFlightFences[currentFrame]);
-
-		if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFences[currentFrame]) != VK_SUCCESS) {
-			throw std::runtime_error("failed to submit draw command buffer!");
-		}
+		//signals the frame's timeline value too, which tags everything it read
+		timeline::value frameValue = timeline::submitFrame(frameTimeline, graphicsQueue, submitInfo);
+		timeline::releaseSemaphore(frameTimeline, imageAvailable, frameValue);
+		uniforms::endFrame(uniformRing, frameValue);
+		imageValues[imageIndex] = frameValue;
 
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -2723,8 +2645,6 @@ private:
 		else if (result != VK_SUCCESS) {
 			throw std::runtime_error("failed to present swap chain image!");
 		}
-
-		currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
 
 	VkShaderModule createShaderModule(const std::vector<char>& code) {
@@ -2766,13 +2686,7 @@ private:
 			return capabilities.currentExtent;
 		}
 		else {
-			int width, height;
-			glfwGetFramebufferSize(window, &width, &height);
-
-			VkExtent2D actualExtent = {
-				static_cast<uint32_t>(width),
-				static_cast<uint32_t>(height)
-			};
+			VkExtent2D actualExtent = framebufferExtent; //GLFW is only asked on the main thread, the packets carry its answer
 
 			actualExtent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actualExtent.width));
 			actualExtent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actualExtent.height));
@@ -2819,7 +2733,8 @@ private:
 		VkPhysicalDeviceFeatures supportedFeatures;
 		vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-		return indices.isComplete() && extensionsSupported && swapChainAdequate; //returns whether the device is suitable or not
+		return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.shaderSampledImageArrayDynamicIndexing
+			&& (!VIRTUAL_TEXTURING || supportedFeatures.fragmentStoresAndAtomics); //returns whether the device is suitable or not
 	}
 
 	bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -2849,19 +2764,22 @@ private:
 
 		int i = 0; //sets i to 0
 		for (const auto& queueFamily : queueFamilies) { //iterates through the queue families
-			if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) { //if the queues in the family support graphics operations
-				indices.graphicsFamily = i; //sets the graphics family of the indices to i
-			}
+			if (!indices.isComplete()) { //keeps the first family that completes the indices
+				if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT)) { //if the queues in the family support graphics and compute operations
+					indices.graphicsFamily = i; //sets the graphics family of the indices to i
+				}
 
-			VkBool32 presentSupport = false; //sets presentation support to false
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport); //checks if there is presentation support for the device
+				VkBool32 presentSupport = false; //sets presentation support to false
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport); //checks if there is presentation support for the device
 
-			if (presentSupport) { //if there is presentation support
-				indices.presentFamily = i; //sets the presentation family of the indices to i
+				if (presentSupport) { //if there is presentation support
+					indices.presentFamily = i; //sets the presentation family of the indices to i
+				}
 			}
 
-			if (indices.isComplete()) { //if the indices is complete
-				break; //ends the current loop
+			//a family with transfer but neither graphics nor compute is usually a DMA engine that runs beside rendering
+			if (!indices.transferFamily.has_value() && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+				indices.transferFamily = i;
 			}
 
 			i++; //updates i value
@@ -2876,6 +2794,7 @@ private:
 		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount); //returns extensions needed to interface with the window system and updates number of extensions
 
 		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount); //declares a list for storing the extensions
+		extensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME); //required by the timeline semaphore device extension on Vulkan 1.0
 
 		if (enableValidationLayers) { //if validation layers enabled
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME); //adds the extension to the list
@@ -0,0 +1,341 @@
+#include <stdexcept>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+
+#include <stb_image.h>
+
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imgui/imstb_rectpack.h"
+
+#include "materials.h"
+#include "texcompress.h"
+
+using namespace materials;
+
+namespace
+{
+    uint32_t takeSlot(library& materialLibrary)
+    {
+        if (materialLibrary.slotTextures.size() >= MAX_TEXTURES) {
+            throw std::runtime_error("material texture table is full!");
+        }
+        return static_cast<uint32_t>(materialLibrary.slotTextures.size());
+    }
+
+    bool isCompressed(VkFormat format)
+    {
+        return format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB;
+    }
+
+    // Copies an RGBA8 image into the page at x, y and repeats its edge texels across the padding around it
+    void blitEntry(texstream::mipLevel& page, const texstream::mipLevel& entry, uint32_t x, uint32_t y)
+    {
+        for (uint32_t row = 0; row < entry.height + 2 * ATLAS_PADDING; row++) {
+            uint32_t sourceY = static_cast<uint32_t>(std::min(std::max(static_cast<int32_t>(row) - static_cast<int32_t>(ATLAS_PADDING), 0), static_cast<int32_t>(entry.height) - 1));
+            uint8_t* destination = &page.texels[(static_cast<size_t>(y - ATLAS_PADDING + row) * page.width + (x - ATLAS_PADDING)) * 4];
+
+            for (uint32_t column = 0; column < entry.width + 2 * ATLAS_PADDING; column++) {
+                uint32_t sourceX = static_cast<uint32_t>(std::min(std::max(static_cast<int32_t>(column) - static_cast<int32_t>(ATLAS_PADDING), 0), static_cast<int32_t>(entry.width) - 1));
+                memcpy(destination + column * 4, &entry.texels[(static_cast<size_t>(sourceY) * entry.width + sourceX) * 4], 4);
+            }
+        }
+    }
+
+    // Streams one atlas page, its loader decodes and places every entry on the worker thread
+    void addPage(library& materialLibrary, uint32_t page)
+    {
+        std::vector<image> entries;
+        for (const auto& candidate : materialLibrary.images) {
+            if (candidate.atlased && candidate.page == page) {
+                entries.push_back(candidate);
+            }
+        }
+
+        VkFormat format = materialLibrary.colorFormat;
+        texstream::loader load = [entries, format]() {
+            std::vector<texstream::mipLevel> mips(1);
+            mips[0].width = ATLAS_SIZE;
+            mips[0].height = ATLAS_SIZE;
+            mips[0].texels.assign(static_cast<size_t>(ATLAS_SIZE) * ATLAS_SIZE * 4, 0);
+
+            for (const auto& entry : entries) {
+                std::vector<texstream::mipLevel> decoded = texcompress::decodeImage(entry.path);
+                if (decoded[0].width != entry.width || decoded[0].height != entry.height) {
+                    throw std::runtime_error("atlas image " + entry.path + " changed size!");
+                }
+                blitEntry(mips[0], decoded[0], entry.x, entry.y);
+            }
+
+            //the streamer completes RGBA8 chains itself, block compressed pages need theirs before encoding
+            if (isCompressed(format)) {
+                texstream::completeChain(mips, format == VK_FORMAT_BC7_SRGB_BLOCK);
+                mips = texcompress::encode(mips, format);
+            }
+            return mips;
+        };
+
+        uint32_t slot = takeSlot(materialLibrary);
+        uint32_t texture = texstream::add(*materialLibrary.textureStreamer, "atlas " + std::to_string(page), format, { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY },
+            0xFF808080, materialLibrary.sampler, materialLibrary.binding, slot, load);
+        materialLibrary.slotTextures.push_back(texture);
+
+        for (auto& entry : materialLibrary.images) {
+            if (entry.atlased && entry.page == page) {
+                entry.slot = slot;
+                entry.texture = texture;
+            }
+        }
+    }
+
+    // Packs every atlased image, filling one page after another
+    void packAtlases(library& materialLibrary)
+    {
+        std::vector<uint32_t> pending;
+        for (uint32_t i = 0; i < materialLibrary.images.size(); i++) {
+            if (materialLibrary.images[i].atlased) {
+                pending.push_back(i);
+            }
+        }
+
+        uint32_t page = 0;
+        while (!pending.empty()) {
+            stbrp_context context;
+            std::vector<stbrp_node> nodes(ATLAS_SIZE);
+            stbrp_init_target(&context, ATLAS_SIZE, ATLAS_SIZE, nodes.data(), static_cast<int>(nodes.size()));
+
+            std::vector<stbrp_rect> rects(pending.size());
+            for (size_t i = 0; i < pending.size(); i++) {
+                rects[i] = {};
+                rects[i].id = static_cast<int>(pending[i]);
+                rects[i].w = static_cast<stbrp_coord>(materialLibrary.images[pending[i]].width + 2 * ATLAS_PADDING);
+                rects[i].h = static_cast<stbrp_coord>(materialLibrary.images[pending[i]].height + 2 * ATLAS_PADDING);
+            }
+            stbrp_pack_rects(&context, rects.data(), static_cast<int>(rects.size()));
+
+            std::vector<uint32_t> leftover;
+            for (const auto& rect : rects) {
+                image& entry = materialLibrary.images[rect.id];
+                if (!rect.was_packed) {
+                    leftover.push_back(static_cast<uint32_t>(rect.id)); //keeps NO_PAGE, so this page's loader leaves it out
+                    continue;
+                }
+                entry.page = page;
+                entry.x = rect.x + ATLAS_PADDING;
+                entry.y = rect.y + ATLAS_PADDING;
+            }
+
+            addPage(materialLibrary, page);
+
+            pending.swap(leftover);
+            page++;
+        }
+    }
+
+    void createDefaultImage(library& materialLibrary, VkDevice device, memalloc::allocator& memoryAllocator, upload::context& uploadContext)
+    {
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { 1, 1, 1 };
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(device, &imageInfo, nullptr, &materialLibrary.defaultImage) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create default material image!");
+        }
+
+        materialLibrary.defaultMemory = memalloc::allocateForImage(memoryAllocator, materialLibrary.defaultImage, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = materialLibrary.defaultImage;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(device, &viewInfo, nullptr, &materialLibrary.defaultView) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create default material image view!");
+        }
+
+        VkBuffer stagingBuffer;
+        VkDeviceSize stagingOffset;
+        uint32_t white = 0xFFFFFFFF;
+        memcpy(upload::stage(uploadContext, sizeof(white), stagingBuffer, stagingOffset), &white, sizeof(white));
+
+        VkBufferImageCopy region = {};
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = { 1, 1, 1 };
+
+        upload::transitionImage(uploadContext, materialLibrary.defaultImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+        upload::copyToImage(uploadContext, stagingBuffer, stagingOffset, materialLibrary.defaultImage, { region });
+        upload::transitionImage(uploadContext, materialLibrary.defaultImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1);
+    }
+}
+
+void materials::init(library& materialLibrary, texstream::streamer& textureStreamer, VkSampler sampler, uint32_t binding, VkFormat colorFormat, const std::string& cacheDirectory)
+{
+    materialLibrary = library();
+    materialLibrary.textureStreamer = &textureStreamer;
+    materialLibrary.sampler = sampler;
+    materialLibrary.binding = binding;
+    materialLibrary.colorFormat = colorFormat;
+    materialLibrary.cacheDirectory = cacheDirectory;
+}
+
+void materials::destroy(library& materialLibrary, VkDevice device, memalloc::allocator& memoryAllocator)
+{
+    vkDestroyBuffer(device, materialLibrary.materialBuffer, nullptr);
+    memalloc::free(memoryAllocator, materialLibrary.materialMemory);
+
+    vkDestroyImageView(device, materialLibrary.defaultView, nullptr);
+    vkDestroyImage(device, materialLibrary.defaultImage, nullptr);
+    memalloc::free(memoryAllocator, materialLibrary.defaultMemory);
+
+    materialLibrary.materialBuffer = VK_NULL_HANDLE;
+    materialLibrary.defaultImage = VK_NULL_HANDLE;
+    materialLibrary.defaultView = VK_NULL_HANDLE;
+}
+
+uint32_t materials::addStreamed(library& materialLibrary, const std::string& name, VkFormat format, VkComponentMapping swizzle, uint32_t placeholder, texstream::loader load)
+{
+    image added;
+    added.path = name;
+    added.slot = takeSlot(materialLibrary);
+    added.texture = texstream::add(*materialLibrary.textureStreamer, name, format, swizzle, placeholder, materialLibrary.sampler, materialLibrary.binding, added.slot, load);
+    materialLibrary.slotTextures.push_back(added.texture);
+
+    materialLibrary.images.push_back(added);
+    return static_cast<uint32_t>(materialLibrary.images.size()) - 1;
+}
+
+uint32_t materials::addVirtual(library& materialLibrary, uint32_t layer, uint32_t width, uint32_t height, uint32_t levels, bool srgb)
+{
+    image added;
+    added.width = width;
+    added.height = height;
+    added.virtualTexture = layer + 1;
+    added.levels = levels;
+    added.srgb = srgb;
+
+    materialLibrary.images.push_back(added);
+    return static_cast<uint32_t>(materialLibrary.images.size()) - 1;
+}
+
+uint32_t materials::addImage(library& materialLibrary, const std::string& path)
+{
+    if (materialLibrary.built) {
+        throw std::runtime_error("cannot add atlas images to a built material library!");
+    }
+
+    //only the header is read here, the pixels are decoded by the streaming worker
+    int width, height, channels;
+    if (!stbi_info(path.c_str(), &width, &height, &channels)) {
+        throw std::runtime_error("failed to load texture image!");
+    }
+
+    if (static_cast<uint32_t>(std::max(width, height)) > ATLAS_MAX_ENTRY) {
+        VkFormat format = materialLibrary.colorFormat;
+        std::string cachePath = texcompress::cachePath(materialLibrary.cacheDirectory, std::filesystem::path(path).stem().string(), format);
+        return addStreamed(materialLibrary, path, format, { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY },
+            0xFF808080, [cachePath, path, format]() {
+                return texcompress::loadOrTranscode(cachePath, path, format, [&path]() {
+                    return texcompress::decodeImage(path);
+                });
+            });
+    }
+
+    image added;
+    added.path = path;
+    added.width = static_cast<uint32_t>(width);
+    added.height = static_cast<uint32_t>(height);
+    added.atlased = true;
+
+    materialLibrary.images.push_back(added);
+    return static_cast<uint32_t>(materialLibrary.images.size()) - 1;
+}
+
+uint32_t materials::addMaterial(library& materialLibrary, uint32_t imageIndex)
+{
+    materialLibrary.materialImages.push_back(imageIndex);
+    return static_cast<uint32_t>(materialLibrary.materialImages.size()) - 1;
+}
+
+void materials::build(library& materialLibrary, VkDevice device, memalloc::allocator& memoryAllocator, upload::context& uploadContext)
+{
+    if (materialLibrary.materialImages.empty()) {
+        throw std::runtime_error("material library has no materials!");
+    }
+
+    packAtlases(materialLibrary);
+    materialLibrary.built = true;
+
+    std::vector<materialData> data(materialLibrary.materialImages.size());
+    for (size_t i = 0; i < data.size(); i++) {
+        const image& source = materialLibrary.images[materialLibrary.materialImages[i]];
+
+        data[i] = {};
+        if (source.virtualTexture != 0) {
+            data[i].virtualTexture = source.virtualTexture;
+            data[i].uvTransform[0] = static_cast<float>(source.width);
+            data[i].uvTransform[1] = static_cast<float>(source.height);
+            data[i].uvTransform[2] = static_cast<float>(source.levels);
+            data[i].uvTransform[3] = source.srgb ? 1.0f : 0.0f;
+            continue;
+        }
+
+        data[i].texture = source.slot;
+        data[i].atlased = source.atlased ? 1 : 0;
+        data[i].uvTransform[0] = source.atlased ? static_cast<float>(source.width) / ATLAS_SIZE : 1.0f;
+        data[i].uvTransform[1] = source.atlased ? static_cast<float>(source.height) / ATLAS_SIZE : 1.0f;
+        data[i].uvTransform[2] = source.atlased ? static_cast<float>(source.x) / ATLAS_SIZE : 0.0f;
+        data[i].uvTransform[3] = source.atlased ? static_cast<float>(source.y) / ATLAS_SIZE : 0.0f;
+    }
+
+    VkDeviceSize size = sizeof(materialData) * data.size();
+
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &materialLibrary.materialBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create material buffer!");
+    }
+
+    materialLibrary.materialMemory = memalloc::allocateForBuffer(memoryAllocator, materialLibrary.materialBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    upload::copyToBuffer(uploadContext, data.data(), size, materialLibrary.materialBuffer, 0);
+
+    createDefaultImage(materialLibrary, device, memoryAllocator, uploadContext);
+}
+
+uint32_t materials::streamedTexture(const library& materialLibrary, uint32_t imageIndex)
+{
+    return materialLibrary.images[imageIndex].texture;
+}
+
+void materials::textureTable(const library& materialLibrary, VkDescriptorImageInfo* imageInfos)
+{
+    for (uint32_t slot = 0; slot < MAX_TEXTURES; slot++) {
+        imageInfos[slot].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfos[slot].sampler = materialLibrary.sampler;
+        imageInfos[slot].imageView = slot < materialLibrary.slotTextures.size()
+            ? texstream::currentView(*materialLibrary.textureStreamer, materialLibrary.slotTextures[slot])
+            : materialLibrary.defaultView;
+    }
+}
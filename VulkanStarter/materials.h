@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "memalloc.h"
+#include "upload.h"
+#include "texstream.h"
+
+// Material texture table. Every texture a material can use sits in one sampler array binding of MAX_TEXTURES slots,
+// and draws pick their material with a push constant index into a storage buffer of materialData, so switching
+// material never touches a descriptor set. Images no larger than ATLAS_MAX_ENTRY are packed into shared atlas pages
+// with stb_rect_pack, larger or repeating ones get a slot of their own. Slots and atlas pages are streamed textures.
+// Materials can also sample a virtual texture (vtex), which takes no slot.
+namespace materials
+{
+    const uint32_t MAX_TEXTURES = 16;       // slots in the texture table, the shaders declare the same count
+    const uint32_t ATLAS_SIZE = 1024;       // width and height of an atlas page
+    const uint32_t ATLAS_MAX_ENTRY = 256;   // larger images get their own slot
+    const uint32_t ATLAS_PADDING = 4;       // texels of clamped border around each entry, keeps the first mips from bleeding
+    const uint32_t NO_PAGE = UINT32_MAX;    // page of an atlased image not placed yet
+
+    // Mirrors MaterialData in the shaders, std430
+    struct materialData
+    {
+        float uvTransform[4];               // xy scale, zw offset into the atlas page. Virtual textures: xy size, z levels, w sRGB
+        uint32_t texture;                   // slot in the texture table
+        uint32_t atlased;                   // wraps texture coordinates into the entry before transforming them
+        uint32_t virtualTexture;            // page table layer + 1, 0 for table textures
+        uint32_t padding;
+    };
+
+    struct image
+    {
+        std::string path;                   // source of an atlas entry
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool atlased = false;
+        uint32_t page = NO_PAGE;            // atlas page of an atlased image once packed
+        uint32_t x = 0;                     // texel position of the entry in its page, padding excluded
+        uint32_t y = 0;
+        uint32_t slot = 0;                  // table slot, assigned by build() for atlased images
+        uint32_t texture = 0;               // streamed texture holding the image
+        uint32_t virtualTexture = 0;        // page table layer + 1 of a virtual image
+        uint32_t levels = 0;                // of a virtual image
+        bool srgb = false;
+    };
+
+    struct library
+    {
+        texstream::streamer* textureStreamer = nullptr;
+        VkSampler sampler = VK_NULL_HANDLE;
+        uint32_t binding = 0;
+        VkFormat colorFormat = VK_FORMAT_R8G8B8A8_SRGB;     // format of atlas pages and standalone image files
+        std::string cacheDirectory;
+        bool built = false;
+
+        std::vector<image> images;
+        std::vector<uint32_t> slotTextures;                 // streamed texture of each used slot
+        std::vector<uint32_t> materialImages;               // image of each material
+
+        VkBuffer materialBuffer = VK_NULL_HANDLE;
+        memalloc::allocation materialMemory;
+
+        VkImage defaultImage = VK_NULL_HANDLE;              // fills the unused slots, every element of the array must be valid
+        memalloc::allocation defaultMemory;
+        VkImageView defaultView = VK_NULL_HANDLE;
+    };
+
+    // colorFormat is used for atlas pages and for image files too large for the atlas, which are transcoded into cacheDirectory.
+    void init(library&, texstream::streamer&, VkSampler, uint32_t binding, VkFormat colorFormat, const std::string& cacheDirectory);
+
+    // Destroys the material buffer and the default image, the streamed textures belong to the streamer.
+    void destroy(library&, VkDevice, memalloc::allocator&);
+
+    // Streams a texture into its own slot, for large or repeating textures. Returns the image.
+    uint32_t addStreamed(library&, const std::string& name, VkFormat, VkComponentMapping swizzle, uint32_t placeholder, texstream::loader);
+
+    // Adds a virtual texture, width, height and levels as in its tiled file. Returns the image.
+    uint32_t addVirtual(library&, uint32_t layer, uint32_t width, uint32_t height, uint32_t levels, bool srgb);
+
+    // Adds an image file, packed into an atlas page when it is small enough. Texture coordinates of atlased images wrap
+    // inside their entry, but filtering across the wrap sees the padding rather than the opposite edge.
+    uint32_t addImage(library&, const std::string& path);
+
+    // Returns a material sampling the image.
+    uint32_t addMaterial(library&, uint32_t imageIndex);
+
+    // Packs the atlas pages, registers them with the streamer and uploads the material buffer.
+    void build(library&, VkDevice, memalloc::allocator&, upload::context&);
+
+    // Streamed texture backing an image, after build(). Virtual images have none.
+    uint32_t streamedTexture(const library&, uint32_t imageIndex);
+
+    // Fills MAX_TEXTURES image infos for the texture table binding with the current views.
+    void textureTable(const library&, VkDescriptorImageInfo* imageInfos);
+}
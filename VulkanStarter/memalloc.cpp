@@ -0,0 +1,350 @@
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <algorithm>
+
+#include "memalloc.h"
+
+using namespace memalloc;
+
+namespace
+{
+    const VkDeviceSize LARGE_HEAP_BLOCK_SIZE = 64ull * 1024 * 1024;
+    const VkDeviceSize SMALL_HEAP_LIMIT = 1024ull * 1024 * 1024;
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // small heaps (integrated GPUs, the host visible device local window) get an eighth of the heap per block
+    VkDeviceSize preferredBlockSize(const allocator& alloc, uint32_t memoryType)
+    {
+        VkDeviceSize heapSize = alloc.memoryProperties.memoryHeaps[alloc.memoryProperties.memoryTypes[memoryType].heapIndex].size;
+        return (heapSize <= SMALL_HEAP_LIMIT) ? alignUp(heapSize / 8, 4096) : LARGE_HEAP_BLOCK_SIZE;
+    }
+
+    bool isHostVisible(const allocator& alloc, uint32_t memoryType)
+    {
+        return (alloc.memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    }
+
+    // allocates and, for host visible types, maps a whole VkDeviceMemory, returns false if the heap is full
+    bool allocateDeviceMemory(allocator& alloc, uint32_t memoryType, VkDeviceSize size, VkDeviceMemory& memory, void*& mapped)
+    {
+        if (alloc.deviceAllocationCount >= alloc.maxAllocationCount) {
+            throw std::runtime_error("exceeded maxMemoryAllocationCount!");
+        }
+
+        VkMemoryAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocInfo.allocationSize = size;
+        allocInfo.memoryTypeIndex = memoryType;
+
+        VkResult result = vkAllocateMemory(alloc.device, &allocInfo, nullptr, &memory);
+        if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+            return false;
+        }
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate device memory!");
+        }
+
+        mapped = nullptr;
+        if (isHostVisible(alloc, memoryType) && vkMapMemory(alloc.device, memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+            vkFreeMemory(alloc.device, memory, nullptr);
+            throw std::runtime_error("failed to map device memory!");
+        }
+
+        alloc.deviceAllocationCount++;
+        return true;
+    }
+
+    // first fit over the free list, splitting off the alignment padding and the tail
+    bool allocateFromBlock(memoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+    {
+        for (size_t i = 0; i < block.freeList.size(); i++) {
+            freeRange range = block.freeList[i];
+            VkDeviceSize aligned = alignUp(range.offset, alignment);
+            if (aligned + size > range.offset + range.size) {
+                continue;
+            }
+
+            std::vector<freeRange> pieces;
+            if (aligned > range.offset) {
+                pieces.push_back({ range.offset, aligned - range.offset });
+            }
+            if (aligned + size < range.offset + range.size) {
+                pieces.push_back({ aligned + size, range.offset + range.size - (aligned + size) });
+            }
+
+            block.freeList.erase(block.freeList.begin() + i);
+            block.freeList.insert(block.freeList.begin() + i, pieces.begin(), pieces.end());
+
+            block.used += size;
+            block.allocationCount++;
+            offset = aligned;
+            return true;
+        }
+
+        return false;
+    }
+
+    void returnToBlock(memoryBlock& block, VkDeviceSize offset, VkDeviceSize size)
+    {
+        auto next = std::lower_bound(block.freeList.begin(), block.freeList.end(), offset,
+            [](const freeRange& range, VkDeviceSize value) { return range.offset < value; });
+        auto inserted = block.freeList.insert(next, { offset, size });
+
+        // merge with the following range
+        auto after = inserted + 1;
+        if (after != block.freeList.end() && inserted->offset + inserted->size == after->offset) {
+            inserted->size += after->size;
+            block.freeList.erase(after);
+        }
+
+        // merge with the preceding range
+        if (inserted != block.freeList.begin()) {
+            auto before = inserted - 1;
+            if (before->offset + before->size == inserted->offset) {
+                before->size += inserted->size;
+                block.freeList.erase(inserted);
+            }
+        }
+
+        block.used -= size;
+        block.allocationCount--;
+    }
+
+    void releaseBlock(allocator& alloc, memoryBlock& block)
+    {
+        vkFreeMemory(alloc.device, block.memory, nullptr);
+        alloc.deviceAllocationCount--;
+        block = memoryBlock();
+    }
+
+    bool tryAllocate(allocator& alloc, uint32_t memoryType, const VkMemoryRequirements& requirements, bool optimal, allocation& result)
+    {
+        for (uint32_t i = 0; i < alloc.blocks.size(); i++) {
+            memoryBlock& block = alloc.blocks[i];
+            if (block.memory == VK_NULL_HANDLE || block.memoryType != memoryType || block.optimal != optimal) {
+                continue;
+            }
+
+            VkDeviceSize offset;
+            if (allocateFromBlock(block, requirements.size, requirements.alignment, offset)) {
+                result.memory = block.memory;
+                result.offset = offset;
+                result.size = requirements.size;
+                result.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+                result.memoryType = memoryType;
+                result.block = i;
+                return true;
+            }
+        }
+
+        VkDeviceSize blockSize = preferredBlockSize(alloc, memoryType);
+
+        if (requirements.size >= alloc.dedicatedThreshold || requirements.size > blockSize) {
+            void* mapped;
+            if (!allocateDeviceMemory(alloc, memoryType, requirements.size, result.memory, mapped)) {
+                return false;
+            }
+
+            result.offset = 0;
+            result.size = requirements.size;
+            result.mapped = mapped;
+            result.memoryType = memoryType;
+            result.block = DEDICATED_BLOCK;
+
+            heapStats& stats = alloc.dedicatedStats[alloc.memoryProperties.memoryTypes[memoryType].heapIndex];
+            stats.dedicatedBytes += requirements.size;
+            stats.dedicatedCount++;
+            return true;
+        }
+
+        memoryBlock block;
+        if (!allocateDeviceMemory(alloc, memoryType, blockSize, block.memory, block.mapped)) {
+            return false;
+        }
+
+        block.size = blockSize;
+        block.memoryType = memoryType;
+        block.optimal = optimal;
+        block.freeList.push_back({ 0, blockSize });
+
+        // reuse a released slot so indices held by live allocations stay valid
+        uint32_t index = 0;
+        while (index < alloc.blocks.size() && alloc.blocks[index].memory != VK_NULL_HANDLE) {
+            index++;
+        }
+        if (index == alloc.blocks.size()) {
+            alloc.blocks.push_back(block);
+        }
+        else {
+            alloc.blocks[index] = block;
+        }
+
+        VkDeviceSize offset;
+        allocateFromBlock(alloc.blocks[index], requirements.size, requirements.alignment, offset);
+
+        result.memory = alloc.blocks[index].memory;
+        result.offset = offset;
+        result.size = requirements.size;
+        result.mapped = alloc.blocks[index].mapped ? static_cast<char*>(alloc.blocks[index].mapped) + offset : nullptr;
+        result.memoryType = memoryType;
+        result.block = index;
+        return true;
+    }
+}
+
+void memalloc::init(allocator& alloc, VkPhysicalDevice physicalDevice, VkDevice device)
+{
+    alloc.device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &alloc.memoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    alloc.maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+    alloc.dedicatedThreshold = LARGE_HEAP_BLOCK_SIZE / 2;
+    alloc.dedicatedStats.assign(alloc.memoryProperties.memoryHeapCount, heapStats());
+}
+
+void memalloc::destroy(allocator& alloc)
+{
+    std::lock_guard<std::mutex> lock(alloc.mutex);
+
+    for (auto& block : alloc.blocks) {
+        if (block.memory == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        if (block.allocationCount > 0) {
+            std::cerr << "memalloc: " << block.allocationCount << " allocation(s) still live in memory type " << block.memoryType << std::endl;
+        }
+
+        releaseBlock(alloc, block);
+    }
+
+    alloc.blocks.clear();
+}
+
+allocation memalloc::allocate(allocator& alloc, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool optimal)
+{
+    std::lock_guard<std::mutex> lock(alloc.mutex);
+
+    // every compatible type is tried in order, falling through to the next when its heap is exhausted
+    allocation result;
+    for (uint32_t i = 0; i < alloc.memoryProperties.memoryTypeCount; i++) {
+        if ((requirements.memoryTypeBits & (1 << i)) && (alloc.memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            if (tryAllocate(alloc, i, requirements, optimal, result)) {
+                return result;
+            }
+        }
+    }
+
+    throw std::runtime_error("failed to find suitable memory type!");
+}
+
+allocation memalloc::allocateForBuffer(allocator& alloc, VkBuffer buffer, VkMemoryPropertyFlags properties)
+{
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(alloc.device, buffer, &memRequirements);
+
+    allocation result = allocate(alloc, memRequirements, properties, false);
+    if (vkBindBufferMemory(alloc.device, buffer, result.memory, result.offset) != VK_SUCCESS) {
+        free(alloc, result);
+        throw std::runtime_error("failed to bind buffer memory!");
+    }
+    return result;
+}
+
+allocation memalloc::allocateForImage(allocator& alloc, VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties)
+{
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(alloc.device, image, &memRequirements);
+
+    allocation result = allocate(alloc, memRequirements, properties, tiling == VK_IMAGE_TILING_OPTIMAL);
+    if (vkBindImageMemory(alloc.device, image, result.memory, result.offset) != VK_SUCCESS) {
+        free(alloc, result);
+        throw std::runtime_error("failed to bind image memory!");
+    }
+    return result;
+}
+
+void memalloc::free(allocator& alloc, allocation& memory)
+{
+    if (memory.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(alloc.mutex);
+
+    if (memory.block == DEDICATED_BLOCK) {
+        vkFreeMemory(alloc.device, memory.memory, nullptr);
+        alloc.deviceAllocationCount--;
+
+        heapStats& stats = alloc.dedicatedStats[alloc.memoryProperties.memoryTypes[memory.memoryType].heapIndex];
+        stats.dedicatedBytes -= memory.size;
+        stats.dedicatedCount--;
+    }
+    else {
+        memoryBlock& block = alloc.blocks[memory.block];
+        returnToBlock(block, memory.offset, memory.size);
+
+        // keep one empty block per pool around so a free/allocate cycle does not hit the driver every time
+        if (block.allocationCount == 0) {
+            for (uint32_t i = 0; i < alloc.blocks.size(); i++) {
+                const memoryBlock& other = alloc.blocks[i];
+                if (i != memory.block && other.memory != VK_NULL_HANDLE && other.allocationCount == 0
+                    && other.memoryType == block.memoryType && other.optimal == block.optimal) {
+                    releaseBlock(alloc, block);
+                    break;
+                }
+            }
+        }
+    }
+
+    memory = allocation();
+}
+
+std::vector<heapStats> memalloc::getHeapStats(allocator& alloc)
+{
+    std::lock_guard<std::mutex> lock(alloc.mutex);
+
+    std::vector<heapStats> stats = alloc.dedicatedStats;
+    for (const auto& block : alloc.blocks) {
+        if (block.memory == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        heapStats& heap = stats[alloc.memoryProperties.memoryTypes[block.memoryType].heapIndex];
+        heap.blockBytes += block.size;
+        heap.usedBytes += block.used;
+        heap.blockCount++;
+        heap.allocationCount += block.allocationCount;
+    }
+
+    return stats;
+}
+
+void memalloc::printStats(allocator& alloc)
+{
+    std::vector<heapStats> stats = getHeapStats(alloc);
+    const double mebibyte = 1024.0 * 1024.0;
+
+    std::cout << "memalloc: " << alloc.deviceAllocationCount << " of " << alloc.maxAllocationCount << " device allocations in use" << std::endl;
+    for (uint32_t i = 0; i < stats.size(); i++) {
+        const heapStats& heap = stats[i];
+        if (heap.blockCount == 0 && heap.dedicatedCount == 0) {
+            continue;
+        }
+
+        bool deviceLocal = (alloc.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        std::cout << std::fixed << std::setprecision(1)
+             << "  heap " << i << (deviceLocal ? " (device local)" : " (host)") << ": "
+             << heap.usedBytes / mebibyte << " / " << heap.blockBytes / mebibyte << " MiB used in " << heap.blockCount << " block(s), "
+             << heap.allocationCount << " suballocation(s), "
+             << heap.dedicatedCount << " dedicated (" << heap.dedicatedBytes / mebibyte << " MiB)" << std::endl;
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+// Device memory sub-allocator. Large blocks are allocated per memory type and carved up with a
+// first fit free list, so the number of vkAllocateMemory calls stays far below maxMemoryAllocationCount.
+// Linear resources (buffers, linear images) and optimal images live in separate blocks, so neighbouring
+// suballocations can never violate bufferImageGranularity.
+namespace memalloc
+{
+    const uint32_t DEDICATED_BLOCK = UINT32_MAX;
+
+    struct allocation
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;             // host pointer to offset when the memory is host visible, mapped for the allocation's lifetime
+        uint32_t memoryType = 0;
+        uint32_t block = DEDICATED_BLOCK;   // owning block, DEDICATED_BLOCK when the allocation has its own VkDeviceMemory
+    };
+
+    struct freeRange
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct memoryBlock
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;   // VK_NULL_HANDLE once released, the slot is reused
+        VkDeviceSize size = 0;
+        VkDeviceSize used = 0;
+        void* mapped = nullptr;
+        uint32_t memoryType = 0;
+        bool optimal = false;                     // holds optimal tiling images only
+        uint32_t allocationCount = 0;
+        std::vector<freeRange> freeList;          // sorted by offset, neighbours always merged
+    };
+
+    struct heapStats
+    {
+        VkDeviceSize blockBytes = 0;        // reserved by blocks
+        VkDeviceSize usedBytes = 0;         // handed out from blocks
+        VkDeviceSize dedicatedBytes = 0;
+        uint32_t blockCount = 0;
+        uint32_t allocationCount = 0;       // suballocations
+        uint32_t dedicatedCount = 0;
+    };
+
+    struct allocator
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        VkDeviceSize dedicatedThreshold = 0;    // resources at least this big get their own VkDeviceMemory
+        uint32_t maxAllocationCount = 0;
+        uint32_t deviceAllocationCount = 0;     // live vkAllocateMemory allocations, blocks and dedicated
+        std::vector<memoryBlock> blocks;
+        std::vector<heapStats> dedicatedStats;  // per heap, dedicated allocations are not in any block
+        std::mutex mutex;
+    };
+
+    // Reads the memory properties and limits of the physical device.
+    void init(allocator&, VkPhysicalDevice, VkDevice);
+
+    // Releases every block, all allocations must have been freed.
+    void destroy(allocator&);
+
+    // Suballocates memory for the requirements, optimal selects the optimal image pools.
+    allocation allocate(allocator&, const VkMemoryRequirements&, VkMemoryPropertyFlags, bool optimal);
+
+    // Allocates and binds memory for the buffer.
+    allocation allocateForBuffer(allocator&, VkBuffer, VkMemoryPropertyFlags);
+
+    // Allocates and binds memory for the image, large images get a dedicated allocation.
+    allocation allocateForImage(allocator&, VkImage, VkImageTiling, VkMemoryPropertyFlags);
+
+    // Returns the range to its block, or frees the dedicated memory, and resets the allocation.
+    void free(allocator&, allocation&);
+
+    // Current usage of each memory heap.
+    std::vector<heapStats> getHeapStats(allocator&);
+
+    void printStats(allocator&);
+}
@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h> //SSE2, baseline on every x64 target
+
+#include "mipgen.h"
+#include "parallel.h"
+
+using namespace mipgen;
+
+namespace
+{
+    const uint32_t ENCODE_STEPS = 4096; //linear to sRGB table resolution, finer than 8 bit sRGB near black
+
+    struct srgbTables
+    {
+        float decode[256];
+        uint8_t encode[ENCODE_STEPS + 1];
+
+        srgbTables()
+        {
+            for (uint32_t i = 0; i < 256; i++) {
+                float value = i / 255.0f;
+                decode[i] = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            }
+            for (uint32_t i = 0; i <= ENCODE_STEPS; i++) {
+                float value = static_cast<float>(i) / ENCODE_STEPS;
+                float encoded = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+                encode[i] = static_cast<uint8_t>(std::lround(std::min(std::max(encoded, 0.0f), 1.0f) * 255.0f));
+            }
+        }
+    };
+
+    const srgbTables& tables()
+    {
+        static const srgbTables instance;
+        return instance;
+    }
+
+    // Two destination texels from four source texels on each of two rows, source x must be even and x + 3 in range
+    void boxPairSSE2(const uint8_t* row0, const uint8_t* row1, uint8_t* destination)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        __m128i top = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0));
+        __m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1));
+
+        //texels 0 and 1 in the low half, 2 and 3 in the high half, each channel widened to 16 bits
+        __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+        __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+        low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+        high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+
+        __m128i sum = _mm_unpacklo_epi64(low, high);
+        sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(destination), _mm_packus_epi16(sum, sum));
+    }
+
+    // Source texels along one axis feeding one destination texel, and their weights
+    struct taps
+    {
+        uint32_t index[3];
+        float weight[3];
+        uint32_t count;
+    };
+
+    // Even sizes average pairs. Odd sizes above one take three texels whose weights shift along the axis
+    // (the polyphase box), so the destination covers every source texel, the last one included, in equal shares.
+    taps axisTaps(uint32_t size, uint32_t i)
+    {
+        taps result = {};
+        if (size == 1) {
+            result.index[0] = 0;
+            result.weight[0] = 1.0f;
+            result.count = 1;
+        }
+        else if (size % 2 == 0) {
+            result.index[0] = i * 2;
+            result.index[1] = i * 2 + 1;
+            result.weight[0] = 0.5f;
+            result.weight[1] = 0.5f;
+            result.count = 2;
+        }
+        else {
+            float half = static_cast<float>(size / 2);
+            float total = static_cast<float>(size);
+            result.index[0] = i * 2;
+            result.index[1] = i * 2 + 1;
+            result.index[2] = i * 2 + 2;
+            result.weight[0] = (half - i) / total;
+            result.weight[1] = half / total;
+            result.weight[2] = (i + 1) / total;
+            result.count = 3;
+        }
+        return result;
+    }
+
+    void filterTexel(const uint8_t* source, uint32_t width, const taps& columns, const taps& rows, uint8_t* destination, bool srgb)
+    {
+        const srgbTables& lookup = tables();
+        for (uint32_t channel = 0; channel < 4; channel++) {
+            bool decode = srgb && channel < 3; //alpha is stored linearly
+            float sum = 0.0f;
+            for (uint32_t row = 0; row < rows.count; row++) {
+                const uint8_t* line = source + static_cast<size_t>(rows.index[row]) * width * 4;
+                for (uint32_t column = 0; column < columns.count; column++) {
+                    uint8_t value = line[columns.index[column] * 4 + channel];
+                    sum += rows.weight[row] * columns.weight[column] * (decode ? lookup.decode[value] : value);
+                }
+            }
+
+            if (decode) {
+                destination[channel] = lookup.encode[static_cast<uint32_t>(std::min(sum, 1.0f) * ENCODE_STEPS + 0.5f)];
+            }
+            else {
+                destination[channel] = static_cast<uint8_t>(std::min(sum + 0.5f, 255.0f));
+            }
+        }
+    }
+}
+
+uint32_t mipgen::levelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = std::max(width, height); size > 1; size /= 2) {
+        levels++;
+    }
+    return levels;
+}
+
+bool mipgen::supportsLinearBlit(VkPhysicalDevice physicalDevice, VkFormat format)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
+void mipgen::recordBlits(VkCommandBuffer commandBuffer, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    int32_t levelWidth = static_cast<int32_t>(width);
+    int32_t levelHeight = static_cast<int32_t>(height);
+
+    for (uint32_t level = 1; level < mipLevels; level++) {
+        //the previous level has been written, by the upload or the last blit, and becomes the source
+        barrier.subresourceRange.baseMipLevel = level - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        int32_t nextWidth = std::max(levelWidth / 2, 1);
+        int32_t nextHeight = std::max(levelHeight / 2, 1);
+
+        VkImageBlit blit = {};
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { levelWidth, levelHeight, 1 };
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = level - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = level;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+
+        vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+    }
+
+    //the last level is only ever written
+    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void mipgen::downsample(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination, bool srgb)
+{
+    uint32_t nextWidth = std::max(width / 2, 1u);
+    uint32_t nextHeight = std::max(height / 2, 1u);
+
+    //even sizes are plain 2x2 boxes, odd ones use three taps on that axis so no edge row or column is dropped
+    bool boxes = !srgb && width % 2 == 0 && height % 2 == 0;
+    parallel::forRanges(nextHeight, [&](uint32_t rowBegin, uint32_t rowEnd) {
+        for (uint32_t y = rowBegin; y < rowEnd; y++) {
+            taps rows = axisTaps(height, y);
+            uint8_t* row = destination + static_cast<size_t>(y) * nextWidth * 4;
+
+            uint32_t x = 0;
+            if (boxes) {
+                const uint8_t* row0 = source + static_cast<size_t>(rows.index[0]) * width * 4;
+                const uint8_t* row1 = source + static_cast<size_t>(rows.index[1]) * width * 4;
+                for (; x * 2 + 3 < width; x += 2) {
+                    boxPairSSE2(row0 + x * 8, row1 + x * 8, row + x * 4);
+                }
+            }
+            for (; x < nextWidth; x++) {
+                filterTexel(source, width, axisTaps(width, x), rows, row + x * 4, srgb);
+            }
+        }
+    });
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+// Mip chain generation for RGBA8 textures. On the GPU the chain is blitted down from level 0 where the format supports
+// linear filtered blits. The CPU fallback is a 2x2 box filter split across the hardware threads, SSE2 for UNORM data and
+// averaged in linear space for sRGB data.
+namespace mipgen
+{
+    // Levels of a full chain down to 1x1.
+    uint32_t levelCount(uint32_t width, uint32_t height);
+
+    // True when optimal tiled images of this format can be the source and destination of a linear filtered blit.
+    bool supportsLinearBlit(VkPhysicalDevice, VkFormat);
+
+    // Records the blits filling levels [1, mipLevels) from level 0. Expects every level in TRANSFER_DST_OPTIMAL
+    // and leaves them in SHADER_READ_ONLY_OPTIMAL. Needs a graphics queue.
+    void recordBlits(VkCommandBuffer, VkImage, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+    // Writes the next level of a width x height RGBA8 image into destination, max(width / 2, 1) x max(height / 2, 1) texels.
+    void downsample(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* destination, bool srgb);
+}
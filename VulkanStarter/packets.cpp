@@ -0,0 +1,174 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <thread>
+
+#include "packets.h"
+
+using namespace packets;
+
+namespace
+{
+    const uint32_t SPINS_BEFORE_SLEEP = 64;
+    const std::chrono::microseconds BACKOFF_SLEEP(100);
+
+    double milliseconds(clock::time_point start, clock::time_point end)
+    {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // spins on the condition for a short while, then sleeps between checks, counts the wait when it had to
+    template<typename Ready>
+    void waitUntil(sideStats& stats, Ready ready)
+    {
+        if (ready()) {
+            return;
+        }
+
+        auto start = clock::now();
+        for (uint32_t spin = 0; !ready(); spin++) {
+            if (spin < SPINS_BEFORE_SLEEP) {
+                std::this_thread::yield();
+            }
+            else {
+                std::this_thread::sleep_for(BACKOFF_SLEEP);
+            }
+        }
+        stats.stalls++;
+        stats.stallMilliseconds += milliseconds(start, clock::now());
+    }
+}
+
+void packets::init(queue& packetQueue, uint32_t capacity)
+{
+    packetQueue.capacity = capacity;
+    packetQueue.published.store(0, std::memory_order_relaxed);
+    packetQueue.released.store(0, std::memory_order_relaxed);
+    packetQueue.closed.store(false, std::memory_order_relaxed);
+    packetQueue.pauseRequested.store(false, std::memory_order_relaxed);
+    packetQueue.parked.store(false, std::memory_order_relaxed);
+    packetQueue.built.assign(capacity, interval());
+    packetQueue.consumed.clear();
+}
+
+bool packets::waitWrite(queue& packetQueue, uint32_t& slot)
+{
+    uint64_t next = packetQueue.published.load(std::memory_order_relaxed); //only this thread writes it
+
+    //acquire pairs with release(), the consumer is done reading the slot before it is overwritten
+    waitUntil(packetQueue.producer, [&packetQueue, next]() {
+        return packetQueue.closed.load(std::memory_order_relaxed) || packetQueue.pauseRequested.load(std::memory_order_relaxed)
+            || next - packetQueue.released.load(std::memory_order_acquire) < packetQueue.capacity;
+    });
+    while (packetQueue.pauseRequested.load(std::memory_order_relaxed) && !packetQueue.closed.load(std::memory_order_relaxed)) {
+        //release pairs with pause(), everything the last packet's building wrote is visible to the consumer
+        packetQueue.parked.store(true, std::memory_order_release);
+        waitUntil(packetQueue.producer, [&packetQueue]() {
+            return packetQueue.closed.load(std::memory_order_relaxed) || !packetQueue.pauseRequested.load(std::memory_order_acquire);
+        });
+        packetQueue.parked.store(false, std::memory_order_relaxed);
+
+        waitUntil(packetQueue.producer, [&packetQueue, next]() {
+            return packetQueue.closed.load(std::memory_order_relaxed) || packetQueue.pauseRequested.load(std::memory_order_relaxed)
+                || next - packetQueue.released.load(std::memory_order_acquire) < packetQueue.capacity;
+        });
+    }
+    if (packetQueue.closed.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    slot = static_cast<uint32_t>(next % packetQueue.capacity);
+    packetQueue.produceStart = clock::now();
+    return true;
+}
+
+void packets::publish(queue& packetQueue)
+{
+    uint64_t next = packetQueue.published.load(std::memory_order_relaxed);
+    interval& building = packetQueue.built[next % packetQueue.capacity];
+    building.start = packetQueue.produceStart;
+    building.end = clock::now();
+
+    packetQueue.producer.packets++;
+    packetQueue.producer.busyMilliseconds += milliseconds(building.start, building.end);
+
+    packetQueue.published.store(next + 1, std::memory_order_release); //the packet and its timing become visible together
+}
+
+bool packets::waitRead(queue& packetQueue, uint32_t& slot)
+{
+    uint64_t next = packetQueue.released.load(std::memory_order_relaxed); //only this thread writes it
+
+    //acquire pairs with publish(), everything written into the packet is visible here
+    waitUntil(packetQueue.consumer, [&packetQueue, next]() {
+        return packetQueue.published.load(std::memory_order_acquire) > next || packetQueue.closed.load(std::memory_order_relaxed);
+    });
+    if (packetQueue.published.load(std::memory_order_acquire) == next) {
+        return false; //closed with nothing left to draw
+    }
+
+    slot = static_cast<uint32_t>(next % packetQueue.capacity);
+    packetQueue.consumeStart = clock::now();
+
+    //a packet is built after the one capacity places before it was released, so only the packets drawn since then
+    //can overlap its building
+    const interval& building = packetQueue.built[slot];
+    for (const interval& drawing : packetQueue.consumed) {
+        clock::time_point start = std::max(building.start, drawing.start);
+        clock::time_point end = std::min(building.end, drawing.end);
+        if (start < end) {
+            packetQueue.overlapMilliseconds += milliseconds(start, end);
+        }
+    }
+    return true;
+}
+
+void packets::release(queue& packetQueue)
+{
+    interval drawing = { packetQueue.consumeStart, clock::now() };
+    packetQueue.consumed.push_back(drawing);
+    if (packetQueue.consumed.size() > packetQueue.capacity) {
+        packetQueue.consumed.pop_front();
+    }
+
+    packetQueue.consumer.packets++;
+    packetQueue.consumer.busyMilliseconds += milliseconds(drawing.start, drawing.end);
+
+    uint64_t next = packetQueue.released.load(std::memory_order_relaxed);
+    packetQueue.released.store(next + 1, std::memory_order_release);
+}
+
+void packets::pause(queue& packetQueue)
+{
+    packetQueue.pauseRequested.store(true, std::memory_order_relaxed);
+    waitUntil(packetQueue.consumer, [&packetQueue]() {
+        return packetQueue.parked.load(std::memory_order_acquire) || packetQueue.closed.load(std::memory_order_relaxed);
+    });
+}
+
+void packets::resume(queue& packetQueue)
+{
+    //release pairs with the parked producer, what the consumer changed while it waited is visible once it carries on
+    packetQueue.pauseRequested.store(false, std::memory_order_release);
+}
+
+void packets::close(queue& packetQueue)
+{
+    packetQueue.closed.store(true, std::memory_order_relaxed);
+}
+
+void packets::printStats(const queue& packetQueue)
+{
+    const sideStats& producer = packetQueue.producer;
+    const sideStats& consumer = packetQueue.consumer;
+    double buildMilliseconds = producer.packets > 0 ? producer.busyMilliseconds / producer.packets : 0.0;
+    double drawMilliseconds = consumer.packets > 0 ? consumer.busyMilliseconds / consumer.packets : 0.0;
+    double overlapMilliseconds = consumer.packets > 0 ? packetQueue.overlapMilliseconds / consumer.packets : 0.0;
+    double hidden = producer.busyMilliseconds > 0.0 ? 100.0 * packetQueue.overlapMilliseconds / producer.busyMilliseconds : 0.0;
+
+    std::cout << "frame packets: " << producer.packets << " built, " << consumer.packets << " drawn, " << std::fixed << std::setprecision(3)
+        << buildMilliseconds << " ms building and " << drawMilliseconds << " ms drawing per packet, "
+        << overlapMilliseconds << " ms overlapped (" << std::setprecision(1) << hidden << "% of building hidden), " << std::setprecision(3)
+        << "simulation stalled " << producer.stalls << " times (" << producer.stallMilliseconds << " ms), "
+        << "render stalled " << consumer.stalls << " times (" << consumer.stallMilliseconds << " ms)" << std::endl;
+}
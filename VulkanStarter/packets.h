@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Single producer, single consumer hand off of frame packets between the simulation thread and the render thread.
+// The queue only hands out slot indices, the packets themselves live in an array of the caller's indexed by slot.
+// The producer fills a free slot and publishes it, after which the packet is immutable until the consumer releases
+// it. Two counters with acquire and release ordering are the only shared state, neither side ever takes a lock.
+// A side that finds the queue full or empty spins briefly and then sleeps, a full queue is the render thread pacing
+// the simulation. The time each packet took to build is kept with it, so the consumer can measure how much of the
+// simulation's work ran while the previous packets were being drawn. The consumer can also park the producer at its
+// next waitWrite(), for work that touches state the producer uses while building a packet.
+namespace packets
+{
+    typedef std::chrono::high_resolution_clock clock;
+
+    struct interval
+    {
+        clock::time_point start;
+        clock::time_point end;
+    };
+
+    struct sideStats
+    {
+        uint64_t packets = 0;
+        uint64_t stalls = 0;                    // waits on a full queue for the producer, an empty one for the consumer
+        double stallMilliseconds = 0.0;
+        double busyMilliseconds = 0.0;          // between getting a slot and publishing or releasing it
+    };
+
+    struct queue
+    {
+        uint32_t capacity = 0;
+        std::atomic<uint64_t> published{ 0 };   // written by the producer only
+        std::atomic<uint64_t> released{ 0 };    // written by the consumer only
+        std::atomic<bool> closed{ false };
+        std::atomic<bool> pauseRequested{ false }; // written by the consumer only
+        std::atomic<bool> parked{ false };      // written by the producer only
+        std::vector<interval> built;            // by slot, written before the slot is published
+
+        // producer side
+        clock::time_point produceStart;
+        sideStats producer;
+
+        // consumer side
+        clock::time_point consumeStart;
+        std::deque<interval> consumed;          // the last capacity packets drawn
+        sideStats consumer;
+        double overlapMilliseconds = 0.0;       // building that ran while earlier packets were drawn
+    };
+
+    void init(queue&, uint32_t capacity);
+
+    // Blocks until a slot is free and returns it, false once the queue is closed. Producer only.
+    bool waitWrite(queue&, uint32_t& slot);
+
+    // Makes the slot's packet visible to the consumer. Producer only.
+    void publish(queue&);
+
+    // Blocks until a packet is published and returns its slot, false once the queue is closed and drained. Consumer only.
+    bool waitRead(queue&, uint32_t& slot);
+
+    // Hands the slot back to the producer. Consumer only.
+    void release(queue&);
+
+    // Blocks until the producer waits in waitWrite() or the queue is closed, either way it builds nothing until
+    // resume(). Call between packets, the producer may need a released slot to get back to waitWrite(). Consumer only.
+    void pause(queue&);
+
+    // Lets a paused producer carry on. Consumer only.
+    void resume(queue&);
+
+    // Wakes both sides for shutdown, from either thread.
+    void close(queue&);
+
+    // Call once both threads have stopped.
+    void printStats(const queue&);
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+
+// Fork/join helper for the CPU texture passes (mip filtering, block compression). Each call spawns its threads and
+// joins them before returning, nothing is kept between calls.
+namespace parallel
+{
+    // Splits [0, count) into contiguous ranges, one per hardware thread, and calls function(begin, end) for each.
+    template<typename Function>
+    void forRanges(uint32_t count, Function function)
+    {
+        uint32_t threadCount = std::max(1u, std::min(std::thread::hardware_concurrency(), count));
+        uint32_t chunk = (count + threadCount - 1) / threadCount;
+
+        std::vector<std::thread> threads;
+        for (uint32_t begin = 0; begin < count; begin += chunk) {
+            uint32_t end = std::min(begin + chunk, count);
+            threads.emplace_back(function, begin, end);
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+}
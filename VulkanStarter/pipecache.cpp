@@ -0,0 +1,175 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <vector>
+#include <filesystem>
+#include <stdexcept>
+#include <cstring>
+
+#include "pipecache.h"
+
+using namespace pipecache;
+
+namespace
+{
+    const uint32_t CACHE_MAGIC = 0x43505643; // "CVPC"
+    const uint32_t CACHE_VERSION = 1;
+
+    // Reads the cache data when the file was written on this device and driver, empty otherwise.
+    std::vector<char> readCache(const std::string& path, const fileHeader& expected)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            return {};
+        }
+
+        fileHeader header;
+        file.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file || header.magic != expected.magic || header.version != expected.version || header.vendorID != expected.vendorID
+            || header.deviceID != expected.deviceID || header.driverVersion != expected.driverVersion
+            || memcmp(header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            std::cout << "pipeline cache: " << path << " was written by another device or driver, starting cold" << std::endl;
+            return {};
+        }
+
+        //the size comes from the file itself, a corrupt one must not get to size the allocation
+        std::streampos dataStart = file.tellg();
+        file.seekg(0, std::ios::end);
+        std::streamoff remaining = file.tellg() - dataStart;
+        file.seekg(dataStart);
+        if (!file || remaining < 0 || header.dataSize > static_cast<uint64_t>(remaining)) {
+            std::cout << "pipeline cache: " << path << " is truncated, starting cold" << std::endl;
+            return {};
+        }
+
+        std::vector<char> data(static_cast<size_t>(header.dataSize));
+        file.read(data.data(), data.size());
+        if (!file) {
+            std::cout << "pipeline cache: " << path << " is truncated, starting cold" << std::endl;
+            return {};
+        }
+
+        //the driver's own header leads the data, check it as well rather than trusting the driver to reject it
+        struct driverHeader
+        {
+            uint32_t headerSize;
+            uint32_t headerVersion;
+            uint32_t vendorID;
+            uint32_t deviceID;
+            uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        };
+
+        driverHeader driver;
+        if (data.size() < sizeof(driver)) {
+            return {};
+        }
+        memcpy(&driver, data.data(), sizeof(driver));
+
+        if (driver.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || driver.vendorID != expected.vendorID || driver.deviceID != expected.deviceID
+            || memcmp(driver.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            std::cout << "pipeline cache: " << path << " holds data for another device, starting cold" << std::endl;
+            return {};
+        }
+
+        return data;
+    }
+}
+
+void pipecache::init(cache& pipelineCache, VkPhysicalDevice physicalDevice, VkDevice device, const std::string& path)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    pipelineCache.device = device;
+    pipelineCache.path = path;
+    pipelineCache.expected.magic = CACHE_MAGIC;
+    pipelineCache.expected.version = CACHE_VERSION;
+    pipelineCache.expected.vendorID = properties.vendorID;
+    pipelineCache.expected.deviceID = properties.deviceID;
+    pipelineCache.expected.driverVersion = properties.driverVersion;
+    memcpy(pipelineCache.expected.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+    std::vector<char> data = readCache(path, pipelineCache.expected);
+
+    VkPipelineCacheCreateInfo cacheInfo = {};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache.handle) != VK_SUCCESS) {
+        //a driver may still refuse data it does not like, an empty cache always works
+        cacheInfo.initialDataSize = 0;
+        cacheInfo.pInitialData = nullptr;
+        data.clear();
+
+        if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache.handle) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create pipeline cache!");
+        }
+    }
+
+    pipelineCache.warm = !data.empty();
+    pipelineCache.loadedBytes = data.size();
+}
+
+void pipecache::save(const cache& pipelineCache)
+{
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(pipelineCache.device, pipelineCache.handle, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+        return;
+    }
+
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(pipelineCache.device, pipelineCache.handle, &dataSize, data.data()) != VK_SUCCESS) {
+        std::cerr << "pipeline cache: unable to read the cache data" << std::endl;
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::path parent = std::filesystem::path(pipelineCache.path).parent_path();
+    if (!parent.empty()) {
+        std::filesystem::create_directories(parent, error);
+    }
+
+    // write beside the target and rename so a crash never leaves a truncated cache behind
+    std::string temporaryPath = pipelineCache.path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cerr << "pipeline cache: unable to write " << temporaryPath << std::endl;
+            return;
+        }
+
+        fileHeader header = pipelineCache.expected;
+        header.dataSize = dataSize;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), dataSize);
+
+        if (!file) {
+            std::cerr << "pipeline cache: failed writing " << temporaryPath << std::endl;
+            return;
+        }
+    }
+
+    std::filesystem::rename(temporaryPath, pipelineCache.path, error);
+    if (error) {
+        std::cerr << "pipeline cache: unable to replace " << pipelineCache.path << ": " << error.message() << std::endl;
+    }
+}
+
+void pipecache::destroy(cache& pipelineCache)
+{
+    vkDestroyPipelineCache(pipelineCache.device, pipelineCache.handle, nullptr);
+    pipelineCache.handle = VK_NULL_HANDLE;
+}
+
+void pipecache::recordCreation(cache& pipelineCache, uint32_t pipelineCount, double milliseconds)
+{
+    pipelineCache.pipelines += pipelineCount;
+    pipelineCache.creationMilliseconds += milliseconds;
+}
+
+void pipecache::printStats(const cache& pipelineCache)
+{
+    std::cout << "pipeline cache: " << (pipelineCache.warm ? "warm" : "cold") << " start (" << pipelineCache.loadedBytes / 1024 << " KB loaded), "
+        << pipelineCache.pipelines << " pipelines created in " << std::fixed << std::setprecision(2) << pipelineCache.creationMilliseconds << " ms" << std::endl;
+}
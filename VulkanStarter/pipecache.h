@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <cstdint>
+
+// Persistent pipeline cache. The driver's cache data is stored on disk behind a header naming the device and driver
+// it came from, and is only handed back to a matching device, a stale or foreign file starts an empty (cold) cache.
+// Every pipeline, ImGui's included, is created through the one VkPipelineCache, which is written back on exit
+// beside the old file and renamed over it so a crash never leaves a truncated cache.
+namespace pipecache
+{
+    struct fileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;             // not part of the driver's own header, a driver update must not reuse old data
+        uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+        uint64_t dataSize;
+    };
+
+    struct cache
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        VkPipelineCache handle = VK_NULL_HANDLE;
+        std::string path;
+        fileHeader expected = {};           // header of this device and driver
+        bool warm = false;                  // started from a valid file
+        size_t loadedBytes = 0;
+
+        uint32_t pipelines = 0;             // created through the cache
+        double creationMilliseconds = 0.0;
+    };
+
+    // Creates the cache, seeded from path when the file matches the device.
+    void init(cache&, VkPhysicalDevice, VkDevice, const std::string& path);
+
+    // Writes the cache data to path atomically.
+    void save(const cache&);
+
+    void destroy(cache&);
+
+    // Adds the time spent creating a batch of pipelines, for the startup report.
+    void recordCreation(cache&, uint32_t pipelineCount, double milliseconds);
+
+    void printStats(const cache&);
+}
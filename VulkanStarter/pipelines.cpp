@@ -0,0 +1,466 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+#include "pipelines.h"
+
+using namespace pipelines;
+
+namespace
+{
+    void hashCombine(size_t& seed, size_t value)
+    {
+        seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+
+    std::vector<char> readShader(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open shader " + path + "!");
+        }
+
+        std::vector<char> code(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(code.data(), static_cast<std::streamsize>(code.size()));
+        return code;
+    }
+
+    VkShaderModule createShaderModule(VkDevice device, const std::string& path)
+    {
+        std::vector<char> code = readShader(path);
+
+        VkShaderModuleCreateInfo createInfo = {};
+        createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        createInfo.codeSize = code.size();
+        createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+        VkShaderModule shaderModule;
+        if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create shader module " + path + "!");
+        }
+        return shaderModule;
+    }
+
+    // Writes the blend attachments of a mode into attachments, returns their count
+    uint32_t blendAttachments(blendMode blend, VkPipelineColorBlendAttachmentState* attachments)
+    {
+        const VkColorComponentFlags allComponents = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+        switch (blend) {
+        case blendMode::alpha:
+            attachments[0] = {};
+            attachments[0].colorWriteMask = allComponents;
+            attachments[0].blendEnable = VK_TRUE;
+            attachments[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+            attachments[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+            attachments[0].colorBlendOp = VK_BLEND_OP_ADD;
+            attachments[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            attachments[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            attachments[0].alphaBlendOp = VK_BLEND_OP_ADD;
+            return 1;
+
+        case blendMode::oit:
+            //accumulation sums premultiplied colour and weight
+            attachments[0] = {};
+            attachments[0].colorWriteMask = allComponents;
+            attachments[0].blendEnable = VK_TRUE;
+            attachments[0].srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            attachments[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            attachments[0].colorBlendOp = VK_BLEND_OP_ADD;
+            attachments[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            attachments[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            attachments[0].alphaBlendOp = VK_BLEND_OP_ADD;
+
+            //revealage multiplies by one minus each coverage
+            attachments[1] = {};
+            attachments[1].colorWriteMask = VK_COLOR_COMPONENT_R_BIT;
+            attachments[1].blendEnable = VK_TRUE;
+            attachments[1].srcColorBlendFactor = VK_BLEND_FACTOR_ZERO;
+            attachments[1].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_COLOR;
+            attachments[1].colorBlendOp = VK_BLEND_OP_ADD;
+            attachments[1].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+            attachments[1].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+            attachments[1].alphaBlendOp = VK_BLEND_OP_ADD;
+            return 2;
+
+        default:
+            return 0;
+        }
+    }
+
+    VkPipeline compile(registry& pipelineRegistry, const graphicsState& state)
+    {
+        VkDevice device = pipelineRegistry.device;
+
+        //every constant is 32 bits, constant_id i reads the i-th value
+        std::vector<VkSpecializationMapEntry> specializationEntries(state.specialization.size());
+        for (uint32_t i = 0; i < specializationEntries.size(); i++) {
+            specializationEntries[i].constantID = i;
+            specializationEntries[i].offset = i * sizeof(uint32_t);
+            specializationEntries[i].size = sizeof(uint32_t);
+        }
+
+        VkSpecializationInfo specializationInfo = {};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+        specializationInfo.pMapEntries = specializationEntries.data();
+        specializationInfo.dataSize = state.specialization.size() * sizeof(uint32_t);
+        specializationInfo.pData = state.specialization.data();
+        const VkSpecializationInfo* specialization = state.specialization.empty() ? nullptr : &specializationInfo;
+
+        VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+        uint32_t stageCount = 0;
+
+        shaderStages[stageCount].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[stageCount].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[stageCount].module = createShaderModule(device, state.vertexShader);
+        shaderStages[stageCount].pName = "main";
+        shaderStages[stageCount].pSpecializationInfo = specialization; //ids a stage does not declare are ignored
+        stageCount++;
+
+        if (!state.fragmentShader.empty()) {
+            try {
+                shaderStages[stageCount].module = createShaderModule(device, state.fragmentShader);
+            }
+            catch (...) {
+                vkDestroyShaderModule(device, shaderStages[0].module, nullptr);
+                throw;
+            }
+            shaderStages[stageCount].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            shaderStages[stageCount].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+            shaderStages[stageCount].pName = "main";
+            shaderStages[stageCount].pSpecializationInfo = specialization;
+            stageCount++;
+        }
+
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(state.vertexBindings.size());
+        vertexInputInfo.pVertexBindingDescriptions = state.vertexBindings.data();
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(state.vertexAttributes.size());
+        vertexInputInfo.pVertexAttributeDescriptions = state.vertexAttributes.data();
+
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = state.topology;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        //set by the command buffer, a new swap chain extent needs no new pipelines
+        VkPipelineViewportStateCreateInfo viewportState = {};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.scissorCount = 1;
+
+        VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dynamicState = {};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+
+        VkPipelineRasterizationStateCreateInfo rasterizer = {};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.depthClampEnable = VK_FALSE;
+        rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = state.cullMode;
+        rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        rasterizer.depthBiasEnable = VK_FALSE;
+
+        VkPipelineMultisampleStateCreateInfo multisampling = {};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.sampleShadingEnable = VK_FALSE;
+        multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = VK_TRUE;
+        depthStencil.depthWriteEnable = state.depth == depthMode::testWrite ? VK_TRUE : VK_FALSE;
+        depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+        depthStencil.depthBoundsTestEnable = VK_FALSE;
+        depthStencil.stencilTestEnable = VK_FALSE;
+
+        VkPipelineColorBlendAttachmentState colorBlendAttachments[2];
+        VkPipelineColorBlendStateCreateInfo colorBlending = {};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.logicOpEnable = VK_FALSE;
+        colorBlending.logicOp = VK_LOGIC_OP_COPY;
+        colorBlending.attachmentCount = blendAttachments(state.blend, colorBlendAttachments);
+        colorBlending.pAttachments = colorBlendAttachments;
+
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = stageCount;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = state.depth == depthMode::none ? nullptr : &depthStencil;
+        pipelineInfo.pColorBlendState = state.blend == blendMode::none ? nullptr : &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = pipelineRegistry.layout;
+        pipelineInfo.renderPass = state.renderPass;
+        pipelineInfo.subpass = state.subpass;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+        //the pipeline cache is internally synchronised, every worker creates through it at once
+        VkPipeline pipeline;
+        VkResult result = vkCreateGraphicsPipelines(device, pipelineRegistry.pipelineCache->handle, 1, &pipelineInfo, nullptr, &pipeline);
+
+        for (uint32_t i = 0; i < stageCount; i++) {
+            vkDestroyShaderModule(device, shaderStages[i].module, nullptr);
+        }
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("failed to create graphics pipeline for " + state.vertexShader + "!");
+        }
+        return pipeline;
+    }
+
+    void compileLoop(registry* pipelineRegistry)
+    {
+        for (;;) {
+            compileJob job;
+            {
+                std::unique_lock<std::mutex> lock(pipelineRegistry->mutex);
+                pipelineRegistry->wake.wait(lock, [pipelineRegistry]() { return pipelineRegistry->stopping || !pipelineRegistry->jobs.empty(); });
+                if (pipelineRegistry->stopping) {
+                    return;
+                }
+                job = std::move(pipelineRegistry->jobs.front());
+                pipelineRegistry->jobs.pop_front();
+                pipelineRegistry->compiling++;
+            }
+
+            compiledPipeline result = { job.id, VK_NULL_HANDLE, 0.0, std::string() };
+            auto compileStart = std::chrono::high_resolution_clock::now();
+            try {
+                result.pipeline = compile(*pipelineRegistry, job.state);
+            }
+            catch (const std::exception& e) {
+                result.error = e.what(); //thrown again on the main thread by collect()
+            }
+            result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - compileStart).count();
+
+            std::lock_guard<std::mutex> lock(pipelineRegistry->mutex);
+            pipelineRegistry->finished.push_back(std::move(result));
+            pipelineRegistry->compiling--;
+            if (pipelineRegistry->compiling == 0) {
+                pipelineRegistry->idle.notify_all();
+            }
+        }
+    }
+
+    void destroyPipelines(registry& pipelineRegistry)
+    {
+        for (variant& entry : pipelineRegistry.variants) {
+            if (entry.pipeline != VK_NULL_HANDLE) {
+                vkDestroyPipeline(pipelineRegistry.device, entry.pipeline, nullptr);
+            }
+        }
+        pipelineRegistry.variants.clear();
+        pipelineRegistry.byHash.clear();
+        pipelineRegistry.pendingCount = 0;
+        pipelineRegistry.batchCount = 0;
+    }
+}
+
+bool pipelines::operator==(const graphicsState& a, const graphicsState& b)
+{
+    if (a.vertexShader != b.vertexShader || a.fragmentShader != b.fragmentShader || a.specialization != b.specialization || a.topology != b.topology || a.cullMode != b.cullMode
+        || a.depth != b.depth || a.blend != b.blend || a.renderPass != b.renderPass || a.subpass != b.subpass
+        || a.vertexBindings.size() != b.vertexBindings.size() || a.vertexAttributes.size() != b.vertexAttributes.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.vertexBindings.size(); i++) {
+        const VkVertexInputBindingDescription& x = a.vertexBindings[i];
+        const VkVertexInputBindingDescription& y = b.vertexBindings[i];
+        if (x.binding != y.binding || x.stride != y.stride || x.inputRate != y.inputRate) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < a.vertexAttributes.size(); i++) {
+        const VkVertexInputAttributeDescription& x = a.vertexAttributes[i];
+        const VkVertexInputAttributeDescription& y = b.vertexAttributes[i];
+        if (x.location != y.location || x.binding != y.binding || x.format != y.format || x.offset != y.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t pipelines::hash(const graphicsState& state)
+{
+    size_t seed = std::hash<std::string>()(state.vertexShader);
+    hashCombine(seed, std::hash<std::string>()(state.fragmentShader));
+    for (uint32_t value : state.specialization) {
+        hashCombine(seed, value);
+    }
+    for (const VkVertexInputBindingDescription& binding : state.vertexBindings) {
+        hashCombine(seed, binding.binding);
+        hashCombine(seed, binding.stride);
+        hashCombine(seed, binding.inputRate);
+    }
+    for (const VkVertexInputAttributeDescription& attribute : state.vertexAttributes) {
+        hashCombine(seed, attribute.location);
+        hashCombine(seed, attribute.binding);
+        hashCombine(seed, attribute.format);
+        hashCombine(seed, attribute.offset);
+    }
+    hashCombine(seed, state.topology);
+    hashCombine(seed, state.cullMode);
+    hashCombine(seed, static_cast<size_t>(state.depth));
+    hashCombine(seed, static_cast<size_t>(state.blend));
+    hashCombine(seed, std::hash<const void*>()(reinterpret_cast<const void*>(state.renderPass)));
+    hashCombine(seed, state.subpass);
+    return seed;
+}
+
+void pipelines::init(registry& pipelineRegistry, VkDevice device, pipecache::cache& pipelineCache, VkPipelineLayout layout)
+{
+    pipelineRegistry.device = device;
+    pipelineRegistry.pipelineCache = &pipelineCache;
+    pipelineRegistry.layout = layout;
+    pipelineRegistry.stopping = false;
+
+    uint32_t workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), MAX_WORKERS));
+    for (uint32_t i = 0; i < workerCount; i++) {
+        pipelineRegistry.workers.emplace_back(compileLoop, &pipelineRegistry);
+    }
+}
+
+void pipelines::destroy(registry& pipelineRegistry)
+{
+    {
+        std::lock_guard<std::mutex> lock(pipelineRegistry.mutex);
+        pipelineRegistry.stopping = true;
+    }
+    pipelineRegistry.wake.notify_all();
+    for (std::thread& worker : pipelineRegistry.workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    pipelineRegistry.workers.clear();
+
+    //pipelines finished after the last collect()
+    for (compiledPipeline& result : pipelineRegistry.finished) {
+        if (result.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(pipelineRegistry.device, result.pipeline, nullptr);
+        }
+    }
+    pipelineRegistry.finished.clear();
+    pipelineRegistry.jobs.clear();
+
+    destroyPipelines(pipelineRegistry);
+}
+
+handle pipelines::request(registry& pipelineRegistry, const graphicsState& state, handle fallback)
+{
+    pipelineRegistry.requests++;
+
+    size_t stateHash = hash(state);
+    std::vector<handle>& bucket = pipelineRegistry.byHash[stateHash];
+    for (handle id : bucket) {
+        if (pipelineRegistry.variants[id].state == state) {
+            pipelineRegistry.deduplicated++;
+            return id;
+        }
+    }
+
+    handle id = static_cast<handle>(pipelineRegistry.variants.size());
+    variant entry;
+    entry.state = state;
+    entry.hash = stateHash;
+    entry.fallback = fallback;
+    pipelineRegistry.variants.push_back(std::move(entry));
+    bucket.push_back(id);
+
+    if (pipelineRegistry.pendingCount == 0) {
+        pipelineRegistry.batchStart = std::chrono::high_resolution_clock::now();
+        pipelineRegistry.batchCount = 0;
+    }
+    pipelineRegistry.pendingCount++;
+    pipelineRegistry.batchCount++;
+
+    {
+        std::lock_guard<std::mutex> lock(pipelineRegistry.mutex);
+        pipelineRegistry.jobs.push_back({ id, state });
+    }
+    pipelineRegistry.wake.notify_one();
+
+    return id;
+}
+
+void pipelines::collect(registry& pipelineRegistry)
+{
+    std::vector<compiledPipeline> results;
+    {
+        std::lock_guard<std::mutex> lock(pipelineRegistry.mutex);
+        results.swap(pipelineRegistry.finished);
+    }
+
+    for (compiledPipeline& result : results) {
+        if (!result.error.empty()) {
+            throw std::runtime_error(result.error);
+        }
+
+        variant& entry = pipelineRegistry.variants[result.id];
+        entry.pipeline = result.pipeline;
+        entry.compileMilliseconds = result.milliseconds;
+        pipelineRegistry.compiled++;
+        pipelineRegistry.compileMilliseconds += result.milliseconds;
+        pipelineRegistry.pendingCount--;
+
+        if (pipelineRegistry.pendingCount == 0) {
+            double readyMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - pipelineRegistry.batchStart).count();
+            pipecache::recordCreation(*pipelineRegistry.pipelineCache, pipelineRegistry.batchCount, readyMilliseconds);
+            std::cout << "pipelines: " << pipelineRegistry.batchCount << " ready " << std::fixed << std::setprecision(2) << readyMilliseconds
+                << " ms after their request on " << pipelineRegistry.workers.size() << " workers" << std::endl;
+        }
+    }
+}
+
+VkPipeline pipelines::get(const registry& pipelineRegistry, handle id)
+{
+    //a fallback may itself be compiling, follow the chain to the first ready pipeline
+    while (id != NO_PIPELINE) {
+        const variant& entry = pipelineRegistry.variants[id];
+        if (entry.pipeline != VK_NULL_HANDLE) {
+            return entry.pipeline;
+        }
+        id = entry.fallback;
+    }
+    return VK_NULL_HANDLE;
+}
+
+void pipelines::clear(registry& pipelineRegistry)
+{
+    std::vector<compiledPipeline> results;
+    {
+        std::unique_lock<std::mutex> lock(pipelineRegistry.mutex);
+        pipelineRegistry.jobs.clear();
+        pipelineRegistry.idle.wait(lock, [&pipelineRegistry]() { return pipelineRegistry.compiling == 0; });
+        results.swap(pipelineRegistry.finished);
+    }
+
+    for (compiledPipeline& result : results) {
+        if (result.pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(pipelineRegistry.device, result.pipeline, nullptr);
+        }
+    }
+
+    destroyPipelines(pipelineRegistry);
+}
+
+void pipelines::printStats(const registry& pipelineRegistry)
+{
+    std::cout << "pipelines: " << pipelineRegistry.requests << " requests, " << pipelineRegistry.deduplicated << " shared an existing variant, "
+        << pipelineRegistry.compiled << " compiled in " << std::fixed << std::setprecision(2) << pipelineRegistry.compileMilliseconds << " ms of worker time" << std::endl;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+
+#include "pipecache.h"
+
+// Graphics pipeline registry. Pipelines are described by a state key (shaders and their specialization constants,
+// vertex layout, rasterizer, depth and blend state, render pass and subpass) rather than written out as create
+// functions, so shader permutations are just keys that differ in their constants. Requests for an equal key share
+// one pipeline, and every new key is compiled through the shared pipeline cache by a small pool of worker threads, so
+// nothing on the main thread waits for a compile. Until a pipeline is ready get() returns its fallback, and a draw
+// with neither is skipped for that frame. Every pipeline uses the one layout the registry was created with.
+namespace pipelines
+{
+    typedef uint32_t handle;
+    const handle NO_PIPELINE = UINT32_MAX;
+    const uint32_t MAX_WORKERS = 4;
+
+    enum class blendMode : uint32_t
+    {
+        none,                                       // depth only, the subpass has no colour attachments
+        alpha,                                      // one attachment, source alpha over the destination
+        oit                                         // weighted blended accumulation and revealage attachments
+    };
+
+    enum class depthMode : uint32_t
+    {
+        none,                                       // the subpass has no depth attachment
+        test,                                       // read only
+        testWrite
+    };
+
+    struct graphicsState
+    {
+        std::string vertexShader;                   // SPIR-V paths
+        std::string fragmentShader;                 // empty for depth only pipelines
+        std::vector<uint32_t> specialization;       // value of constant_id i in both stages, bools as VkBool32, floats by their bits
+        std::vector<VkVertexInputBindingDescription> vertexBindings;     // empty when the shader generates its vertices
+        std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+        depthMode depth = depthMode::testWrite;
+        blendMode blend = blendMode::alpha;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        uint32_t subpass = 0;                       // viewport and scissor are dynamic, so resizes keep every pipeline
+    };
+
+    bool operator==(const graphicsState&, const graphicsState&);
+
+    size_t hash(const graphicsState&);
+
+    struct variant
+    {
+        graphicsState state;
+        size_t hash = 0;
+        handle fallback = NO_PIPELINE;              // drawn with while this one compiles, must suit the same draws
+        VkPipeline pipeline = VK_NULL_HANDLE;       // null until compiled
+        double compileMilliseconds = 0.0;
+    };
+
+    struct compileJob
+    {
+        handle id;
+        graphicsState state;
+    };
+
+    struct compiledPipeline
+    {
+        handle id;
+        VkPipeline pipeline;
+        double milliseconds;
+        std::string error;
+    };
+
+    struct registry
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        pipecache::cache* pipelineCache = nullptr;
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+
+        std::vector<variant> variants;
+        std::unordered_map<size_t, std::vector<handle>> byHash;
+        uint32_t pendingCount = 0;                  // queued or compiling
+        uint32_t batchCount = 0;                    // requested since the registry was last idle
+        std::chrono::high_resolution_clock::time_point batchStart;
+        uint32_t requests = 0;
+        uint32_t deduplicated = 0;                  // requests answered by an existing variant
+        uint32_t compiled = 0;
+        double compileMilliseconds = 0.0;           // summed over the workers
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;                           // guards everything below
+        std::condition_variable wake;
+        std::condition_variable idle;               // signalled when the last compile in flight finishes
+        bool stopping = false;
+        uint32_t compiling = 0;
+        std::deque<compileJob> jobs;
+        std::vector<compiledPipeline> finished;
+    };
+
+    // Starts the workers, one per core up to MAX_WORKERS.
+    void init(registry&, VkDevice, pipecache::cache&, VkPipelineLayout);
+
+    // Stops the workers and destroys every pipeline, the device must be idle.
+    void destroy(registry&);
+
+    // Returns the variant for this state, queueing its compile when it is new. fallback is used until it is ready.
+    handle request(registry&, const graphicsState&, handle fallback = NO_PIPELINE);
+
+    // Takes in the pipelines finished since the last call, once a frame.
+    void collect(registry&);
+
+    // The variant's pipeline, else its fallback's, else VK_NULL_HANDLE.
+    VkPipeline get(const registry&, handle);
+
+    // Drops queued compiles, waits for those in flight and destroys every pipeline, for render pass recreation.
+    // Handles are invalid afterwards. No frame in flight may still use the pipelines.
+    void clear(registry&);
+
+    void printStats(const registry&);
+}
@@ -0,0 +1,249 @@
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "recorder.h"
+
+using namespace recorder;
+
+namespace
+{
+    VkCommandBuffer nextBuffer(pool& commandRecorder, uint32_t worker)
+    {
+        workerPools& pools = commandRecorder.pools[worker];
+        uint32_t frame = commandRecorder.frame;
+        std::vector<VkCommandBuffer>& buffers = pools.buffers[frame];
+
+        if (pools.used[frame] == buffers.size()) {
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = pools.commandPools[frame];
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            allocInfo.commandBufferCount = 1;
+
+            VkCommandBuffer commandBuffer;
+            if (vkAllocateCommandBuffers(commandRecorder.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate secondary command buffer!");
+            }
+            buffers.push_back(commandBuffer);
+        }
+        return buffers[pools.used[frame]++];
+    }
+
+    VkCommandBuffer cachedBuffer(pool& commandRecorder, uint32_t worker)
+    {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandRecorder.pools[worker].cachePools[commandRecorder.frame];
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(commandRecorder.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate cached secondary command buffer!");
+        }
+        return commandBuffer;
+    }
+
+    void recordPass(pool& commandRecorder, uint32_t worker, pass& job)
+    {
+        VkCommandBuffer commandBuffer = job.cache != nullptr ? cachedBuffer(commandRecorder, worker) : nextBuffer(commandRecorder, worker);
+
+        VkCommandBufferInheritanceInfo inheritanceInfo = {};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = job.renderPass;
+        inheritanceInfo.subpass = job.subpass;
+        inheritanceInfo.framebuffer = job.framebuffer;
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        if (job.cache == nullptr) {
+            beginInfo.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        }
+        beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin recording secondary command buffer!");
+        }
+
+        job.record(commandBuffer);
+
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record secondary command buffer!");
+        }
+        job.commandBuffer = commandBuffer;
+
+        if (job.cache != nullptr) {
+            if (job.cache->commandBuffer != VK_NULL_HANDLE) {
+                std::lock_guard<std::mutex> lock(commandRecorder.mutex);
+                commandRecorder.replaced.push_back(*job.cache);
+            }
+            *job.cache = { commandBuffer, worker, commandRecorder.frame, job.version };
+        }
+    }
+
+    void recordLoop(pool* commandRecorder, uint32_t worker)
+    {
+        for (;;) {
+            uint32_t index;
+            std::vector<pass>* passes;
+            {
+                std::unique_lock<std::mutex> lock(commandRecorder->mutex);
+                commandRecorder->wake.wait(lock, [commandRecorder]() { return commandRecorder->stopping || !commandRecorder->jobs.empty(); });
+                if (commandRecorder->stopping) {
+                    return;
+                }
+                index = commandRecorder->jobs.front();
+                commandRecorder->jobs.pop_front();
+                passes = commandRecorder->passes;
+            }
+
+            std::string error;
+            try {
+                recordPass(*commandRecorder, worker, (*passes)[index]);
+            }
+            catch (const std::exception& e) {
+                error = e.what(); //thrown again on the main thread by record()
+            }
+
+            std::lock_guard<std::mutex> lock(commandRecorder->mutex);
+            if (!error.empty() && commandRecorder->error.empty()) {
+                commandRecorder->error = error;
+            }
+            commandRecorder->remaining--;
+            if (commandRecorder->remaining == 0) {
+                commandRecorder->done.notify_all();
+            }
+        }
+    }
+}
+
+void recorder::init(pool& commandRecorder, VkDevice device, uint32_t queueFamilyIndex, uint32_t framesInFlight)
+{
+    commandRecorder.device = device;
+    commandRecorder.frame = 0;
+    commandRecorder.stopping = false;
+
+    uint32_t workerCount = std::max(1u, std::min(std::thread::hardware_concurrency(), MAX_WORKERS));
+    commandRecorder.pools.resize(workerCount);
+    for (workerPools& pools : commandRecorder.pools) {
+        pools.commandPools.resize(framesInFlight);
+        pools.buffers.resize(framesInFlight);
+        pools.used.assign(framesInFlight, 0);
+        pools.cachePools.resize(framesInFlight);
+
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = 0; //buffers are only ever reset with the whole pool, or freed when cached
+        poolInfo.queueFamilyIndex = queueFamilyIndex;
+
+        for (uint32_t frame = 0; frame < framesInFlight; frame++) {
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &pools.commandPools[frame]) != VK_SUCCESS
+                || vkCreateCommandPool(device, &poolInfo, nullptr, &pools.cachePools[frame]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create recording command pool!");
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        commandRecorder.workers.emplace_back(recordLoop, &commandRecorder, i);
+    }
+}
+
+void recorder::destroy(pool& commandRecorder)
+{
+    {
+        std::lock_guard<std::mutex> lock(commandRecorder.mutex);
+        commandRecorder.stopping = true;
+    }
+    commandRecorder.wake.notify_all();
+    for (std::thread& worker : commandRecorder.workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+    commandRecorder.workers.clear();
+
+    //destroying a pool frees its buffers
+    for (workerPools& pools : commandRecorder.pools) {
+        for (VkCommandPool commandPool : pools.commandPools) {
+            vkDestroyCommandPool(commandRecorder.device, commandPool, nullptr);
+        }
+        for (VkCommandPool commandPool : pools.cachePools) {
+            vkDestroyCommandPool(commandRecorder.device, commandPool, nullptr);
+        }
+    }
+    commandRecorder.pools.clear();
+}
+
+void recorder::beginFrame(pool& commandRecorder, uint32_t frame)
+{
+    commandRecorder.frame = frame;
+
+    //the workers are idle between record() calls, so the main thread may reset their pools
+    for (workerPools& pools : commandRecorder.pools) {
+        if (vkResetCommandPool(commandRecorder.device, pools.commandPools[frame], 0) != VK_SUCCESS) {
+            throw std::runtime_error("failed to reset recording command pool!");
+        }
+        pools.used[frame] = 0;
+    }
+    commandRecorder.frames++;
+}
+
+void recorder::record(pool& commandRecorder, std::vector<pass>& passes)
+{
+    auto recordStart = std::chrono::high_resolution_clock::now();
+
+    std::vector<uint32_t> outdated;
+    for (uint32_t i = 0; i < passes.size(); i++) {
+        cached* cache = passes[i].cache;
+        if (cache != nullptr && cache->commandBuffer != VK_NULL_HANDLE) {
+            if (cache->frame != commandRecorder.frame) {
+                throw std::runtime_error("cached pass used by another frame in flight!");
+            }
+            if (cache->version == passes[i].version) {
+                passes[i].commandBuffer = cache->commandBuffer;
+                commandRecorder.reused++;
+                continue;
+            }
+        }
+        outdated.push_back(i);
+    }
+
+    std::string error;
+    std::vector<cached> replaced;
+    if (!outdated.empty()) {
+        std::unique_lock<std::mutex> lock(commandRecorder.mutex);
+        commandRecorder.passes = &passes;
+        commandRecorder.remaining = static_cast<uint32_t>(outdated.size());
+        commandRecorder.jobs.insert(commandRecorder.jobs.end(), outdated.begin(), outdated.end());
+        commandRecorder.wake.notify_all();
+
+        commandRecorder.done.wait(lock, [&commandRecorder]() { return commandRecorder.remaining == 0; });
+        commandRecorder.passes = nullptr;
+        error.swap(commandRecorder.error);
+        replaced.swap(commandRecorder.replaced);
+    }
+
+    //the last frame to execute them was this frame in flight's previous one, which has finished
+    for (const cached& old : replaced) {
+        vkFreeCommandBuffers(commandRecorder.device, commandRecorder.pools[old.worker].cachePools[old.frame], 1, &old.commandBuffer);
+    }
+
+    if (!error.empty()) {
+        throw std::runtime_error(error);
+    }
+
+    commandRecorder.recorded += outdated.size();
+    commandRecorder.recordMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+}
+
+void recorder::printStats(const pool& commandRecorder)
+{
+    double frameMilliseconds = commandRecorder.frames > 0 ? commandRecorder.recordMilliseconds / commandRecorder.frames : 0.0;
+    std::cout << "recorder: " << commandRecorder.recorded << " passes recorded and " << commandRecorder.reused << " reused over " << commandRecorder.frames
+        << " frames on " << commandRecorder.pools.size() << " workers, " << std::fixed << std::setprecision(3) << frameMilliseconds << " ms of recording per frame" << std::endl;
+}
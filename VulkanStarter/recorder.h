@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+// Parallel command recording. Each pass of a frame is recorded into a secondary command buffer by a small pool of
+// worker threads, and the primary buffer only begins the render passes and executes the secondaries. Command pools
+// are externally synchronised, so every worker allocates from pools of its own, one per frame in flight, which are
+// reset as a whole once the timeline has passed that slot's last frame instead of freeing buffers one by one.
+// A secondary inherits no state from the primary, the record function must bind everything it draws with, dynamic
+// state included.
+// Passes whose commands do not change between frames can be given a cache and a version. They are recorded once into
+// a separate pool and executed again every frame until the caller bumps the version, only then is the pass recorded
+// again and the old buffer freed.
+namespace recorder
+{
+    const uint32_t MAX_WORKERS = 4;
+
+    // A reusable secondary. It may only be used by one frame in flight, so that the wait for the slot's last frame covers its
+    // last execution when it is recorded again.
+    struct cached
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint32_t worker = 0;                        // whose pool it was allocated from
+        uint32_t frame = 0;
+        uint64_t version = 0;
+    };
+
+    struct pass
+    {
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        uint32_t subpass = 0;
+        VkFramebuffer framebuffer = VK_NULL_HANDLE;    // optional, lets the driver specialise the secondary
+        std::function<void(VkCommandBuffer)> record;
+        cached* cache = nullptr;                        // reused while it holds a buffer of this version
+        uint64_t version = 0;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE; // filled in by record()
+    };
+
+    struct workerPools
+    {
+        std::vector<VkCommandPool> commandPools;                // one per frame in flight
+        std::vector<std::vector<VkCommandBuffer>> buffers;      // allocated from each pool, reused once it is reset
+        std::vector<uint32_t> used;                             // buffers of each pool handed out since its reset
+        std::vector<VkCommandPool> cachePools;                  // one per frame in flight, never reset, holds the cached passes
+    };
+
+    struct pool
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        uint32_t frame = 0;                         // frame in flight being recorded
+        std::vector<workerPools> pools;             // indexed by worker
+        uint64_t frames = 0;
+        uint64_t recorded = 0;                      // passes
+        uint64_t reused = 0;                        // passes executed from their cache
+        double recordMilliseconds = 0.0;            // wall time of record(), workers in parallel
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;                           // guards everything below
+        std::condition_variable wake;
+        std::condition_variable done;               // signalled when the last pass of a record() call is finished
+        bool stopping = false;
+        std::vector<pass>* passes = nullptr;
+        std::deque<uint32_t> jobs;                  // passes not started yet
+        uint32_t remaining = 0;                     // passes not finished yet
+        std::vector<cached> replaced;               // outdated cached buffers, freed once the workers are idle
+        std::string error;
+    };
+
+    // Starts the workers, one per core up to MAX_WORKERS, each with a command pool per frame in flight.
+    void init(pool&, VkDevice, uint32_t queueFamilyIndex, uint32_t framesInFlight);
+
+    // Stops the workers and destroys their command pools, the device must be idle.
+    void destroy(pool&);
+
+    // Resets the command pools of a frame in flight, call once its last frame has completed.
+    void beginFrame(pool&, uint32_t frame);
+
+    // Records every pass into a secondary command buffer on the workers and returns once all of them are done, cached
+    // passes of the current version are not recorded. Errors thrown by a record function are thrown again here.
+    void record(pool&, std::vector<pass>&);
+
+    void printStats(const pool&);
+}
@@ -0,0 +1,689 @@
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "rendergraph.h"
+
+using namespace rendergraph;
+
+namespace
+{
+    struct accessInfo
+    {
+        VkImageLayout layout;
+        VkPipelineStageFlags stages;
+        VkAccessFlags readMask;
+        VkAccessFlags writeMask;
+        bool attachment;                            // framebuffer local, reads and writes only its own pixel
+    };
+
+    accessInfo describe(usage kind)
+    {
+        switch (kind) {
+        case usage::colorWrite:
+            return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                VK_ACCESS_COLOR_ATTACHMENT_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true };
+        case usage::depthWrite:
+            return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true };
+        case usage::depthRead:
+            return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+                VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, 0, true };
+        case usage::inputRead:
+            return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT, 0, true };
+        default:
+            return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0, false };
+        }
+    }
+
+    VkImageUsageFlags usageFlag(usage kind)
+    {
+        switch (kind) {
+        case usage::colorWrite:
+            return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        case usage::depthWrite:
+        case usage::depthRead:
+            return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        case usage::inputRead:
+            return VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        default:
+            return VK_IMAGE_USAGE_SAMPLED_BIT;
+        }
+    }
+
+    const access* findAccess(const pass& node, resource id)
+    {
+        for (const access& a : node.accesses) {
+            if (a.image == id) {
+                return &a;
+            }
+        }
+        return nullptr;
+    }
+
+    // images of one slot are one piece of memory as far as hazards go, the imported image is a slot of its own
+    uint32_t memoryOf(const graph& frameGraph, resource id)
+    {
+        const image& img = frameGraph.images[id];
+        return img.slot != NO_SLOT ? img.slot : frameGraph.slotCount + id;
+    }
+
+    // the access to the memory at this position in graph::order, nullptr when the pass does not touch it
+    const access* accessAt(const graph& frameGraph, uint32_t position, uint32_t memory)
+    {
+        for (const access& a : frameGraph.passes[frameGraph.order[position]].accesses) {
+            if (memoryOf(frameGraph, a.image) == memory) {
+                return &a;
+            }
+        }
+        return nullptr;
+    }
+
+    uint32_t renderPassAt(const graph& frameGraph, uint32_t position)
+    {
+        return frameGraph.passes[frameGraph.order[position]].renderPass;
+    }
+
+    // a pass joins the render pass unless it samples one of its attachments, or draws to an image sampled in it
+    bool canMerge(const graph& frameGraph, const mergedPass& merged, const pass& node)
+    {
+        for (const access& a : node.accesses) {
+            bool attachment = std::find(merged.attachments.begin(), merged.attachments.end(), a.image) != merged.attachments.end();
+            if (a.kind == usage::sampled && attachment) {
+                return false;
+            }
+            if (a.kind != usage::sampled) {
+                for (uint32_t index : merged.passes) {
+                    const access* earlier = findAccess(frameGraph.passes[index], a.image);
+                    if (earlier != nullptr && earlier->kind == usage::sampled) {
+                        return false;
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    void addDependency(std::vector<VkSubpassDependency>& dependencies, std::vector<bool>& byRegion, uint32_t src, uint32_t dst,
+        const accessInfo& before, const accessInfo& after, bool local)
+    {
+        size_t index = 0;
+        while (index < dependencies.size() && (dependencies[index].srcSubpass != src || dependencies[index].dstSubpass != dst)) {
+            index++;
+        }
+        if (index == dependencies.size()) {
+            VkSubpassDependency dependency = {};
+            dependency.srcSubpass = src;
+            dependency.dstSubpass = dst;
+            dependencies.push_back(dependency);
+            byRegion.push_back(true);
+        }
+
+        //only writes have to be made available, reads before a write just have to finish
+        VkSubpassDependency& dependency = dependencies[index];
+        dependency.srcStageMask |= before.stages;
+        dependency.srcAccessMask |= before.writeMask;
+        dependency.dstStageMask |= after.stages;
+        dependency.dstAccessMask |= after.readMask | after.writeMask;
+        byRegion[index] = byRegion[index] && local && src != VK_SUBPASS_EXTERNAL;
+        dependency.dependencyFlags = byRegion[index] ? VK_DEPENDENCY_BY_REGION_BIT : 0;
+    }
+
+    void createRenderPass(graph& frameGraph, uint32_t index)
+    {
+        mergedPass& merged = frameGraph.renderPasses[index];
+        uint32_t subpassCount = static_cast<uint32_t>(merged.passes.size());
+        uint32_t firstPosition = 0;
+        while (renderPassAt(frameGraph, firstPosition) != index) {
+            firstPosition++;
+        }
+
+        std::vector<VkAttachmentDescription> descriptions(merged.attachments.size());
+        std::vector<std::vector<uint32_t>> preserved(subpassCount);
+        for (uint32_t k = 0; k < merged.attachments.size(); k++) {
+            resource id = merged.attachments[k];
+            const image& img = frameGraph.images[id];
+            uint32_t memory = memoryOf(frameGraph, id);
+
+            uint32_t firstSubpass = subpassCount, lastSubpass = 0;
+            for (uint32_t s = 0; s < subpassCount; s++) {
+                if (findAccess(frameGraph.passes[merged.passes[s]], id) != nullptr) {
+                    firstSubpass = std::min(firstSubpass, s);
+                    lastSubpass = s;
+                }
+            }
+            uint32_t firstUse = firstPosition + firstSubpass;
+            uint32_t lastUse = firstPosition + lastSubpass;
+
+            //the layouts hand over to the accesses before and after this render pass within the frame
+            const access* previous = nullptr;
+            for (uint32_t position = firstUse; position > 0 && previous == nullptr; position--) {
+                previous = accessAt(frameGraph, position - 1, memory);
+            }
+            if (previous != nullptr && previous->image != id) {
+                previous = nullptr; //another image of the slot, this one's contents are gone
+            }
+            const access* next = nullptr;
+            for (uint32_t position = lastUse + 1; position < frameGraph.order.size() && next == nullptr; position++) {
+                next = accessAt(frameGraph, position, memory);
+            }
+            if (next != nullptr && next->image != id) {
+                next = nullptr;
+            }
+
+            VkAttachmentDescription& description = descriptions[k];
+            description.format = img.format;
+            description.samples = VK_SAMPLE_COUNT_1_BIT;
+            description.loadOp = previous != nullptr ? VK_ATTACHMENT_LOAD_OP_LOAD : (img.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE);
+            description.storeOp = img.imported || next != nullptr ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            description.initialLayout = previous != nullptr ? describe(previous->kind).layout : VK_IMAGE_LAYOUT_UNDEFINED;
+            if (next != nullptr) {
+                description.finalLayout = describe(next->kind).layout;
+            }
+            else if (img.imported) {
+                description.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            }
+            else {
+                description.finalLayout = describe(findAccess(frameGraph.passes[merged.passes[lastSubpass]], id)->kind).layout;
+            }
+
+            for (uint32_t s = firstSubpass + 1; s < lastSubpass; s++) {
+                if (findAccess(frameGraph.passes[merged.passes[s]], id) == nullptr) {
+                    preserved[s].push_back(k); //kept intact by the subpasses in between
+                }
+            }
+        }
+
+        auto attachmentIndex = [&merged](resource id) {
+            return static_cast<uint32_t>(std::find(merged.attachments.begin(), merged.attachments.end(), id) - merged.attachments.begin());
+        };
+
+        std::vector<std::vector<VkAttachmentReference>> colorRefs(subpassCount);
+        std::vector<std::vector<VkAttachmentReference>> inputRefs(subpassCount);
+        std::vector<VkAttachmentReference> depthRefs(subpassCount);
+        std::vector<VkSubpassDescription> subpasses(subpassCount);
+        std::vector<VkSubpassDependency> dependencies;
+        std::vector<bool> byRegion;
+
+        for (uint32_t s = 0; s < subpassCount; s++) {
+            const pass& node = frameGraph.passes[merged.passes[s]];
+            VkSubpassDescription& description = subpasses[s];
+            description.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+            for (const access& a : node.accesses) {
+                accessInfo info = describe(a.kind);
+                VkAttachmentReference reference = { info.attachment ? attachmentIndex(a.image) : 0, info.layout };
+                if (a.kind == usage::colorWrite) {
+                    colorRefs[s].push_back(reference);
+                }
+                else if (a.kind == usage::inputRead) {
+                    inputRefs[s].push_back(reference);
+                }
+                else if (a.kind == usage::depthWrite || a.kind == usage::depthRead) {
+                    depthRefs[s] = reference;
+                    description.pDepthStencilAttachment = &depthRefs[s];
+                }
+
+                //hazards are tracked on memory rather than images, so aliased images are ordered like one image
+                uint32_t memory = memoryOf(frameGraph, a.image);
+                bool inRenderPass = false;
+                for (uint32_t t = s; t > 0; t--) {
+                    const access* before = accessAt(frameGraph, firstPosition + t - 1, memory);
+                    if (before == nullptr) {
+                        continue;
+                    }
+                    inRenderPass = true;
+
+                    accessInfo beforeInfo = describe(before->kind);
+                    if (beforeInfo.writeMask != 0 || info.writeMask != 0 || beforeInfo.layout != info.layout) {
+                        bool local = before->image == a.image && beforeInfo.attachment && info.attachment;
+                        addDependency(dependencies, byRegion, t - 1, s, beforeInfo, info, local);
+                    }
+                    if (beforeInfo.writeMask != 0) {
+                        break; //earlier accesses are ordered before that write already
+                    }
+                }
+                if (inRenderPass) {
+                    continue;
+                }
+
+                //first use in this render pass, wait for the last access before it, the previous frame's when it is
+                //the first of this frame. The imported image waits for the presentation engine through the acquire
+                //semaphore, which the submit waits for at the colour output stage
+                uint32_t position = firstPosition + s;
+                const access* before = nullptr;
+                for (uint32_t p = position; p > 0 && before == nullptr; p--) {
+                    before = accessAt(frameGraph, p - 1, memory);
+                }
+                if (before == nullptr && frameGraph.images[a.image].imported) {
+                    accessInfo presented = { VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, false };
+                    addDependency(dependencies, byRegion, VK_SUBPASS_EXTERNAL, s, presented, info, false);
+                    continue;
+                }
+                for (uint32_t p = static_cast<uint32_t>(frameGraph.order.size()); p > position && before == nullptr; p--) {
+                    before = accessAt(frameGraph, p - 1, memory);
+                }
+                if (before == nullptr) {
+                    before = &a; //only this pass touches it, the previous frame's run of it
+                }
+                addDependency(dependencies, byRegion, VK_SUBPASS_EXTERNAL, s, describe(before->kind), info, false);
+            }
+
+            description.colorAttachmentCount = static_cast<uint32_t>(colorRefs[s].size());
+            description.pColorAttachments = colorRefs[s].data();
+            description.inputAttachmentCount = static_cast<uint32_t>(inputRefs[s].size());
+            description.pInputAttachments = inputRefs[s].data();
+            description.preserveAttachmentCount = static_cast<uint32_t>(preserved[s].size());
+            description.pPreserveAttachments = preserved[s].data();
+        }
+
+        VkRenderPassCreateInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+        renderPassInfo.attachmentCount = static_cast<uint32_t>(descriptions.size());
+        renderPassInfo.pAttachments = descriptions.data();
+        renderPassInfo.subpassCount = subpassCount;
+        renderPassInfo.pSubpasses = subpasses.data();
+        renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+        renderPassInfo.pDependencies = dependencies.data();
+
+        if (vkCreateRenderPass(frameGraph.device, &renderPassInfo, nullptr, &merged.handle) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph render pass!");
+        }
+        frameGraph.dependencyCount += static_cast<uint32_t>(dependencies.size());
+    }
+}
+
+void rendergraph::init(graph& frameGraph, VkDevice device, memalloc::allocator& allocator)
+{
+    frameGraph.device = device;
+    frameGraph.allocator = &allocator;
+}
+
+void rendergraph::destroy(graph& frameGraph)
+{
+    for (mergedPass& merged : frameGraph.renderPasses) {
+        vkDestroyRenderPass(frameGraph.device, merged.handle, nullptr);
+    }
+    frameGraph.renderPasses.clear();
+}
+
+resource rendergraph::addImage(graph& frameGraph, const std::string& name, VkFormat format, VkImageAspectFlags aspect, const VkClearValue* clear)
+{
+    image img;
+    img.name = name;
+    img.format = format;
+    img.aspect = aspect;
+    img.clear = clear != nullptr;
+    if (clear != nullptr) {
+        img.clearValue = *clear;
+    }
+    frameGraph.images.push_back(img);
+    return static_cast<resource>(frameGraph.images.size() - 1);
+}
+
+resource rendergraph::importImage(graph& frameGraph, const std::string& name, VkFormat format, const VkClearValue* clear)
+{
+    for (const image& img : frameGraph.images) {
+        if (img.imported) {
+            throw std::runtime_error("render graph already has an imported image!");
+        }
+    }
+
+    resource id = addImage(frameGraph, name, format, VK_IMAGE_ASPECT_COLOR_BIT, clear);
+    frameGraph.images[id].imported = true;
+    return id;
+}
+
+void rendergraph::setFormat(graph& frameGraph, resource id, VkFormat format)
+{
+    frameGraph.images[id].format = format;
+}
+
+uint32_t rendergraph::addPass(graph& frameGraph, const std::string& name, const std::vector<access>& accesses, bool enabled)
+{
+    pass node;
+    node.name = name;
+    node.accesses = accesses;
+    node.enabled = enabled;
+
+    for (size_t i = 0; i < accesses.size(); i++) {
+        for (size_t j = i + 1; j < accesses.size(); j++) {
+            if (accesses[i].image == accesses[j].image) {
+                throw std::runtime_error("render graph pass " + name + " accesses an image twice!");
+            }
+        }
+    }
+
+    frameGraph.passes.push_back(node);
+    return static_cast<uint32_t>(frameGraph.passes.size() - 1);
+}
+
+void rendergraph::compile(graph& frameGraph)
+{
+    destroy(frameGraph);
+    frameGraph.order.clear();
+    frameGraph.dependencyCount = 0;
+
+    //walks backwards so every pass knows whether a kept pass after it reads what it writes
+    std::vector<bool> consumed(frameGraph.images.size(), false);
+    for (size_t i = frameGraph.passes.size(); i > 0; i--) {
+        pass& node = frameGraph.passes[i - 1];
+        bool observable = false;
+        for (const access& a : node.accesses) {
+            if (describe(a.kind).writeMask != 0 && (frameGraph.images[a.image].imported || consumed[a.image])) {
+                observable = true;
+            }
+        }
+        node.culled = !node.enabled || !observable;
+        if (!node.culled) {
+            for (const access& a : node.accesses) {
+                consumed[a.image] = true;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < frameGraph.passes.size(); i++) {
+        if (!frameGraph.passes[i].culled) {
+            frameGraph.order.push_back(i);
+        }
+    }
+
+    //lifetimes and usage of every image
+    for (image& img : frameGraph.images) {
+        img.used = false;
+        img.usageFlags = 0;
+        img.slot = NO_SLOT;
+    }
+    for (uint32_t position = 0; position < frameGraph.order.size(); position++) {
+        for (const access& a : frameGraph.passes[frameGraph.order[position]].accesses) {
+            image& img = frameGraph.images[a.image];
+            if (!img.used) {
+                if (describe(a.kind).writeMask == 0) {
+                    throw std::runtime_error("render graph image " + img.name + " is read before any pass writes it!");
+                }
+                img.used = true;
+                img.firstPass = position;
+            }
+            img.lastPass = position;
+            img.usageFlags |= usageFlag(a.kind);
+        }
+    }
+
+    //consecutive passes become subpasses of one render pass while nothing samples within it
+    for (uint32_t position = 0; position < frameGraph.order.size(); position++) {
+        pass& node = frameGraph.passes[frameGraph.order[position]];
+        if (frameGraph.renderPasses.empty() || !canMerge(frameGraph, frameGraph.renderPasses.back(), node)) {
+            frameGraph.renderPasses.emplace_back();
+        }
+
+        mergedPass& merged = frameGraph.renderPasses.back();
+        node.renderPass = static_cast<uint32_t>(frameGraph.renderPasses.size() - 1);
+        node.subpass = static_cast<uint32_t>(merged.passes.size());
+        merged.passes.push_back(frameGraph.order[position]);
+
+        for (const access& a : node.accesses) {
+            const image& img = frameGraph.images[a.image];
+            if (!describe(a.kind).attachment || std::find(merged.attachments.begin(), merged.attachments.end(), a.image) != merged.attachments.end()) {
+                continue;
+            }
+            merged.attachments.push_back(a.image);
+            merged.clearValues.push_back(img.clearValue);
+            merged.perImage = merged.perImage || img.imported;
+        }
+    }
+
+    //an image may take over the memory of images that were last used in an earlier render pass. Within one render
+    //pass the layout transition of its first use is only ordered after external dependencies, so it stays apart
+    std::vector<resource> byFirstUse;
+    for (resource id = 0; id < frameGraph.images.size(); id++) {
+        if (frameGraph.images[id].used && !frameGraph.images[id].imported) {
+            byFirstUse.push_back(id);
+        }
+    }
+    std::stable_sort(byFirstUse.begin(), byFirstUse.end(), [&frameGraph](resource a, resource b) {
+        return frameGraph.images[a].firstPass < frameGraph.images[b].firstPass;
+    });
+
+    std::vector<uint32_t> slotLastPass;
+    for (resource id : byFirstUse) {
+        image& img = frameGraph.images[id];
+        for (uint32_t slot = 0; slot < slotLastPass.size() && img.slot == NO_SLOT; slot++) {
+            if (renderPassAt(frameGraph, slotLastPass[slot]) < renderPassAt(frameGraph, img.firstPass)) {
+                img.slot = slot;
+                slotLastPass[slot] = img.lastPass;
+            }
+        }
+        if (img.slot == NO_SLOT) {
+            img.slot = static_cast<uint32_t>(slotLastPass.size());
+            slotLastPass.push_back(img.lastPass);
+        }
+
+        //never stored, so tilers can keep it in on-chip memory
+        if ((img.usageFlags & VK_IMAGE_USAGE_SAMPLED_BIT) == 0 && renderPassAt(frameGraph, img.firstPass) == renderPassAt(frameGraph, img.lastPass)) {
+            img.usageFlags |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+    }
+    frameGraph.slotCount = static_cast<uint32_t>(slotLastPass.size());
+
+    for (uint32_t i = 0; i < frameGraph.renderPasses.size(); i++) {
+        createRenderPass(frameGraph, i);
+    }
+}
+
+void rendergraph::createAttachments(graph& frameGraph, VkExtent2D extent, const std::vector<VkImageView>& importedViews)
+{
+    attachments& current = frameGraph.current;
+    current.extent = extent;
+    current.images.assign(frameGraph.images.size(), VK_NULL_HANDLE);
+    current.views.assign(frameGraph.images.size(), VK_NULL_HANDLE);
+    frameGraph.attachmentCount = 0;
+    frameGraph.allocationCount = 0;
+    frameGraph.separateBytes = 0;
+    frameGraph.allocatedBytes = 0;
+
+    std::vector<VkMemoryRequirements> requirements(frameGraph.images.size());
+    std::vector<std::vector<resource>> slots(frameGraph.slotCount);
+    for (resource id = 0; id < frameGraph.images.size(); id++) {
+        const image& img = frameGraph.images[id];
+        if (!img.used || img.imported) {
+            continue;
+        }
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = extent.width;
+        imageInfo.extent.height = extent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = img.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = img.usageFlags;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(frameGraph.device, &imageInfo, nullptr, &current.images[id]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image!");
+        }
+        vkGetImageMemoryRequirements(frameGraph.device, current.images[id], &requirements[id]);
+
+        slots[img.slot].push_back(id);
+        frameGraph.separateBytes += requirements[id].size;
+        frameGraph.attachmentCount++;
+    }
+
+    //each slot is one allocation big enough for its largest image, an image that cannot live in the memory types
+    //the others can starts another allocation
+    for (std::vector<resource>& pending : slots) {
+        while (!pending.empty()) {
+            VkMemoryRequirements combined = requirements[pending[0]];
+            std::vector<resource> members = { pending[0] };
+            std::vector<resource> rest;
+            for (size_t i = 1; i < pending.size(); i++) {
+                const VkMemoryRequirements& member = requirements[pending[i]];
+                if ((combined.memoryTypeBits & member.memoryTypeBits) == 0) {
+                    rest.push_back(pending[i]);
+                    continue;
+                }
+                combined.memoryTypeBits &= member.memoryTypeBits;
+                combined.size = std::max(combined.size, member.size);
+                combined.alignment = std::max(combined.alignment, member.alignment);
+                members.push_back(pending[i]);
+            }
+
+            memalloc::allocation memory = memalloc::allocate(*frameGraph.allocator, combined, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true);
+            for (resource id : members) {
+                if (vkBindImageMemory(frameGraph.device, current.images[id], memory.memory, memory.offset) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to bind render graph image memory!");
+                }
+            }
+            current.memory.push_back(memory);
+            frameGraph.allocationCount++;
+            frameGraph.allocatedBytes += combined.size;
+            pending.swap(rest);
+        }
+    }
+
+    for (resource id = 0; id < frameGraph.images.size(); id++) {
+        if (current.images[id] == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = current.images[id];
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = frameGraph.images[id].format;
+        viewInfo.subresourceRange.aspectMask = frameGraph.images[id].aspect;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = 1;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(frameGraph.device, &viewInfo, nullptr, &current.views[id]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render graph image view!");
+        }
+    }
+
+    current.framebuffers.resize(frameGraph.renderPasses.size());
+    for (size_t i = 0; i < frameGraph.renderPasses.size(); i++) {
+        const mergedPass& merged = frameGraph.renderPasses[i];
+        size_t framebufferCount = merged.perImage ? importedViews.size() : 1;
+        current.framebuffers[i].resize(framebufferCount);
+
+        for (size_t f = 0; f < framebufferCount; f++) {
+            std::vector<VkImageView> views;
+            for (resource id : merged.attachments) {
+                views.push_back(frameGraph.images[id].imported ? importedViews[f] : current.views[id]);
+            }
+
+            VkFramebufferCreateInfo framebufferInfo = {};
+            framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+            framebufferInfo.renderPass = merged.handle;
+            framebufferInfo.attachmentCount = static_cast<uint32_t>(views.size());
+            framebufferInfo.pAttachments = views.data();
+            framebufferInfo.width = extent.width;
+            framebufferInfo.height = extent.height;
+            framebufferInfo.layers = 1;
+
+            if (vkCreateFramebuffer(frameGraph.device, &framebufferInfo, nullptr, &current.framebuffers[i][f]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create render graph framebuffer!");
+            }
+        }
+    }
+}
+
+attachments rendergraph::detachAttachments(graph& frameGraph)
+{
+    attachments detached = std::move(frameGraph.current);
+    frameGraph.current = attachments();
+    return detached;
+}
+
+void rendergraph::destroyAttachments(graph& frameGraph, attachments& retired)
+{
+    for (std::vector<VkFramebuffer>& framebuffers : retired.framebuffers) {
+        for (VkFramebuffer framebuffer : framebuffers) {
+            vkDestroyFramebuffer(frameGraph.device, framebuffer, nullptr);
+        }
+    }
+    for (size_t i = 0; i < retired.images.size(); i++) {
+        if (retired.images[i] != VK_NULL_HANDLE) {
+            vkDestroyImageView(frameGraph.device, retired.views[i], nullptr);
+            vkDestroyImage(frameGraph.device, retired.images[i], nullptr);
+        }
+    }
+    for (memalloc::allocation& memory : retired.memory) {
+        memalloc::free(*frameGraph.allocator, memory);
+    }
+    retired = attachments();
+}
+
+bool rendergraph::culled(const graph& frameGraph, uint32_t node)
+{
+    return frameGraph.passes[node].culled;
+}
+
+VkRenderPass rendergraph::renderPass(const graph& frameGraph, uint32_t node)
+{
+    const pass& p = frameGraph.passes[node];
+    return p.culled ? VK_NULL_HANDLE : frameGraph.renderPasses[p.renderPass].handle;
+}
+
+uint32_t rendergraph::subpass(const graph& frameGraph, uint32_t node)
+{
+    return frameGraph.passes[node].subpass;
+}
+
+VkFramebuffer rendergraph::framebuffer(const graph& frameGraph, uint32_t node, uint32_t imageIndex)
+{
+    const pass& p = frameGraph.passes[node];
+    if (p.culled) {
+        return VK_NULL_HANDLE;
+    }
+    const std::vector<VkFramebuffer>& framebuffers = frameGraph.current.framebuffers[p.renderPass];
+    return framebuffers[frameGraph.renderPasses[p.renderPass].perImage ? imageIndex : 0];
+}
+
+VkImageView rendergraph::view(const graph& frameGraph, resource id)
+{
+    return frameGraph.current.views[id];
+}
+
+void rendergraph::record(const graph& frameGraph, VkCommandBuffer commandBuffer, uint32_t imageIndex, const std::function<void(uint32_t pass)>& executePass)
+{
+    for (size_t i = 0; i < frameGraph.renderPasses.size(); i++) {
+        const mergedPass& merged = frameGraph.renderPasses[i];
+
+        VkRenderPassBeginInfo renderPassInfo = {};
+        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        renderPassInfo.renderPass = merged.handle;
+        renderPassInfo.framebuffer = frameGraph.current.framebuffers[i][merged.perImage ? imageIndex : 0];
+        renderPassInfo.renderArea.offset = { 0, 0 };
+        renderPassInfo.renderArea.extent = frameGraph.current.extent;
+        renderPassInfo.clearValueCount = static_cast<uint32_t>(merged.clearValues.size());
+        renderPassInfo.pClearValues = merged.clearValues.data();
+
+        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        for (size_t s = 0; s < merged.passes.size(); s++) {
+            if (s > 0) {
+                vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+            }
+            executePass(merged.passes[s]);
+        }
+        vkCmdEndRenderPass(commandBuffer);
+    }
+}
+
+void rendergraph::printStats(const graph& frameGraph)
+{
+    std::cout << "render graph: " << frameGraph.passes.size() << " passes, " << (frameGraph.passes.size() - frameGraph.order.size()) << " culled, in "
+        << frameGraph.renderPasses.size() << " render passes with " << frameGraph.dependencyCount << " dependencies" << std::endl;
+    std::cout << "render graph: " << frameGraph.attachmentCount << " attachments in " << frameGraph.allocationCount << " allocations, "
+        << frameGraph.allocatedBytes / 1024 << " KB instead of " << frameGraph.separateBytes / 1024 << " KB, "
+        << (frameGraph.separateBytes - frameGraph.allocatedBytes) / 1024 << " KB saved by aliasing" << std::endl;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+#include "memalloc.h"
+
+// Frame graph of the raster passes. Passes declare the images they read and write and the graph derives the rest:
+// passes that are disabled or whose results nothing reads are culled, consecutive passes are merged into subpasses
+// of one render pass unless one samples what another draws, and the load and store ops, layouts, preserved
+// attachments and subpass dependencies follow from the order of the accesses. Dependencies wrap around to the
+// previous frame, so a pass that overwrites what the last frame's passes read waits for them too. Images whose
+// lifetimes do not overlap share memory, the render passes between them order the reuse. Every image is the size of
+// the swap chain, and the one imported image is the swap chain image itself, presented after the last pass.
+// Compute work stays outside the graph and is recorded around it.
+namespace rendergraph
+{
+    typedef uint32_t resource;
+    const uint32_t NO_SLOT = UINT32_MAX;
+
+    enum class usage : uint32_t
+    {
+        colorWrite,                                 // colour attachment, blending reads it too
+        depthWrite,                                 // depth attachment, tested and written
+        depthRead,                                  // depth attachment, tested only
+        inputRead,                                  // input attachment, the same pixel of an earlier subpass
+        sampled                                     // any texel through a sampler in the fragment stage
+    };
+
+    struct access
+    {
+        resource image;
+        usage kind;
+    };
+
+    struct image
+    {
+        std::string name;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkImageAspectFlags aspect = 0;
+        bool imported = false;
+        bool clear = false;                         // cleared by its first pass, else its first contents are undefined
+        VkClearValue clearValue = {};
+
+        // derived by compile()
+        bool used = false;
+        VkImageUsageFlags usageFlags = 0;
+        uint32_t firstPass = 0;                     // positions in graph::order
+        uint32_t lastPass = 0;
+        uint32_t slot = NO_SLOT;                    // images of a slot share memory
+    };
+
+    struct pass
+    {
+        std::string name;
+        std::vector<access> accesses;               // colour and input attachments are bound in this order
+        bool enabled = true;
+
+        // derived by compile()
+        bool culled = false;
+        uint32_t renderPass = 0;                    // index into graph::renderPasses
+        uint32_t subpass = 0;
+    };
+
+    struct mergedPass
+    {
+        VkRenderPass handle = VK_NULL_HANDLE;
+        std::vector<uint32_t> passes;               // one subpass each, in order
+        std::vector<resource> attachments;          // attachment index to image
+        std::vector<VkClearValue> clearValues;      // by attachment index
+        bool perImage = false;                      // draws to the imported image, one framebuffer per swap chain image
+    };
+
+    // The extent dependent objects, replaced together when the swap chain is.
+    struct attachments
+    {
+        VkExtent2D extent = {};
+        std::vector<VkImage> images;                // by resource, VK_NULL_HANDLE for the imported and unused ones
+        std::vector<VkImageView> views;             // the imported image's view is not owned
+        std::vector<memalloc::allocation> memory;   // one per slot, unless the memory types of its images differ
+        std::vector<std::vector<VkFramebuffer>> framebuffers;   // by merged pass
+    };
+
+    struct graph
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        memalloc::allocator* allocator = nullptr;
+
+        std::vector<image> images;
+        std::vector<pass> passes;                   // in submission order
+
+        // derived by compile()
+        std::vector<uint32_t> order;                // passes that were not culled
+        std::vector<mergedPass> renderPasses;
+        uint32_t slotCount = 0;
+        uint32_t dependencyCount = 0;
+
+        attachments current;
+        uint32_t attachmentCount = 0;               // of the current attachments
+        uint32_t allocationCount = 0;
+        VkDeviceSize separateBytes = 0;             // had every image its own memory
+        VkDeviceSize allocatedBytes = 0;
+    };
+
+    void init(graph&, VkDevice, memalloc::allocator&);
+
+    // Destroys the render passes, the attachments must have been destroyed.
+    void destroy(graph&);
+
+    // A transient image, created by createAttachments(). clear is the value its first pass clears it to.
+    resource addImage(graph&, const std::string& name, VkFormat, VkImageAspectFlags, const VkClearValue* clear);
+
+    // The swap chain image, its views are passed to createAttachments(). Only one image can be imported.
+    resource importImage(graph&, const std::string& name, VkFormat, const VkClearValue* clear);
+
+    // For a new swap chain format, compile() again afterwards.
+    void setFormat(graph&, resource, VkFormat);
+
+    uint32_t addPass(graph&, const std::string& name, const std::vector<access>&, bool enabled = true);
+
+    // Culls, merges and creates the render passes, replacing those of an earlier compile. Pipelines and framebuffers
+    // built against the old ones must be replaced too.
+    void compile(graph&);
+
+    // Creates the images, their memory and the framebuffers for this extent.
+    void createAttachments(graph&, VkExtent2D, const std::vector<VkImageView>& importedViews);
+
+    // Hands the current attachments over, for destroying once no frame in flight uses them.
+    attachments detachAttachments(graph&);
+
+    void destroyAttachments(graph&, attachments&);
+
+    bool culled(const graph&, uint32_t pass);
+    VkRenderPass renderPass(const graph&, uint32_t pass);
+    uint32_t subpass(const graph&, uint32_t pass);
+    VkFramebuffer framebuffer(const graph&, uint32_t pass, uint32_t imageIndex);
+    VkImageView view(const graph&, resource);
+
+    // Begins every render pass with secondary command buffer contents and calls executePass for each of its subpasses.
+    void record(const graph&, VkCommandBuffer, uint32_t imageIndex, const std::function<void(uint32_t pass)>& executePass);
+
+    void printStats(const graph&);
+}
@@ -6,4 +6,10 @@ C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe fin.vert -o finvert.spv
 C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe fin.frag -o finfrag.spv
 C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe shadow.vert -o shadowvert.spv
 C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe shadow.frag -o shadowfrag.spv
+C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe oit.vert -o oitvert.spv
+C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe oit.frag -o oitfrag.spv
+C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe furdynamics.comp -o furdynamicscomp.spv
+C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe grass.vert -o grassvert.spv
+C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe grass.frag -o grassfrag.spv
+C:/VulkanSDK/1.2.131.1/Bin32/glslc.exe grasscull.comp -o grasscullcomp.spv
 pause
\ No newline at end of file
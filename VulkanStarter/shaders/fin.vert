@@ -1,27 +1,12 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform UniformBufferObject {
+layout(set = 1, binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
-	float renderTex;
 } ubo;
 
-layout(binding = 1) uniform LightingConstants {
-    vec3 lightPosition; 
-	vec3 lightAmbient; 
-	vec3 lightDiffuse;
-	vec3 lightSpecular;
-	float lightSpecularExponent;
-} lighting;
-
-layout(binding = 3) uniform ShadowBufferObject {
-    mat4 model;
-    mat4 view;
-    mat4 proj;
-} shadow;
-
 layout(push_constant) uniform PushConstants
 {
     float currentLayer;
@@ -32,36 +17,10 @@ layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 layout(location = 3) in vec3 inNormal;
 
-layout(location = 0) out vec3 fragColor;
-layout(location = 1) out vec2 fragTexCoord;
-layout(location = 2) out vec3 fragLightVector;
-layout(location = 3) out vec3 fragEyeVector;
-layout(location = 4) out vec3 fragSpecularLighting;
-layout(location = 5) out vec3 fragDiffuseLighting;
-layout(location = 6) out vec3 fragAmbientLighting;
-layout(location = 7) out float fragSpecularCoefficient;
-layout(location = 8) out vec3 fragNormal;
-layout(location = 9) out vec3 fragPos;
-layout(location = 10) out float fragRenderTex;
-layout(location = 11) out float currLayer;
+layout(location = 0) out vec2 fragTexCoord; //the fins are a flat colour, only their coverage is sampled
 
 void main() {
-    fragPos = inPosition;
-	fragNormal = inNormal;
-	fragColor = inColor;
 	fragTexCoord = inTexCoord;
 
-	fragEyeVector = vec3(30.0f, 10.0f, 30.0f);
-
-	fragLightVector = lighting.lightPosition;
-	fragSpecularLighting = lighting.lightSpecular;
-	fragDiffuseLighting = lighting.lightDiffuse;
-	fragAmbientLighting = lighting.lightAmbient;
-	fragSpecularCoefficient = lighting.lightSpecularExponent;
-
-	fragRenderTex = ubo.renderTex;
-
-	currLayer = constants.currentLayer;
-
-	gl_Position = ubo.proj * ubo.view * vec4(fragPos, 1.0);
+	gl_Position = ubo.proj * ubo.view * vec4(inPosition, 1.0);
 }
\ No newline at end of file
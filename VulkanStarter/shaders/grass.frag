@@ -0,0 +1,25 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "material.glsl"
+#include "oit.glsl"
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in float currLayer;
+
+void main() {
+	//Unlit, the blade colour and coverage come from the material and the layer only
+	float shadow = mix(0.4f, 1.0f, currLayer);
+
+	vec4 furData = sampleMaterial(fragTexCoord);
+	vec4 furColor = vec4(mix(vec3(0.08f, 0.25f, 0.05f), fragColor, currLayer), 1.0f); //darker towards the roots
+	furColor *= shadow;
+	
+	float furVisibility = (currLayer > furData.r) ? 0.0 : furData.a;
+	furColor.a = (currLayer == 0) ? 1 : furVisibility;
+	//furColor.a = furData.r;
+	
+	writeTransparent(furColor);
+}
\ No newline at end of file
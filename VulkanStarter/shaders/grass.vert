@@ -0,0 +1,62 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(set = 1, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+struct GrassPatch {
+	vec4 positionScale; //xyz patch centre on the ground, w uniform scale
+	vec4 rotationOffset; //xy cos/sin of the yaw, zw texture coordinate offset
+};
+
+layout(std430, set = 0, binding = 5) readonly buffer GrassPatches {
+	GrassPatch patches[];
+};
+
+//written by grasscull.comp, x = patch index, y = layer | shellCount << 16
+layout(std430, set = 0, binding = 6) readonly buffer GrassShells {
+	uvec2 visibleShells[];
+};
+
+//GRASS_BLADE_HEIGHT in main.cpp, which also sizes the patch bounds the cull pass tests
+layout(constant_id = 1) const float BLADE_HEIGHT = 1.5;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec2 inTexCoord;
+layout(location = 3) in vec3 inNormal;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out float currLayer;
+
+void main() {
+	//the cull pass ran out of room for this shell, collapse it so nothing is rasterized
+	if (gl_InstanceIndex >= visibleShells.length()) {
+		gl_Position = vec4(0.0, 0.0, -1.0, 1.0);
+		return;
+	}
+
+	uvec2 shell = visibleShells[gl_InstanceIndex];
+	GrassPatch grassPatch = patches[shell.x];
+	float shellCount = float(shell.y >> 16);
+	float layer = (shellCount > 1.0) ? float(shell.y & 0xFFFFu) / (shellCount - 1.0) : 0.0;
+
+	float scale = grassPatch.positionScale.w;
+	vec2 yaw = grassPatch.rotationOffset.xy;
+	vec3 local = inPosition * scale;
+	vec3 pos = grassPatch.positionScale.xyz + vec3(yaw.x * local.x - yaw.y * local.z, 0.0, yaw.y * local.x + yaw.x * local.z);
+
+	//blades lean away from the patch centre a little more at each layer
+	pos += vec3(0.0, BLADE_HEIGHT * layer, 0.0) + vec3(local.x, 0.0, local.z) * 0.1 * layer * layer;
+
+	fragColor = inColor;
+	fragTexCoord = inTexCoord * scale * 2.0 + grassPatch.rotationOffset.zw;
+
+	currLayer = layer;
+
+	gl_Position = ubo.proj * ubo.view * vec4(pos, 1.0);
+}
@@ -0,0 +1,90 @@
+//Material sampling shared by the fragment shaders, included by glslc
+
+layout(set = 0, binding = 0) uniform sampler2D textures[16]; //material texture table, MAX_TEXTURES in materials.h
+
+struct MaterialData {
+	vec4 uvTransform; //xy scale, zw offset into the atlas page. Virtual textures: xy size, z levels, w sRGB
+	uint texture;
+	uint atlased;
+	uint virtualTexture; //page table layer + 1
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Materials {
+	MaterialData materials[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+	float currentLayer;
+	uint material;
+} constants;
+
+//Virtual texturing, the constants match vtex.h
+layout(set = 0, binding = 2) uniform usampler2DArray pageTable; //slot x, slot y, mapped level, valid
+layout(set = 0, binding = 3) uniform sampler2D pageCache[2]; //UNORM and SRGB views of the same pages
+
+layout(std430, set = 1, binding = 6) buffer Feedback {
+	uint pageRequests[];
+};
+
+//VIRTUAL_TEXTURING in main.cpp, without it the feedback store is compiled out and fragmentStoresAndAtomics not required
+//constant 0 of every pipeline drawing materials, the shaders number their own constants after it
+layout(constant_id = 0) const bool VIRTUAL_FEEDBACK = false;
+
+const float VT_PAGE_SIZE = 120.0;
+const float VT_PAGE_BORDER = 4.0;
+const float VT_PAGE_SLOT = 128.0;
+const uint VT_PAGE_TABLE_SIZE = 256;
+const uint VT_FEEDBACK_ENTRIES = 87381;
+
+vec4 sampleVirtual(MaterialData m, vec2 uv) {
+	uint layer = m.virtualTexture - 1;
+	vec2 size = m.uvTransform.xy;
+	int levels = int(m.uvTransform.z);
+
+	//level of detail from the unwrapped coordinates, fract() would break the derivatives at the seams
+	vec2 dx = dFdx(uv * size);
+	vec2 dy = dFdy(uv * size);
+	int level = clamp(int(floor(0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0)))), 0, levels - 1);
+
+	uv = fract(uv);
+	vec2 levelSize = max(floor(size / exp2(float(level))), vec2(1.0));
+	ivec2 page = min(ivec2(uv * levelSize / VT_PAGE_SIZE), ivec2(ceil(levelSize / VT_PAGE_SIZE)) - 1);
+
+	//one pixel in sixteen reports its page, as a quarter resolution feedback pass would
+	if (VIRTUAL_FEEDBACK && (int(gl_FragCoord.x) & 3) == 0 && (int(gl_FragCoord.y) & 3) == 0) {
+		uint index = layer * VT_FEEDBACK_ENTRIES;
+		for (int l = 0; l < level; l++) {
+			index += (VT_PAGE_TABLE_SIZE >> l) * (VT_PAGE_TABLE_SIZE >> l);
+		}
+		index += uint(page.y) * (VT_PAGE_TABLE_SIZE >> level) + uint(page.x);
+		if (pageRequests[index] == 0) {
+			pageRequests[index] = 1;
+		}
+	}
+
+	//the entry names the page itself or the closest resident ancestor
+	uvec4 entry = texelFetch(pageTable, ivec3(page, layer), level);
+	if (entry.a == 0) {
+		return vec4(0.0);
+	}
+
+	vec2 mappedSize = max(floor(size / exp2(float(entry.b))), vec2(1.0));
+	vec2 texel = uv * mappedSize;
+	vec2 inPage = texel - floor(texel / VT_PAGE_SIZE) * VT_PAGE_SIZE;
+	vec2 physical = (vec2(entry.rg) * VT_PAGE_SLOT + VT_PAGE_BORDER + inPage) / vec2(textureSize(pageCache[0], 0));
+
+	return (m.uvTransform.w != 0.0) ? textureLod(pageCache[1], physical, 0.0) : textureLod(pageCache[0], physical, 0.0);
+}
+
+//Atlased entries wrap inside their rectangle of the page
+vec4 sampleMaterial(vec2 uv) {
+	MaterialData m = materials[constants.material];
+	if (m.virtualTexture != 0) {
+		return sampleVirtual(m, uv);
+	}
+	if (m.atlased != 0) {
+		uv = fract(uv) * m.uvTransform.xy + m.uvTransform.zw;
+	}
+	return texture(textures[m.texture], uv);
+}
@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(input_attachment_index = 0, set = 1, binding = 4) uniform subpassInput accumInput;
+layout(input_attachment_index = 1, set = 1, binding = 5) uniform subpassInput revealageInput;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	float revealage = subpassLoad(revealageInput).r;
+	if (revealage == 1.0) {
+		discard; //no transparent fragments covered this pixel
+	}
+
+	vec4 accum = subpassLoad(accumInput);
+	vec3 averageColor = accum.rgb / max(accum.a, 1e-5);
+
+	outColor = vec4(averageColor, 1.0 - revealage);
+}
@@ -0,0 +1,11 @@
+//Weighted blended OIT output shared by the transparent layers, included by glslc. oit.frag resolves it
+
+layout(location = 0) out vec4 outAccum;
+layout(location = 1) out float outRevealage;
+
+//Weighted blended OIT (McGuire & Bavoil 2013), weight favours close, opaque fragments
+void writeTransparent(vec4 color) {
+	float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+	outAccum = vec4(color.rgb * color.a, color.a) * weight;
+	outRevealage = color.a;
+}
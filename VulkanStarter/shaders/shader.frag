@@ -1,23 +1,40 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
-
-layout(binding = 2) uniform sampler2D texSampler[2];
-
-layout(binding = 4) uniform sampler2D shadowSampler;
+#extension GL_GOOGLE_include_directive : require
+
+#include "material.glsl"
+
+layout(set = 1, binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+	mat4 mvp;
+	mat4 normalMatrix;
+	vec3 eyePosition;
+	vec3 lightVector;		//light position transformed by the view, computed once per frame
+} ubo;
+
+layout(set = 1, binding = 1) uniform LightingConstants {
+    vec3 lightPosition; 
+	vec3 lightAmbient; 
+	vec3 lightDiffuse;
+	vec3 lightSpecular;
+	float lightSpecularExponent;
+} lighting;
+
+layout(set = 1, binding = 3) uniform sampler2D shadowSampler;
+
+//Pipeline permutations, a toggled feature selects another precompiled variant instead of a per pixel branch
+layout(constant_id = 1) const bool TEXTURED = true;
+layout(constant_id = 2) const bool LIGHTING = true;
+layout(constant_id = 3) const bool SHADOW_DEBUG = false;	//outputs the shadow term only
+layout(constant_id = 4) const int PCF_RADIUS = 1;			//kernel of (2r + 1)^2 shadow map taps
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
-layout(location = 2) in vec3 fragLightVector;
-layout(location = 3) in vec3 fragEyeVector;
-layout(location = 4) in vec3 fragSpecularLighting;
-layout(location = 5) in vec3 fragDiffuseLighting;
-layout(location = 6) in vec3 fragAmbientLighting;
-layout(location = 7) in float fragSpecularCoefficient;
-layout(location = 8) in vec3 fragNormal;
-layout(location = 9) in vec3 fragPos;
-layout(location = 10) in float fragRenderTex;
-layout(location = 11) in vec4 fragShadowCoord;
-layout(location = 12) in float fragRenderShadowMap;
+layout(location = 2) in vec3 fragNormal;
+layout(location = 3) in vec3 fragPos;
+layout(location = 4) in vec4 fragShadowCoord;
 
 layout(location = 0) out vec4 outColor;
 
@@ -36,7 +53,7 @@ float ShadowCalculation(vec4 fragShadowCoord)
     float currentDepth = projCoords.z;
 
 	//Calculate depth bias
-	vec3 lightDir = normalize(fragLightVector - fragPos);
+	vec3 lightDir = normalize(ubo.lightVector - fragPos);
 
 	float cosTheta = clamp(dot(normalize(fragNormal), lightDir), 0, 1.0);
 	float bias = 0.0005*tan(acos(cosTheta));
@@ -45,15 +62,15 @@ float ShadowCalculation(vec4 fragShadowCoord)
 	//Check if in shadow and perform PCF
 	float shadow = 0.0;
 	vec2 texelSize = 1.0 / textureSize(shadowSampler, 0);
-	for(int x = -1; x <= 1; ++x)
+	for(int x = -PCF_RADIUS; x <= PCF_RADIUS; ++x)
 	{
-		for(int y = -1; y <= 1; ++y)
+		for(int y = -PCF_RADIUS; y <= PCF_RADIUS; ++y)
 		{
 			float pcfDepth = texture(shadowSampler, projCoords.xy + vec2(x, y) * texelSize).r; 
 			shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;        
 		}    
 	}
-	shadow /= 9.0;
+	shadow /= float((2 * PCF_RADIUS + 1) * (2 * PCF_RADIUS + 1));
 
 	if(projCoords.z > 1.0)
         shadow = 0.0;
@@ -64,56 +81,49 @@ float ShadowCalculation(vec4 fragShadowCoord)
 void main() {
 
 	float shadow = ShadowCalculation(fragShadowCoord);
-	float visibility = 1.0;
-	if (shadow == 1.0)
+
+	if (SHADOW_DEBUG)
 	{
-		visibility = 0.5;
+		outColor = vec4(vec3(shadow), 1.0f);
+		return;
 	}
 
-	//Set texture color
-	vec3 textureColor = texture(texSampler[0], fragTexCoord).rgb;
-	if (fragRenderTex == 0.0f) {
-		textureColor = vec3(1.0f, 1.0f, 1.0f);
+	//Set base color, untextured variants skip the fetch
+	vec3 baseColor = fragColor;
+	if (TEXTURED) {
+		baseColor *= sampleMaterial(fragTexCoord).rgb;
 	}
-	
-	//Set ambient lighting
-	vec3 off = {0.0f, 0.0f, 0.0f};
-	vec3 ambient = {0.0f, 0.0f, 0.0f};
-	if (fragAmbientLighting != off)
+
+	//Unlit variants show the base color and drop the lighting terms altogether
+	if (!LIGHTING)
 	{
-		ambient = (fragAmbientLighting * fragColor) * 0.6;
-	} else
+		outColor = vec4(baseColor, 1.0f);
+		return;
+	}
+
+	float visibility = 1.0;
+	if (shadow == 1.0)
 	{
-		ambient = fragColor;
+		visibility = 0.5;
 	}
 
+	//Set ambient lighting
+	vec3 ambient = (lighting.lightAmbient * baseColor) * 0.6;
+
 	//Set diffuse lighting
-	vec3 diffuse = {0.0f, 0.0f, 0.0f};
-	vec3 lightDir = normalize(fragLightVector - fragPos);
+	vec3 lightDir = normalize(ubo.lightVector - fragPos);
 	vec3 normal = normalize(fragNormal);
 	float diff = max(dot(normal, lightDir), 0.0);
-	if (fragDiffuseLighting != off)
-	{
-		diffuse = (diff * (visibility * fragDiffuseLighting * fragColor) * 0.5);
-	}
+	vec3 diffuse = (diff * (visibility * lighting.lightDiffuse * baseColor) * 0.5);
 
 	//Set specular lighting
-	vec3 specular = {0.0f, 0.0f, 0.0f};
-	vec3 viewDir = normalize(fragEyeVector - fragPos);
+	vec3 viewDir = normalize(ubo.eyePosition - fragPos);
 	vec3 halfwayDir = normalize(lightDir + viewDir);
-	float spec = pow(max(dot(normal, halfwayDir), 0.0), fragSpecularCoefficient);
-	if (fragSpecularLighting != off)
-	{
-		specular = (visibility * fragSpecularLighting * spec * fragColor) * 0.2;
-	}
+	float spec = pow(max(dot(normal, halfwayDir), 0.0), lighting.lightSpecularExponent);
+	vec3 specular = (visibility * lighting.lightSpecular * spec * baseColor) * 0.2;
 
 	//vec3 lightingColor = (ambient + (1.0 - shadow) * (diffuse + specular));
 	vec3 lightingColor = (ambient + diffuse + specular);
-
-	if (fragRenderShadowMap == 0.0f)
-	{
-		lightingColor = vec3(shadow);
-	}
 	
 	outColor = vec4(lightingColor, 1.0f);
 }
\ No newline at end of file
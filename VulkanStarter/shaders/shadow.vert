@@ -1,15 +1,14 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(binding = 0) uniform UniformBufferObject {
+layout(set = 1, binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
-	float renderTex;
 	mat4 mvp;
 } ubo;
 
-layout(binding = 3) uniform ShadowBufferObject {
+layout(set = 1, binding = 2) uniform ShadowBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
@@ -0,0 +1,528 @@
+#include <stdexcept>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <stb_image.h>
+
+#include "texcompress.h"
+#include "parallel.h"
+
+using namespace texcompress;
+using texstream::mipLevel;
+
+namespace
+{
+    const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+    const uint32_t KTX2_HEADER_SIZE = 80;       // identifier, header and index, the level index follows
+    const uint32_t KTX2_LEVEL_INDEX_SIZE = 24;
+
+    // Khronos data format descriptor values used by the basic descriptor block
+    const uint32_t DF_MODEL_RGBSDA = 1;
+    const uint32_t DF_MODEL_BC4 = 131;
+    const uint32_t DF_MODEL_BC5 = 132;
+    const uint32_t DF_MODEL_BC7 = 134;
+    const uint32_t DF_PRIMARIES_BT709 = 1;
+    const uint32_t DF_TRANSFER_LINEAR = 1;
+    const uint32_t DF_TRANSFER_SRGB = 2;
+    const uint32_t DF_SAMPLE_LINEAR = 0x10;     // channel qualifier, alpha stays linear in sRGB formats
+
+    // BC7 interpolation weights for 4 bit indices
+    const uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    bool isSrgb(VkFormat format)
+    {
+        return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+
+    // Bytes of one 4x4 block, 0 for uncompressed RGBA8.
+    uint32_t blockBytes(VkFormat format)
+    {
+        switch (format) {
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            return 8;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            return 16;
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+            return 0;
+        default:
+            throw std::invalid_argument("unsupported texture asset format!");
+        }
+    }
+
+    size_t levelSize(VkFormat format, uint32_t width, uint32_t height)
+    {
+        uint32_t bytes = blockBytes(format);
+        if (bytes == 0) {
+            return static_cast<size_t>(width) * height * 4;
+        }
+        return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * bytes;
+    }
+
+    std::string formatTag(VkFormat format)
+    {
+        switch (format) {
+        case VK_FORMAT_BC4_UNORM_BLOCK: return "bc4";
+        case VK_FORMAT_BC5_UNORM_BLOCK: return "bc5";
+        case VK_FORMAT_BC7_UNORM_BLOCK: return "bc7";
+        case VK_FORMAT_BC7_SRGB_BLOCK: return "bc7srgb";
+        case VK_FORMAT_R8G8B8A8_UNORM: return "rgba8";
+        case VK_FORMAT_R8G8B8A8_SRGB: return "rgba8srgb";
+        default:
+            throw std::invalid_argument("unsupported texture asset format!");
+        }
+    }
+
+    // Gathers a 4x4 block, texels past the level's edge repeat the last row or column
+    void fetchBlock(const mipLevel& level, uint32_t blockX, uint32_t blockY, uint8_t texels[16][4])
+    {
+        for (uint32_t y = 0; y < 4; y++) {
+            uint32_t sourceY = std::min(blockY * 4 + y, level.height - 1);
+            for (uint32_t x = 0; x < 4; x++) {
+                uint32_t sourceX = std::min(blockX * 4 + x, level.width - 1);
+                memcpy(texels[y * 4 + x], &level.texels[(static_cast<size_t>(sourceY) * level.width + sourceX) * 4], 4);
+            }
+        }
+    }
+
+    // Writes fields into a 128 bit block, least significant bit first
+    struct blockWriter
+    {
+        uint8_t* block;
+        uint32_t position = 0;
+
+        void write(uint32_t value, uint32_t bits)
+        {
+            for (uint32_t bit = 0; bit < bits; bit++, position++) {
+                if (value & (1u << bit)) {
+                    block[position / 8] |= static_cast<uint8_t>(1u << (position % 8));
+                }
+            }
+        }
+    };
+
+    // BC4: two 8 bit endpoints and 3 bit indices into the 8 value ramp between them
+    void encodeBC4Block(const uint8_t values[16], uint8_t* block)
+    {
+        uint8_t high = *std::max_element(values, values + 16);
+        uint8_t low = *std::min_element(values, values + 16);
+
+        memset(block, 0, 8);
+        block[0] = high;
+        block[1] = low;
+
+        blockWriter writer = { block + 2 };
+        for (uint32_t i = 0; i < 16; i++) {
+            uint32_t index = 0;
+            if (high != low) {
+                //step 0 is the high endpoint, index 0, step 7 the low one, index 1, the steps between are indices 2 to 7
+                long step = std::lround((high - values[i]) * 7.0f / (high - low));
+                index = step == 0 ? 0 : step == 7 ? 1 : static_cast<uint32_t>(step) + 1;
+            }
+            writer.write(index, 3);
+        }
+    }
+
+    // BC7 mode 6: one subset, 7 bit RGBA endpoints with a p bit each, 4 bit indices.
+    // Endpoints are the extremes of the block along its principal axis, every p bit combination is tried.
+    void encodeBC7Block(const uint8_t texels[16][4], uint8_t* block)
+    {
+        float mean[4] = {};
+        for (uint32_t i = 0; i < 16; i++) {
+            for (uint32_t c = 0; c < 4; c++) {
+                mean[c] += texels[i][c] / 16.0f;
+            }
+        }
+
+        float covariance[4][4] = {};
+        for (uint32_t i = 0; i < 16; i++) {
+            float d[4];
+            for (uint32_t c = 0; c < 4; c++) {
+                d[c] = texels[i][c] - mean[c];
+            }
+            for (uint32_t a = 0; a < 4; a++) {
+                for (uint32_t b = 0; b < 4; b++) {
+                    covariance[a][b] += d[a] * d[b];
+                }
+            }
+        }
+
+        float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        for (uint32_t iteration = 0; iteration < 8; iteration++) {
+            float next[4] = {};
+            for (uint32_t a = 0; a < 4; a++) {
+                for (uint32_t b = 0; b < 4; b++) {
+                    next[a] += covariance[a][b] * axis[b];
+                }
+            }
+            float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+            if (length < 1e-6f) {
+                break; //a flat block, both endpoints end up at the mean
+            }
+            for (uint32_t c = 0; c < 4; c++) {
+                axis[c] = next[c] / length;
+            }
+        }
+
+        float tMin = 0.0f, tMax = 0.0f;
+        for (uint32_t i = 0; i < 16; i++) {
+            float t = 0.0f;
+            for (uint32_t c = 0; c < 4; c++) {
+                t += (texels[i][c] - mean[c]) * axis[c];
+            }
+            tMin = std::min(tMin, t);
+            tMax = std::max(tMax, t);
+        }
+
+        uint32_t bestError = UINT32_MAX;
+        uint32_t bestEndpoints[2][4] = {};
+        uint32_t bestPBits[2] = {};
+        uint32_t bestIndices[16] = {};
+
+        for (uint32_t pBits = 0; pBits < 4; pBits++) {
+            uint32_t p[2] = { pBits & 1, pBits >> 1 };
+            uint32_t quantized[2][4];
+            uint32_t endpoints[2][4];
+            for (uint32_t e = 0; e < 2; e++) {
+                float t = e == 0 ? tMin : tMax;
+                for (uint32_t c = 0; c < 4; c++) {
+                    float value = std::min(std::max(mean[c] + t * axis[c], 0.0f), 255.0f);
+                    quantized[e][c] = static_cast<uint32_t>(std::min(std::max(std::lround((value - p[e]) / 2.0f), 0l), 127l));
+                    endpoints[e][c] = (quantized[e][c] << 1) | p[e];
+                }
+            }
+
+            uint32_t palette[16][4];
+            for (uint32_t i = 0; i < 16; i++) {
+                for (uint32_t c = 0; c < 4; c++) {
+                    palette[i][c] = ((64 - BC7_WEIGHTS[i]) * endpoints[0][c] + BC7_WEIGHTS[i] * endpoints[1][c] + 32) >> 6;
+                }
+            }
+
+            uint32_t error = 0;
+            uint32_t indices[16];
+            for (uint32_t i = 0; i < 16; i++) {
+                uint32_t texelError = UINT32_MAX;
+                for (uint32_t candidate = 0; candidate < 16; candidate++) {
+                    uint32_t candidateError = 0;
+                    for (uint32_t c = 0; c < 4; c++) {
+                        int32_t d = static_cast<int32_t>(palette[candidate][c]) - texels[i][c];
+                        candidateError += static_cast<uint32_t>(d * d);
+                    }
+                    if (candidateError < texelError) {
+                        texelError = candidateError;
+                        indices[i] = candidate;
+                    }
+                }
+                error += texelError;
+            }
+
+            if (error < bestError) {
+                bestError = error;
+                memcpy(bestEndpoints, quantized, sizeof(quantized));
+                memcpy(bestPBits, p, sizeof(p));
+                memcpy(bestIndices, indices, sizeof(indices));
+            }
+        }
+
+        //the anchor index has an implicit 0 top bit, swapping the endpoints mirrors the indices
+        if (bestIndices[0] & 8) {
+            for (uint32_t c = 0; c < 4; c++) {
+                std::swap(bestEndpoints[0][c], bestEndpoints[1][c]);
+            }
+            std::swap(bestPBits[0], bestPBits[1]);
+            for (uint32_t i = 0; i < 16; i++) {
+                bestIndices[i] = 15 - bestIndices[i];
+            }
+        }
+
+        memset(block, 0, 16);
+        blockWriter writer = { block };
+        writer.write(1u << 6, 7);
+        for (uint32_t c = 0; c < 4; c++) {
+            writer.write(bestEndpoints[0][c], 7);
+            writer.write(bestEndpoints[1][c], 7);
+        }
+        writer.write(bestPBits[0], 1);
+        writer.write(bestPBits[1], 1);
+        writer.write(bestIndices[0], 3);
+        for (uint32_t i = 1; i < 16; i++) {
+            writer.write(bestIndices[i], 4);
+        }
+    }
+
+    mipLevel encodeLevel(const mipLevel& source, VkFormat format)
+    {
+        mipLevel encoded;
+        encoded.width = source.width;
+        encoded.height = source.height;
+        encoded.texels.resize(levelSize(format, source.width, source.height));
+
+        uint32_t bytes = blockBytes(format);
+        uint32_t blocksX = (source.width + 3) / 4;
+        uint32_t blocksY = (source.height + 3) / 4;
+
+        parallel::forRanges(blocksY, [&](uint32_t rowBegin, uint32_t rowEnd) {
+            for (uint32_t blockY = rowBegin; blockY < rowEnd; blockY++) {
+                for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+                    uint8_t texels[16][4];
+                    fetchBlock(source, blockX, blockY, texels);
+                    uint8_t* block = &encoded.texels[(static_cast<size_t>(blockY) * blocksX + blockX) * bytes];
+
+                    if (format == VK_FORMAT_BC7_UNORM_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK) {
+                        encodeBC7Block(texels, block);
+                        continue;
+                    }
+
+                    uint8_t red[16], alpha[16];
+                    for (uint32_t i = 0; i < 16; i++) {
+                        red[i] = texels[i][0];
+                        alpha[i] = texels[i][3];
+                    }
+                    encodeBC4Block(red, block);
+                    if (format == VK_FORMAT_BC5_UNORM_BLOCK) {
+                        encodeBC4Block(alpha, block + 8);
+                    }
+                }
+            }
+        });
+
+        return encoded;
+    }
+
+    // Basic data format descriptor block, preceded by its total size
+    std::vector<uint32_t> dataFormatDescriptor(VkFormat format)
+    {
+        struct sample { uint32_t bitOffset, bitLength, channel, upper; };
+        std::vector<sample> samples;
+        uint32_t model = DF_MODEL_RGBSDA;
+        uint32_t blockDimension = 0;        // texel block size minus one, in each of the first two dimensions
+        uint32_t bytes = 4;
+
+        switch (format) {
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            model = DF_MODEL_BC4;
+            samples = { { 0, 64, 0, UINT32_MAX } };
+            break;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            model = DF_MODEL_BC5;
+            samples = { { 0, 64, 0, UINT32_MAX }, { 64, 64, 1, UINT32_MAX } };
+            break;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            model = DF_MODEL_BC7;
+            samples = { { 0, 128, 0, UINT32_MAX } };
+            break;
+        default:
+            samples = { { 0, 8, 0, 255 }, { 8, 8, 1, 255 }, { 16, 8, 2, 255 }, { 24, 8, 15 | DF_SAMPLE_LINEAR, 255 } };
+            break;
+        }
+        if (blockBytes(format) != 0) {
+            blockDimension = 3 | (3 << 8);
+            bytes = blockBytes(format);
+        }
+
+        uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+        std::vector<uint32_t> words = {
+            4 + blockSize,
+            0,                                          // Khronos vendor, basic descriptor type
+            2 | (blockSize << 16),                      // version 2
+            model | (DF_PRIMARIES_BT709 << 8) | ((isSrgb(format) ? DF_TRANSFER_SRGB : DF_TRANSFER_LINEAR) << 16),
+            blockDimension,
+            bytes,
+            0
+        };
+        for (const sample& described : samples) {
+            words.push_back(described.bitOffset | ((described.bitLength - 1) << 16) | (described.channel << 24));
+            words.push_back(0);
+            words.push_back(0);
+            words.push_back(described.upper);
+        }
+        return words;
+    }
+
+    template<typename T>
+    T readValue(const std::vector<uint8_t>& file, size_t offset)
+    {
+        T value;
+        memcpy(&value, &file[offset], sizeof(T));
+        return value;
+    }
+}
+
+VkFormat texcompress::chooseFormat(VkPhysicalDevice physicalDevice, bool blockCompressionEnabled, VkFormat compressed, VkFormat fallback)
+{
+    if (!blockCompressionEnabled) {
+        return fallback;
+    }
+
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, compressed, &formatProperties);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    return (formatProperties.optimalTilingFeatures & required) == required ? compressed : fallback;
+}
+
+std::vector<mipLevel> texcompress::decodeImage(const std::string& path)
+{
+    int texWidth, texHeight, texChannels;
+    stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+    if (!pixels) {
+        throw std::runtime_error("failed to load texture image!");
+    }
+
+    std::vector<mipLevel> mips(1);
+    mips[0].width = static_cast<uint32_t>(texWidth);
+    mips[0].height = static_cast<uint32_t>(texHeight);
+    mips[0].texels.assign(pixels, pixels + static_cast<size_t>(texWidth) * texHeight * 4);
+
+    stbi_image_free(pixels);
+
+    return mips;
+}
+
+std::vector<mipLevel> texcompress::encode(const std::vector<mipLevel>& rgba, VkFormat format)
+{
+    if (blockBytes(format) == 0) {
+        return rgba;
+    }
+
+    std::vector<mipLevel> encoded;
+    encoded.reserve(rgba.size());
+    for (const auto& level : rgba) {
+        encoded.push_back(encodeLevel(level, format));
+    }
+    return encoded;
+}
+
+bool texcompress::readKTX2(const std::string& path, VkFormat format, std::vector<mipLevel>& mips)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+        return false;
+    }
+
+    std::vector<uint8_t> contents(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(contents.data()), contents.size());
+    if (!file || contents.size() < KTX2_HEADER_SIZE || memcmp(contents.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+        return false;
+    }
+
+    uint32_t vkFormat = readValue<uint32_t>(contents, 12);
+    uint32_t width = readValue<uint32_t>(contents, 20);
+    uint32_t height = readValue<uint32_t>(contents, 24);
+    uint32_t levelCount = readValue<uint32_t>(contents, 40);
+    uint32_t supercompression = readValue<uint32_t>(contents, 44);
+
+    if (vkFormat != static_cast<uint32_t>(format) || width == 0 || height == 0 || levelCount == 0 || levelCount > 32 || supercompression != 0
+        || contents.size() < KTX2_HEADER_SIZE + static_cast<size_t>(levelCount) * KTX2_LEVEL_INDEX_SIZE) {
+        return false;
+    }
+
+    mips.assign(levelCount, mipLevel());
+    for (uint32_t level = 0; level < levelCount; level++) {
+        size_t entry = KTX2_HEADER_SIZE + static_cast<size_t>(level) * KTX2_LEVEL_INDEX_SIZE;
+        uint64_t byteOffset = readValue<uint64_t>(contents, entry);
+        uint64_t byteLength = readValue<uint64_t>(contents, entry + 8);
+
+        mipLevel& read = mips[level];
+        read.width = std::max(width >> level, 1u);
+        read.height = std::max(height >> level, 1u);
+        if (byteLength != levelSize(format, read.width, read.height) || byteOffset + byteLength > contents.size()) {
+            return false;
+        }
+        read.texels.assign(contents.begin() + static_cast<size_t>(byteOffset), contents.begin() + static_cast<size_t>(byteOffset + byteLength));
+    }
+
+    return true;
+}
+
+void texcompress::writeKTX2(const std::string& path, VkFormat format, const std::vector<mipLevel>& mips)
+{
+    std::vector<uint32_t> descriptor = dataFormatDescriptor(format);
+    uint32_t levelCount = static_cast<uint32_t>(mips.size());
+    uint32_t dfdOffset = KTX2_HEADER_SIZE + levelCount * KTX2_LEVEL_INDEX_SIZE;
+    uint32_t dfdLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+
+    //levels are stored smallest first, each aligned to its texel block
+    uint64_t alignment = std::max(blockBytes(format), 4u);
+    std::vector<uint64_t> offsets(levelCount);
+    uint64_t end = dfdOffset + dfdLength;
+    for (uint32_t level = levelCount; level-- > 0;) {
+        end = (end + alignment - 1) / alignment * alignment;
+        offsets[level] = end;
+        end += mips[level].texels.size();
+    }
+
+    std::vector<uint8_t> contents(static_cast<size_t>(end), 0);
+    auto put32 = [&contents](size_t offset, uint32_t value) { memcpy(&contents[offset], &value, sizeof(value)); };
+    auto put64 = [&contents](size_t offset, uint64_t value) { memcpy(&contents[offset], &value, sizeof(value)); };
+
+    memcpy(contents.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    put32(12, static_cast<uint32_t>(format));
+    put32(16, 1);                               // typeSize
+    put32(20, mips[0].width);
+    put32(24, mips[0].height);
+    put32(28, 0);                               // pixelDepth, a 2D texture
+    put32(32, 0);                               // layerCount, not an array
+    put32(36, 1);                               // faceCount
+    put32(40, levelCount);
+    put32(44, 0);                               // no supercompression
+    put32(48, dfdOffset);
+    put32(52, dfdLength);
+    put32(56, 0);                               // no key/value data
+    put32(60, 0);
+    put64(64, 0);                               // no supercompression global data
+    put64(72, 0);
+
+    for (uint32_t level = 0; level < levelCount; level++) {
+        size_t entry = KTX2_HEADER_SIZE + static_cast<size_t>(level) * KTX2_LEVEL_INDEX_SIZE;
+        put64(entry, offsets[level]);
+        put64(entry + 8, mips[level].texels.size());
+        put64(entry + 16, mips[level].texels.size());
+        memcpy(&contents[static_cast<size_t>(offsets[level])], mips[level].texels.data(), mips[level].texels.size());
+    }
+    memcpy(&contents[dfdOffset], descriptor.data(), dfdLength);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(contents.data()), contents.size());
+    if (!file) {
+        throw std::runtime_error("failed to write texture asset " + path + "!");
+    }
+}
+
+std::string texcompress::cachePath(const std::string& cacheDirectory, const std::string& name, VkFormat format)
+{
+    return cacheDirectory + "/" + name + "_" + formatTag(format) + ".ktx2";
+}
+
+std::vector<mipLevel> texcompress::loadOrTranscode(const std::string& cachePath, const std::string& sourcePath, VkFormat format, const producer& produce)
+{
+    std::error_code error;
+    bool stale = !sourcePath.empty() && std::filesystem::exists(sourcePath, error) && std::filesystem::exists(cachePath, error)
+        && std::filesystem::last_write_time(sourcePath, error) > std::filesystem::last_write_time(cachePath, error);
+
+    std::vector<mipLevel> mips;
+    if (!stale && readKTX2(cachePath, format, mips)) {
+        return mips;
+    }
+
+    mips = produce();
+    if (mips.empty()) {
+        throw std::runtime_error("texture producer returned no levels!");
+    }
+    texstream::completeChain(mips, isSrgb(format));
+    mips = encode(mips, format);
+
+    std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+    writeKTX2(cachePath, format, mips);
+
+    return mips;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+#include "texstream.h"
+
+// Block compressed texture assets. Source images are decoded, given a full mip chain and encoded once, on first run, then
+// stored as KTX2 files that later runs upload without decoding anything.
+// Encoders: BC7 mode 6 for colour (RGBA), BC4 blocks for single channel data, and BC5 (two BC4 blocks) for the fur
+// map's height and coverage. Devices without BC support get the uncompressed RGBA8 fallback in the same container.
+namespace texcompress
+{
+    // Produces the RGBA8 levels of a texture, at least level 0, runs on the streaming worker.
+    typedef std::function<std::vector<texstream::mipLevel>()> producer;
+
+    // Returns compressed when the device samples it with linear filtering, fallback otherwise.
+    VkFormat chooseFormat(VkPhysicalDevice, bool blockCompressionEnabled, VkFormat compressed, VkFormat fallback);
+
+    // Decodes an image file with stb_image into one RGBA8 level.
+    std::vector<texstream::mipLevel> decodeImage(const std::string& path);
+
+    // Converts a full RGBA8 chain to format. BC4 takes the red channel and BC5 takes red and alpha.
+    std::vector<texstream::mipLevel> encode(const std::vector<texstream::mipLevel>& rgba, VkFormat);
+
+    bool readKTX2(const std::string& path, VkFormat, std::vector<texstream::mipLevel>&);
+    void writeKTX2(const std::string& path, VkFormat, const std::vector<texstream::mipLevel>&);
+
+    // Path of the cached asset for a texture name in format.
+    std::string cachePath(const std::string& cacheDirectory, const std::string& name, VkFormat);
+
+    // Reads the cached asset, or produces, completes the chain, encodes and caches it when the cache is missing,
+    // in another format, or older than sourcePath (pass an empty sourcePath when the name already identifies the content).
+    std::vector<texstream::mipLevel> loadOrTranscode(const std::string& cachePath, const std::string& sourcePath, VkFormat, const producer&);
+}
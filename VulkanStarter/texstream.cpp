@@ -0,0 +1,499 @@
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+#include "texstream.h"
+#include "mipgen.h"
+
+using namespace texstream;
+
+namespace
+{
+    void decodeLoop(streamer* textureStreamer)
+    {
+        for (;;) {
+            std::pair<uint32_t, loader> request;
+            {
+                std::unique_lock<std::mutex> lock(textureStreamer->mutex);
+                textureStreamer->wake.wait(lock, [textureStreamer]() { return textureStreamer->stopping || !textureStreamer->requests.empty(); });
+                if (textureStreamer->stopping) {
+                    return;
+                }
+                request = std::move(textureStreamer->requests.front());
+                textureStreamer->requests.pop_front();
+            }
+
+            decoded result;
+            result.id = request.first;
+            try {
+                result.mips = request.second();
+                if (result.mips.empty()) {
+                    result.error = "no mip levels";
+                }
+            }
+            catch (const std::exception& e) {
+                result.error = e.what();
+            }
+
+            std::lock_guard<std::mutex> lock(textureStreamer->mutex);
+            textureStreamer->finished.push_back(std::move(result));
+        }
+    }
+
+    void requestDecode(streamer& textureStreamer, uint32_t id)
+    {
+        texture& streamed = textureStreamer.textures[id];
+        streamed.decoding = true;
+        {
+            std::lock_guard<std::mutex> lock(textureStreamer.mutex);
+            textureStreamer.requests.emplace_back(id, streamed.load);
+        }
+        textureStreamer.wake.notify_one();
+    }
+
+    VkDeviceSize levelBytes(const mipLevel& level)
+    {
+        return level.texels.size();
+    }
+
+    bool isSrgb(VkFormat format)
+    {
+        return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+
+    VkDeviceSize chainBytes(const std::vector<mipLevel>& mips, uint32_t firstMip)
+    {
+        VkDeviceSize bytes = 0;
+        for (uint32_t level = firstMip; level < mips.size(); level++) {
+            bytes += levelBytes(mips[level]);
+        }
+        return bytes;
+    }
+
+    // Bytes staged for a generation starting at firstMip.
+    VkDeviceSize uploadBytes(const texture& streamed, uint32_t firstMip)
+    {
+        return streamed.blitMips ? levelBytes(streamed.mips[firstMip]) : chainBytes(streamed.mips, firstMip);
+    }
+
+    // Creates the image and view for levels [0, levels) of the given chain and records their upload.
+    generation createGeneration(streamer& textureStreamer, VkFormat format, VkComponentMapping swizzle, const mipLevel* levels, uint32_t levelCount, bool blitMips)
+    {
+        blitMips = blitMips && levelCount > 1;
+
+        generation created;
+
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = levels[0].width;
+        imageInfo.extent.height = levels[0].height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = levelCount;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | (blitMips ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0);
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateImage(textureStreamer.device, &imageInfo, nullptr, &created.image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create streamed image!");
+        }
+
+        created.memory = memalloc::allocateForImage(*textureStreamer.memoryAllocator, created.image, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = created.image;
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        viewInfo.format = format;
+        viewInfo.components = swizzle;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = levelCount;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = 1;
+
+        if (vkCreateImageView(textureStreamer.device, &viewInfo, nullptr, &created.view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create streamed image view!");
+        }
+
+        for (uint32_t level = 0; level < levelCount; level++) {
+            created.bytes += levelBytes(levels[level]);
+        }
+
+        //blitted chains only stage their top level
+        uint32_t copiedLevels = blitMips ? 1 : levelCount;
+        VkDeviceSize stagedBytes = blitMips ? levelBytes(levels[0]) : created.bytes;
+
+        VkBuffer stagingBuffer;
+        VkDeviceSize stagingOffset;
+        uint8_t* dst = static_cast<uint8_t*>(upload::stage(*textureStreamer.uploadContext, stagedBytes, stagingBuffer, stagingOffset));
+
+        std::vector<VkBufferImageCopy> regions(copiedLevels);
+        VkDeviceSize levelOffset = 0;
+        for (uint32_t level = 0; level < copiedLevels; level++) {
+            memcpy(dst + levelOffset, levels[level].texels.data(), static_cast<size_t>(levelBytes(levels[level])));
+
+            VkBufferImageCopy& region = regions[level];
+            region.bufferOffset = levelOffset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { 0, 0, 0 };
+            region.imageExtent = { levels[level].width, levels[level].height, 1 };
+
+            levelOffset += levelBytes(levels[level]);
+        }
+
+        upload::transitionImage(*textureStreamer.uploadContext, created.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount);
+        upload::copyToImage(*textureStreamer.uploadContext, stagingBuffer, stagingOffset, created.image, regions);
+        if (blitMips) {
+            upload::generateMipmaps(*textureStreamer.uploadContext, created.image, levels[0].width, levels[0].height, levelCount);
+        }
+        else {
+            upload::transitionImage(*textureStreamer.uploadContext, created.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, levelCount);
+        }
+
+        return created;
+    }
+
+    void destroyGeneration(streamer& textureStreamer, generation& destroyed)
+    {
+        vkDestroyImageView(textureStreamer.device, destroyed.view, nullptr);
+        vkDestroyImage(textureStreamer.device, destroyed.image, nullptr);
+        memalloc::free(*textureStreamer.memoryAllocator, destroyed.memory);
+    }
+
+    // Makes levels [firstMip, end) of the host chain the texture's resident image, the old image is retired.
+    void replaceGeneration(streamer& textureStreamer, texture& streamed, uint32_t firstMip)
+    {
+        generation created = createGeneration(textureStreamer, streamed.format, streamed.swizzle, &streamed.mips[firstMip], static_cast<uint32_t>(streamed.mips.size()) - firstMip, streamed.blitMips);
+        created.firstMip = firstMip;
+
+        textureStreamer.residentBytes -= streamed.current.bytes;
+        textureStreamer.residentBytes += created.bytes;
+        textureStreamer.retired.push_back(streamed.current);
+
+        streamed.current = created;
+        streamed.placeholder = false;
+    }
+
+    // Drops the host copies of the levels above the tail, they are decoded again when needed.
+    void releaseHostLevels(texture& streamed)
+    {
+        for (uint32_t level = 0; level < streamed.tailMip; level++) {
+            std::vector<uint8_t>().swap(streamed.mips[level].texels);
+        }
+    }
+
+    bool isBound(const streamer& textureStreamer, VkImageView view)
+    {
+        for (const auto& streamed : textureStreamer.textures) {
+            if (std::find(streamed.boundViews.begin(), streamed.boundViews.end(), view) != streamed.boundViews.end()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Destroys retired images no descriptor set refers to anymore. Every frame that sampled them has completed,
+    // since a set is only rewritten once the frame that used it has completed. An image replaced in the update that
+    // created it was never bound, so its own upload is waited out too.
+    void collectRetired(streamer& textureStreamer)
+    {
+        for (size_t i = 0; i < textureStreamer.retired.size();) {
+            const generation& retiredGeneration = textureStreamer.retired[i];
+            if (isBound(textureStreamer, retiredGeneration.view) || retiredGeneration.written == UNSUBMITTED ||
+                !upload::isComplete(*textureStreamer.uploadContext, retiredGeneration.written)) {
+                i++;
+                continue;
+            }
+            destroyGeneration(textureStreamer, textureStreamer.retired[i]);
+            textureStreamer.retired.erase(textureStreamer.retired.begin() + i);
+        }
+    }
+}
+
+void texstream::init(streamer& textureStreamer, VkPhysicalDevice physicalDevice, VkDevice device, memalloc::allocator& memoryAllocator, upload::context& uploadContext, VkDeviceSize budget, VkDeviceSize uploadBytesPerFrame)
+{
+    textureStreamer.physicalDevice = physicalDevice;
+    textureStreamer.device = device;
+    textureStreamer.memoryAllocator = &memoryAllocator;
+    textureStreamer.uploadContext = &uploadContext;
+    textureStreamer.budget = budget;
+    textureStreamer.uploadBytesPerFrame = uploadBytesPerFrame;
+    textureStreamer.stopping = false;
+
+    textureStreamer.worker = std::thread(decodeLoop, &textureStreamer);
+}
+
+void texstream::destroy(streamer& textureStreamer)
+{
+    {
+        std::lock_guard<std::mutex> lock(textureStreamer.mutex);
+        textureStreamer.stopping = true;
+    }
+    textureStreamer.wake.notify_all();
+    if (textureStreamer.worker.joinable()) {
+        textureStreamer.worker.join();
+    }
+
+    for (auto& streamed : textureStreamer.textures) {
+        destroyGeneration(textureStreamer, streamed.current);
+    }
+    for (auto& retiredGeneration : textureStreamer.retired) {
+        destroyGeneration(textureStreamer, retiredGeneration);
+    }
+
+    textureStreamer.textures.clear();
+    textureStreamer.retired.clear();
+    textureStreamer.requests.clear();
+    textureStreamer.finished.clear();
+    textureStreamer.residentBytes = 0;
+}
+
+uint32_t texstream::add(streamer& textureStreamer, const std::string& name, VkFormat format, VkComponentMapping swizzle, uint32_t placeholder, VkSampler sampler, uint32_t binding, uint32_t arrayElement, loader load)
+{
+    uint32_t id = static_cast<uint32_t>(textureStreamer.textures.size());
+
+    textureStreamer.textures.emplace_back();
+    texture& streamed = textureStreamer.textures.back();
+    streamed.name = name;
+    streamed.format = format;
+    streamed.swizzle = swizzle;
+    streamed.blitMips = mipgen::supportsLinearBlit(textureStreamer.physicalDevice, format);
+
+    //block compressed loaders provide their whole chain, RGBA8 ones may leave the levels below level 0 to the worker
+    bool uncompressed = format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+    bool srgb = format == VK_FORMAT_R8G8B8A8_SRGB;
+    streamed.load = [load, uncompressed, srgb]() {
+        std::vector<mipLevel> mips = load();
+        if (!mips.empty() && uncompressed) {
+            completeChain(mips, srgb);
+        }
+        return mips;
+    };
+    streamed.sampler = sampler;
+    streamed.binding = binding;
+    streamed.arrayElement = arrayElement;
+
+    mipLevel placeholderLevel;
+    placeholderLevel.width = 1;
+    placeholderLevel.height = 1;
+    placeholderLevel.texels.resize(4);
+    memcpy(placeholderLevel.texels.data(), &placeholder, 4);
+
+    //the placeholder is plain RGBA8 in the texture's colour space, block formats cannot hold a single texel
+    VkFormat placeholderFormat = isSrgb(format) ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+    VkComponentMapping identity = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+    streamed.current = createGeneration(textureStreamer, placeholderFormat, identity, &placeholderLevel, 1, false);
+    textureStreamer.residentBytes += streamed.current.bytes;
+
+    requestDecode(textureStreamer, id);
+
+    return id;
+}
+
+void texstream::completeChain(std::vector<mipLevel>& mips, bool srgb)
+{
+    uint32_t levelCount = mipgen::levelCount(mips[0].width, mips[0].height);
+    while (mips.size() < levelCount) {
+        const mipLevel& source = mips.back();
+
+        mipLevel next;
+        next.width = std::max(source.width / 2, 1u);
+        next.height = std::max(source.height / 2, 1u);
+        next.texels.resize(static_cast<size_t>(next.width) * next.height * 4);
+        mipgen::downsample(source.texels.data(), source.width, source.height, next.texels.data(), srgb);
+
+        mips.push_back(std::move(next));
+    }
+}
+
+void texstream::touch(streamer& textureStreamer, uint32_t id)
+{
+    textureStreamer.textures[id].lastUsedFrame = textureStreamer.frame;
+}
+
+void texstream::update(streamer& textureStreamer)
+{
+    std::vector<decoded> finished;
+    {
+        std::lock_guard<std::mutex> lock(textureStreamer.mutex);
+        finished.swap(textureStreamer.finished);
+    }
+
+    //the tail goes up as soon as the decode is done, it is small and replaces the placeholder
+    for (auto& result : finished) {
+        texture& streamed = textureStreamer.textures[result.id];
+        streamed.decoding = false;
+        if (!result.error.empty()) {
+            throw std::runtime_error("failed to load streamed texture " + streamed.name + ": " + result.error);
+        }
+
+        streamed.mips = std::move(result.mips);
+        streamed.tailMip = static_cast<uint32_t>(streamed.mips.size()) - 1;
+        while (streamed.tailMip > 0 && std::max(streamed.mips[streamed.tailMip - 1].width, streamed.mips[streamed.tailMip - 1].height) <= TAIL_SIZE) {
+            streamed.tailMip--;
+        }
+
+        if (streamed.placeholder) {
+            replaceGeneration(textureStreamer, streamed, streamed.tailMip);
+        }
+    }
+
+    //textures drawn most recently get the upload bandwidth and budget first
+    std::vector<uint32_t> order(textureStreamer.textures.size());
+    for (uint32_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&textureStreamer](uint32_t a, uint32_t b) {
+        return textureStreamer.textures[a].lastUsedFrame > textureStreamer.textures[b].lastUsedFrame;
+    });
+
+    VkDeviceSize uploadedBytes = 0;
+    for (uint32_t id : order) {
+        texture& streamed = textureStreamer.textures[id];
+        if (streamed.placeholder) {
+            continue;
+        }
+
+        bool used = streamed.lastUsedFrame != 0 && textureStreamer.frame - streamed.lastUsedFrame <= IDLE_FRAMES;
+        if (!used) {
+            if (streamed.current.firstMip < streamed.tailMip) {
+                replaceGeneration(textureStreamer, streamed, streamed.tailMip);
+                releaseHostLevels(streamed);
+                textureStreamer.evictions++;
+            }
+            continue;
+        }
+
+        if (streamed.current.firstMip == 0) {
+            continue;
+        }
+
+        uint32_t nextMip = streamed.current.firstMip - 1;
+        if (streamed.mips[nextMip].texels.empty()) {
+            if (!streamed.decoding) {
+                requestDecode(textureStreamer, id);
+            }
+            continue;
+        }
+
+        VkDeviceSize nextBytes = chainBytes(streamed.mips, nextMip);
+        if (textureStreamer.residentBytes - streamed.current.bytes + nextBytes > textureStreamer.budget) {
+            continue;
+        }
+        VkDeviceSize stagedBytes = uploadBytes(streamed, nextMip);
+        if (uploadedBytes != 0 && uploadedBytes + stagedBytes > textureStreamer.uploadBytesPerFrame) {
+            continue;
+        }
+
+        replaceGeneration(textureStreamer, streamed, nextMip);
+        uploadedBytes += stagedBytes;
+        textureStreamer.upgrades++;
+
+        if (nextMip == 0) {
+            releaseHostLevels(streamed);
+        }
+    }
+
+    //the generations created since the last submit, the placeholders from add() among them, went out in this batch
+    upload::ticket written = upload::submit(*textureStreamer.uploadContext);
+    for (auto& streamed : textureStreamer.textures) {
+        if (streamed.current.written == UNSUBMITTED) {
+            streamed.current.written = written;
+        }
+    }
+    for (auto& retiredGeneration : textureStreamer.retired) {
+        if (retiredGeneration.written == UNSUBMITTED) {
+            retiredGeneration.written = written;
+        }
+    }
+    collectRetired(textureStreamer);
+
+    textureStreamer.frame++;
+}
+
+VkImageView texstream::currentView(const streamer& textureStreamer, uint32_t id)
+{
+    return textureStreamer.textures[id].current.view;
+}
+
+void texstream::resetBindings(streamer& textureStreamer, uint32_t frameCount)
+{
+    for (auto& streamed : textureStreamer.textures) {
+        streamed.boundViews.assign(frameCount, VK_NULL_HANDLE);
+    }
+    collectRetired(textureStreamer);
+}
+
+void texstream::markBound(streamer& textureStreamer, uint32_t frame)
+{
+    for (auto& streamed : textureStreamer.textures) {
+        streamed.boundViews[frame] = streamed.current.view;
+    }
+}
+
+bool texstream::updateDescriptors(streamer& textureStreamer, uint32_t frame, VkDescriptorSet descriptorSet)
+{
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    imageInfos.reserve(textureStreamer.textures.size()); //the writes point into it
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+    for (auto& streamed : textureStreamer.textures) {
+        if (streamed.boundViews[frame] == streamed.current.view) {
+            continue;
+        }
+
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = streamed.current.view;
+        imageInfo.sampler = streamed.sampler;
+        imageInfos.push_back(imageInfo);
+
+        VkWriteDescriptorSet descriptorWrite = {};
+        descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrite.dstSet = descriptorSet;
+        descriptorWrite.dstBinding = streamed.binding;
+        descriptorWrite.dstArrayElement = streamed.arrayElement;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrite.descriptorCount = 1;
+        descriptorWrite.pImageInfo = &imageInfos.back();
+        descriptorWrites.push_back(descriptorWrite);
+
+        streamed.boundViews[frame] = streamed.current.view;
+    }
+
+    if (descriptorWrites.empty()) {
+        return false;
+    }
+
+    vkUpdateDescriptorSets(textureStreamer.device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    collectRetired(textureStreamer);
+    return true;
+}
+
+void texstream::printStats(const streamer& textureStreamer)
+{
+    std::cout << "texture streaming: " << textureStreamer.residentBytes / 1024 << " KB resident of " << textureStreamer.budget / 1024 << " KB budget, "
+        << textureStreamer.upgrades << " upgrades, " << textureStreamer.evictions << " evictions" << std::endl;
+
+    for (const auto& streamed : textureStreamer.textures) {
+        std::cout << "    " << streamed.name << ": ";
+        if (streamed.placeholder) {
+            std::cout << "placeholder" << std::endl;
+            continue;
+        }
+        const mipLevel& top = streamed.mips[streamed.current.firstMip];
+        std::cout << top.width << "x" << top.height << " from mip " << streamed.current.firstMip << " of " << streamed.mips.size()
+            << ", " << streamed.current.bytes / 1024 << " KB" << std::endl;
+    }
+}
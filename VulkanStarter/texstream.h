@@ -0,0 +1,135 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "memalloc.h"
+#include "upload.h"
+
+// Progressive texture streaming. A texture starts as a 1x1 placeholder so the first frame never waits on it.
+// A worker thread decodes it, then the mip tail (every level no larger than TAIL_SIZE) is uploaded, and the
+// texture grows one mip level per frame while it is in use and the memory budget allows.
+// Each change of residency builds a new image holding exactly the resident levels. Descriptors switch to it per frame
+// in flight once that slot's last frame has completed, and the old image is destroyed once no descriptor set references
+// it and the upload batch that wrote it has executed.
+// Textures left unused for IDLE_FRAMES frames drop back to their tail.
+// Loaders may return fewer levels than a full chain, the rest is filtered on the worker with mipgen. Where the format
+// allows linear blits only the top resident level is uploaded and the GPU blits the levels below it.
+namespace texstream
+{
+    const uint32_t TAIL_SIZE = 64;          // levels this size and smaller are always resident once loaded
+    const uint64_t IDLE_FRAMES = 300;       // frames without touch() before a texture counts as unused
+    const upload::ticket UNSUBMITTED = UINT64_MAX;  // recorded into the open upload batch, tagged when update() submits it
+
+    struct mipLevel
+    {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> texels;        // RGBA8 texels or 4x4 blocks in the texture's format, empty once dropped from host memory
+    };
+
+    // Decodes the levels of a texture, largest first, at least level 0. Runs on the worker thread.
+    typedef std::function<std::vector<mipLevel>()> loader;
+
+    struct generation
+    {
+        VkImage image = VK_NULL_HANDLE;
+        memalloc::allocation memory;
+        VkImageView view = VK_NULL_HANDLE;
+        uint32_t firstMip = 0;              // texture level held in the image's level 0
+        VkDeviceSize bytes = 0;
+        upload::ticket written = UNSUBMITTED;   // batch that uploads it, destroyed only once that has executed
+    };
+
+    struct texture
+    {
+        std::string name;
+        VkFormat format;
+        VkComponentMapping swizzle;         // applied by the views, lets two channel formats feed RGBA shaders
+        loader load;
+        VkSampler sampler;
+        uint32_t binding;                   // combined image sampler the texture is written to
+        uint32_t arrayElement;
+        bool blitMips;                      // upload the top level only and blit the others
+
+        std::vector<mipLevel> mips;         // empty until the first decode finishes
+        uint32_t tailMip = 0;
+        bool decoding = false;
+        bool placeholder = true;            // current holds the 1x1 placeholder
+        generation current;
+        uint64_t lastUsedFrame = 0;
+        std::vector<VkImageView> boundViews;    // view written to each frame in flight's descriptor set
+    };
+
+    struct decoded
+    {
+        uint32_t id;
+        std::vector<mipLevel> mips;
+        std::string error;
+    };
+
+    struct streamer
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+        memalloc::allocator* memoryAllocator = nullptr;
+        upload::context* uploadContext = nullptr;
+        VkDeviceSize budget = 0;                // device memory for all resident levels
+        VkDeviceSize uploadBytesPerFrame = 0;   // upgrades stop for the frame once this much has been staged
+        VkDeviceSize residentBytes = 0;
+        uint64_t frame = 1;
+
+        std::vector<texture> textures;
+        std::vector<generation> retired;        // replaced, destroyed once no descriptor set binds their view and their upload is done
+
+        std::thread worker;
+        std::mutex mutex;                       // guards everything below
+        std::condition_variable wake;
+        bool stopping = false;
+        std::deque<std::pair<uint32_t, loader>> requests;
+        std::vector<decoded> finished;
+
+        uint32_t upgrades = 0;
+        uint32_t evictions = 0;
+    };
+
+    // Starts the worker thread.
+    void init(streamer&, VkPhysicalDevice, VkDevice, memalloc::allocator&, upload::context&, VkDeviceSize budget, VkDeviceSize uploadBytesPerFrame);
+
+    // Stops the worker and destroys every image, the device must be idle.
+    void destroy(streamer&);
+
+    // Registers a texture with a 1x1 placeholder (packed RGBA as the shader sees it, red in the low byte) and queues its decode.
+    uint32_t add(streamer&, const std::string& name, VkFormat, VkComponentMapping swizzle, uint32_t placeholder, VkSampler, uint32_t binding, uint32_t arrayElement, loader);
+
+    // Appends the levels below the last one down to 1x1, RGBA8 only.
+    void completeChain(std::vector<mipLevel>&, bool srgb);
+
+    // Marks the texture as drawn this frame.
+    void touch(streamer&, uint32_t id);
+
+    // Applies finished decodes, uploads at most one new level per texture, evicts unused textures and submits the uploads.
+    void update(streamer&);
+
+    // View to write when a descriptor set is created.
+    VkImageView currentView(const streamer&, uint32_t id);
+
+    // Forgets all bindings, for when the descriptor sets are recreated with one set per frame in flight. The device must be idle.
+    void resetBindings(streamer&, uint32_t frameCount);
+
+    // Records that the set of this frame in flight was written with every texture's current view.
+    void markBound(streamer&, uint32_t frame);
+
+    // Rewrites the textures whose view changed into the set of this frame in flight, call once the slot's last frame
+    // has completed. Returns true when the set was written, command buffers that bound it have to be recorded again.
+    bool updateDescriptors(streamer&, uint32_t frame, VkDescriptorSet);
+
+    void printStats(const streamer&);
+}
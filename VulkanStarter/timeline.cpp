@@ -0,0 +1,194 @@
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <chrono>
+
+#include "timeline.h"
+
+using namespace timeline;
+
+namespace
+{
+    value readCounter(scheduler& frameTimeline)
+    {
+        value counter;
+        if (frameTimeline.getCounterValue(frameTimeline.device, frameTimeline.semaphore, &counter) != VK_SUCCESS) {
+            throw std::runtime_error("failed to read timeline semaphore!");
+        }
+        frameTimeline.completed = counter;
+        return counter;
+    }
+}
+
+void timeline::init(scheduler& frameTimeline, VkDevice device, uint32_t framesInFlight)
+{
+    frameTimeline.device = device;
+    frameTimeline.framesInFlight = framesInFlight;
+    frameTimeline.frame = 0;
+    frameTimeline.frameValues.assign(framesInFlight, 0);
+    frameTimeline.submitted = 0;
+    frameTimeline.completed = 0;
+
+    //the device was created against Vulkan 1.0, the extension's entry points are not exported by the loader
+    frameTimeline.waitSemaphores = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+    frameTimeline.getCounterValue = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+    if (frameTimeline.waitSemaphores == nullptr || frameTimeline.getCounterValue == nullptr) {
+        throw std::runtime_error("failed to load timeline semaphore functions!");
+    }
+
+    VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+    typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    typeInfo.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    semaphoreInfo.pNext = &typeInfo;
+
+    if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frameTimeline.semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore!");
+    }
+}
+
+void timeline::destroy(scheduler& frameTimeline)
+{
+    for (VkSemaphore semaphore : frameTimeline.freeSemaphores) {
+        vkDestroySemaphore(frameTimeline.device, semaphore, nullptr);
+    }
+    for (VkSemaphore semaphore : frameTimeline.usedSemaphores) {
+        vkDestroySemaphore(frameTimeline.device, semaphore, nullptr);
+    }
+    frameTimeline.freeSemaphores.clear();
+    frameTimeline.usedSemaphores.clear();
+    frameTimeline.usedValues.clear();
+
+    vkDestroySemaphore(frameTimeline.device, frameTimeline.semaphore, nullptr);
+    frameTimeline.semaphore = VK_NULL_HANDLE;
+}
+
+value timeline::submit(scheduler& frameTimeline, VkQueue queue, const VkSubmitInfo& submitInfo)
+{
+    value signalValue = frameTimeline.submitted + 1;
+
+    //the timeline goes last, the binary semaphores ignore their values
+    std::vector<VkSemaphore> signalSemaphores(submitInfo.pSignalSemaphores, submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+    signalSemaphores.push_back(frameTimeline.semaphore);
+    std::vector<value> signalValues(signalSemaphores.size(), 0);
+    signalValues.back() = signalValue;
+
+    VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+    timelineInfo.pNext = submitInfo.pNext;
+    timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+    VkSubmitInfo timelineSubmit = submitInfo;
+    timelineSubmit.pNext = &timelineInfo;
+    timelineSubmit.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+    timelineSubmit.pSignalSemaphores = signalSemaphores.data();
+
+    if (vkQueueSubmit(queue, 1, &timelineSubmit, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit to the timeline!");
+    }
+
+    //values are only ever signalled from the one graphics queue, so they complete in this order
+    frameTimeline.submitted = signalValue;
+    return signalValue;
+}
+
+bool timeline::reached(scheduler& frameTimeline, value target)
+{
+    if (target <= frameTimeline.completed) {
+        return true;
+    }
+    return readCounter(frameTimeline) >= target;
+}
+
+void timeline::wait(scheduler& frameTimeline, value target)
+{
+    if (reached(frameTimeline, target)) {
+        frameTimeline.stats.skipped++;
+        return;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    VkSemaphoreWaitInfoKHR waitInfo = {};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &frameTimeline.semaphore;
+    waitInfo.pValues = &target;
+
+    if (frameTimeline.waitSemaphores(frameTimeline.device, &waitInfo, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for timeline semaphore!");
+    }
+    readCounter(frameTimeline);
+
+    frameTimeline.stats.waits++;
+    frameTimeline.stats.waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+uint32_t timeline::beginFrame(scheduler& frameTimeline)
+{
+    wait(frameTimeline, frameTimeline.frameValues[frameTimeline.frame]);
+    return frameTimeline.frame;
+}
+
+value timeline::submitFrame(scheduler& frameTimeline, VkQueue queue, const VkSubmitInfo& submitInfo)
+{
+    value frameValue = submit(frameTimeline, queue, submitInfo);
+    frameTimeline.frameValues[frameTimeline.frame] = frameValue;
+    frameTimeline.frame = (frameTimeline.frame + 1) % frameTimeline.framesInFlight;
+    frameTimeline.stats.frames++;
+    return frameValue;
+}
+
+VkSemaphore timeline::acquireSemaphore(scheduler& frameTimeline)
+{
+    //recycles those whose waits have executed, one counter read covers them all
+    for (size_t i = 0; i < frameTimeline.usedSemaphores.size();) {
+        if (reached(frameTimeline, frameTimeline.usedValues[i])) {
+            frameTimeline.freeSemaphores.push_back(frameTimeline.usedSemaphores[i]);
+            frameTimeline.usedSemaphores.erase(frameTimeline.usedSemaphores.begin() + i);
+            frameTimeline.usedValues.erase(frameTimeline.usedValues.begin() + i);
+        }
+        else {
+            i++;
+        }
+    }
+
+    if (!frameTimeline.freeSemaphores.empty()) {
+        VkSemaphore semaphore = frameTimeline.freeSemaphores.back();
+        frameTimeline.freeSemaphores.pop_back();
+        return semaphore;
+    }
+
+    //every one is still waited on by a frame in flight, the pool grows to a few more than framesInFlight
+    VkSemaphoreCreateInfo semaphoreInfo = {};
+    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+    VkSemaphore semaphore;
+    if (vkCreateSemaphore(frameTimeline.device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create acquire semaphore!");
+    }
+    return semaphore;
+}
+
+void timeline::releaseSemaphore(scheduler& frameTimeline, VkSemaphore semaphore, value waitedBy)
+{
+    if (waitedBy == 0) {
+        frameTimeline.freeSemaphores.push_back(semaphore);
+        return;
+    }
+    frameTimeline.usedSemaphores.push_back(semaphore);
+    frameTimeline.usedValues.push_back(waitedBy);
+}
+
+void timeline::printStats(const scheduler& frameTimeline)
+{
+    double frameMilliseconds = frameTimeline.stats.frames > 0 ? frameTimeline.stats.waitMilliseconds / frameTimeline.stats.frames : 0.0;
+    std::cout << "timeline: " << frameTimeline.stats.frames << " frames, " << frameTimeline.framesInFlight << " in flight, "
+        << frameTimeline.submitted << " submits, " << frameTimeline.stats.waits << " blocking waits and " << frameTimeline.stats.skipped << " skipped, "
+        << std::fixed << std::setprecision(3) << frameMilliseconds << " ms blocked per frame, "
+        << frameTimeline.freeSemaphores.size() + frameTimeline.usedSemaphores.size() << " acquire semaphores" << std::endl;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+// Frame pacing on one timeline semaphore. Every submit to the graphics queue, frames and upload batches alike, signals
+// the next value of the timeline, and whatever the GPU reads is tagged with the value of the last submit reading it.
+// The host only blocks when it is about to reuse something whose value the GPU has not reached yet: a frame slot's
+// command pools and descriptor set, a uniform slice, a swap chain image's feedback buffer, an upload batch's staging
+// memory. Work that touches none of these, acquiring, streaming and collecting pipelines, runs ahead of any wait.
+// Presentation cannot wait on a timeline, so acquiring and presenting keep binary semaphores. The acquire semaphores
+// are recycled once the submit that waited on them has completed.
+namespace timeline
+{
+    typedef uint64_t value;
+
+    struct schedulerStats
+    {
+        uint64_t frames = 0;
+        uint64_t waits = 0;                     // waits that blocked, a reused resource was still in use
+        uint64_t skipped = 0;                   // waits whose value had already been reached
+        double waitMilliseconds = 0.0;
+    };
+
+    struct scheduler
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        PFN_vkWaitSemaphoresKHR waitSemaphores = nullptr;
+        PFN_vkGetSemaphoreCounterValueKHR getCounterValue = nullptr;
+
+        uint32_t framesInFlight = 1;
+        uint32_t frame = 0;                     // slot of the frame being recorded
+        std::vector<value> frameValues;         // value of each slot's last frame
+        value submitted = 0;                    // last value a submit signals
+        value completed = 0;                    // last value the counter was seen at
+
+        std::vector<VkSemaphore> freeSemaphores;
+        std::vector<VkSemaphore> usedSemaphores;    // binary, waited on by the submits below
+        std::vector<value> usedValues;
+
+        schedulerStats stats;
+    };
+
+    // Creates the timeline semaphore, VK_KHR_timeline_semaphore must be enabled on the device.
+    void init(scheduler&, VkDevice, uint32_t framesInFlight);
+
+    // Destroys the semaphores, the device must be idle.
+    void destroy(scheduler&);
+
+    // Submits to the queue, signalling the next value besides the submit's own semaphores. Returns the value.
+    value submit(scheduler&, VkQueue, const VkSubmitInfo&);
+
+    // True once the GPU has reached the value, reads the counter only when the last read is behind it.
+    bool reached(scheduler&, value);
+
+    // Blocks until the GPU has reached the value.
+    void wait(scheduler&, value);
+
+    // Waits for the last frame of the next slot and returns the slot.
+    uint32_t beginFrame(scheduler&);
+
+    // Submits the slot's frame and tags the slot with its value.
+    value submitFrame(scheduler&, VkQueue, const VkSubmitInfo&);
+
+    // A binary semaphore no pending submit waits on, for vkAcquireNextImageKHR.
+    VkSemaphore acquireSemaphore(scheduler&);
+
+    // Hands the semaphore back once the submit with this value has waited on it, 0 when nothing did.
+    void releaseSemaphore(scheduler&, VkSemaphore, value);
+
+    void printStats(const scheduler&);
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <stdexcept>
+#include <cstring>
+
+#include "uniforms.h"
+
+using namespace uniforms;
+
+namespace
+{
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void uniforms::init(ring& uniformRing, VkPhysicalDevice physicalDevice, VkDevice device, memalloc::allocator& memoryAllocator, timeline::scheduler& frameTimeline, uint32_t frameCount)
+{
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uniformRing.device = device;
+    uniformRing.memoryAllocator = &memoryAllocator;
+    uniformRing.frameTimeline = &frameTimeline;
+    uniformRing.alignment = properties.limits.minUniformBufferOffsetAlignment > 0 ? properties.limits.minUniformBufferOffsetAlignment : 1;
+    uniformRing.frameCount = frameCount;
+    uniformRing.frame = 0;
+    uniformRing.frameSize = 0;
+    uniformRing.sliceValues.assign(frameCount, 0);
+}
+
+uint32_t uniforms::addBlock(ring& uniformRing, VkDeviceSize size)
+{
+    if (uniformRing.buffer != VK_NULL_HANDLE) {
+        throw std::runtime_error("failed to add uniform block, the ring is already created!");
+    }
+
+    block uniformBlock;
+    uniformBlock.offset = uniformRing.frameSize;
+    uniformBlock.size = size;
+    uniformRing.blocks.push_back(uniformBlock);
+
+    uniformRing.frameSize = alignUp(uniformRing.frameSize + size, uniformRing.alignment); //keeps the next block and the next slice aligned
+    return static_cast<uint32_t>(uniformRing.blocks.size() - 1);
+}
+
+void uniforms::create(ring& uniformRing)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = uniformRing.frameSize * uniformRing.frameCount;
+    bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(uniformRing.device, &bufferInfo, nullptr, &uniformRing.buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create uniform ring buffer!");
+    }
+
+    uniformRing.memory = memalloc::allocateForBuffer(*uniformRing.memoryAllocator, uniformRing.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    uniformRing.written.assign(uniformRing.blocks.size() * uniformRing.frameCount, std::vector<uint8_t>());
+}
+
+void uniforms::destroy(ring& uniformRing)
+{
+    vkDestroyBuffer(uniformRing.device, uniformRing.buffer, nullptr);
+    memalloc::free(*uniformRing.memoryAllocator, uniformRing.memory);
+    uniformRing.buffer = VK_NULL_HANDLE;
+    uniformRing.blocks.clear();
+    uniformRing.written.clear();
+}
+
+void uniforms::beginFrame(ring& uniformRing, uint32_t frame)
+{
+    uniformRing.frame = frame % uniformRing.frameCount;
+    timeline::wait(*uniformRing.frameTimeline, uniformRing.sliceValues[uniformRing.frame]);
+}
+
+void uniforms::endFrame(ring& uniformRing, timeline::value frameValue)
+{
+    uniformRing.sliceValues[uniformRing.frame] = frameValue;
+}
+
+void uniforms::write(ring& uniformRing, uint32_t blockIndex, const void* data)
+{
+    const block& uniformBlock = uniformRing.blocks[blockIndex];
+    std::vector<uint8_t>& written = uniformRing.written[uniformRing.frame * uniformRing.blocks.size() + blockIndex];
+
+    //comparing against the cached copy is cheaper than writing the mapped memory, which is often write combined
+    if (!written.empty() && memcmp(written.data(), data, uniformBlock.size) == 0) {
+        uniformRing.stats.unchanged++;
+        return;
+    }
+
+    written.assign(static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + uniformBlock.size);
+
+    uint8_t* slice = static_cast<uint8_t*>(uniformRing.memory.mapped) + uniformRing.frame * uniformRing.frameSize;
+    memcpy(slice + uniformBlock.offset, data, uniformBlock.size);
+
+    uniformRing.stats.writes++;
+    uniformRing.stats.bytes += uniformBlock.size;
+}
+
+uint32_t uniforms::frameOffset(const ring& uniformRing)
+{
+    return static_cast<uint32_t>(uniformRing.frame * uniformRing.frameSize);
+}
+
+VkDescriptorBufferInfo uniforms::bufferInfo(const ring& uniformRing, uint32_t blockIndex)
+{
+    VkDescriptorBufferInfo info = {};
+    info.buffer = uniformRing.buffer;
+    info.offset = uniformRing.blocks[blockIndex].offset;
+    info.range = uniformRing.blocks[blockIndex].size;
+    return info;
+}
+
+void uniforms::printStats(const ring& uniformRing)
+{
+    std::cout << "uniforms: " << uniformRing.stats.writes << " block writes (" << uniformRing.stats.bytes / 1024 << " KB), "
+        << uniformRing.stats.unchanged << " unchanged blocks skipped, " << uniformRing.frameCount << " slices of " << uniformRing.frameSize << " bytes" << std::endl;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+#include "memalloc.h"
+#include "timeline.h"
+
+// Per frame uniform ring. Every uniform block gets a fixed offset inside a frame's slice of one persistently mapped
+// buffer, with one slice per frame in flight. Descriptors point at the first slice and draws select the current one
+// with a dynamic offset, so the descriptor sets never change and nothing is recreated with the swap chain.
+// A copy of what each slice last received is kept, blocks whose contents did not change are not written again.
+// Each slice is tagged with the timeline value of the last frame that read it and is only waited on when it comes round.
+namespace uniforms
+{
+    struct block
+    {
+        VkDeviceSize offset = 0;            // inside a frame's slice
+        VkDeviceSize size = 0;
+    };
+
+    struct ringStats
+    {
+        uint64_t writes = 0;
+        uint64_t unchanged = 0;             // writes skipped because the slice already held the same contents
+        VkDeviceSize bytes = 0;
+    };
+
+    struct ring
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        memalloc::allocator* memoryAllocator = nullptr;
+        timeline::scheduler* frameTimeline = nullptr;
+        VkDeviceSize alignment = 256;       // minUniformBufferOffsetAlignment
+        uint32_t frameCount = 0;
+        uint32_t frame = 0;                 // slice written and bound this frame
+        VkDeviceSize frameSize = 0;
+        std::vector<timeline::value> sliceValues;  // last frame to read each slice
+
+        VkBuffer buffer = VK_NULL_HANDLE;
+        memalloc::allocation memory;        // host visible and coherent, mapped for its lifetime
+
+        std::vector<block> blocks;
+        std::vector<std::vector<uint8_t>> written;  // last contents of each block in each slice, frame major, empty until written
+        ringStats stats;
+    };
+
+    void init(ring&, VkPhysicalDevice, VkDevice, memalloc::allocator&, timeline::scheduler&, uint32_t frameCount);
+
+    // Reserves a block in every slice, before create(). Returns the block.
+    uint32_t addBlock(ring&, VkDeviceSize size);
+
+    // Creates the buffer once every block is added.
+    void create(ring&);
+
+    void destroy(ring&);
+
+    // Selects the slice of this frame in flight, waiting for the last frame that read it.
+    void beginFrame(ring&, uint32_t frame);
+
+    // Tags the current slice with the value of the frame submit that reads it.
+    void endFrame(ring&, timeline::value);
+
+    // Copies a block's contents into the current slice unless it already holds them.
+    void write(ring&, uint32_t blockIndex, const void* data);
+
+    // Dynamic offset of the current slice, the same for every block.
+    uint32_t frameOffset(const ring&);
+
+    // Descriptor for the block in the first slice, bind it as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC.
+    VkDescriptorBufferInfo bufferInfo(const ring&, uint32_t blockIndex);
+
+    void printStats(const ring&);
+}
@@ -0,0 +1,503 @@
+#include <iostream>
+#include <iomanip>
+#include <stdexcept>
+#include <chrono>
+#include <cstring>
+
+#include "upload.h"
+#include "mipgen.h"
+
+using namespace upload;
+
+namespace
+{
+    // satisfies the bufferOffset rules of vkCmdCopyBufferToImage for every colour format used here
+    const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+    VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    void createStagingBuffer(context& ctx, VkDeviceSize size, VkBuffer& buffer, memalloc::allocation& memory)
+    {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(ctx.device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create staging buffer!");
+        }
+
+        memory = memalloc::allocateForBuffer(*ctx.memoryAllocator, buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+
+    VkCommandBuffer allocateCommandBuffer(context& ctx, VkCommandPool commandPool)
+    {
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandPool = commandPool;
+        allocInfo.commandBufferCount = 1;
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(ctx.device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate upload command buffer!");
+        }
+        return commandBuffer;
+    }
+
+    void beginCommandBuffer(VkCommandBuffer commandBuffer)
+    {
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+            throw std::runtime_error("failed to begin upload command buffer!");
+        }
+    }
+
+    // opens a batch, reusing retired command buffers when there are some
+    void beginBatch(context& ctx)
+    {
+        if (ctx.recording.commandBuffer != VK_NULL_HANDLE)
+            return;
+
+        if (!ctx.freeBatches.empty()) {
+            ctx.recording = ctx.freeBatches.back();
+            ctx.freeBatches.pop_back();
+        }
+        else {
+            ctx.recording.commandBuffer = allocateCommandBuffer(ctx, ctx.commandPool);
+            ctx.recording.transferCommandBuffer = ctx.recording.commandBuffer;
+
+            if (ctx.dedicatedTransfer) {
+                ctx.recording.transferCommandBuffer = allocateCommandBuffer(ctx, ctx.transferCommandPool);
+                ctx.recording.acquireCommandBuffer = allocateCommandBuffer(ctx, ctx.commandPool);
+
+                VkSemaphoreCreateInfo semaphoreInfo = {};
+                semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+                if (vkCreateSemaphore(ctx.device, &semaphoreInfo, nullptr, &ctx.recording.transferComplete) != VK_SUCCESS) {
+                    throw std::runtime_error("failed to create upload semaphore!");
+                }
+            }
+        }
+
+        beginCommandBuffer(ctx.recording.commandBuffer);
+        if (ctx.dedicatedTransfer) {
+            beginCommandBuffer(ctx.recording.transferCommandBuffer);
+        }
+    }
+
+    // hands a buffer range written on the transfer queue over to the graphics family
+    void transferBufferOwnership(context& ctx, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size)
+    {
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = ctx.transferFamily;
+        barrier.dstQueueFamilyIndex = ctx.graphicsFamily;
+        barrier.buffer = buffer;
+        barrier.offset = offset;
+        barrier.size = size;
+        ctx.recording.bufferOwnership.push_back(barrier);
+        ctx.stats.ownershipTransfers++;
+    }
+
+    void retireBatch(context& ctx, batch& finished)
+    {
+        for (size_t i = 0; i < finished.overflowBuffers.size(); i++) {
+            vkDestroyBuffer(ctx.device, finished.overflowBuffers[i], nullptr);
+            memalloc::free(*ctx.memoryAllocator, finished.overflowMemory[i]);
+        }
+        finished.overflowBuffers.clear();
+        finished.overflowMemory.clear();
+        finished.bufferOwnership.clear();
+        finished.imageOwnership.clear();
+
+        ctx.completedTicket = finished.id;
+        ctx.freeBatches.push_back(finished);
+    }
+
+    // retires finished batches in submission order, blocking on those up to waitFor
+    void retire(context& ctx, ticket waitFor)
+    {
+        while (!ctx.inFlight.empty()) {
+            batch& oldest = ctx.inFlight.front();
+
+            if (!timeline::reached(*ctx.frameTimeline, oldest.id)) {
+                if (oldest.id > waitFor) {
+                    break;
+                }
+
+                auto start = std::chrono::high_resolution_clock::now();
+                timeline::wait(*ctx.frameTimeline, oldest.id);
+                ctx.stats.waits++;
+                ctx.stats.waitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            }
+
+            retireBatch(ctx, oldest);
+            ctx.inFlight.erase(ctx.inFlight.begin());
+        }
+
+        //nothing references the arena any more
+        if (ctx.inFlight.empty() && ctx.recording.commandBuffer == VK_NULL_HANDLE) {
+            ctx.stagingHead = 0;
+        }
+    }
+
+    void submitIfImmediate(context& ctx)
+    {
+        if (ctx.immediate) {
+            wait(ctx, submit(ctx));
+        }
+    }
+}
+
+void upload::init(context& ctx, memalloc::allocator& memoryAllocator, timeline::scheduler& frameTimeline, VkDevice device, VkQueue graphicsQueue, uint32_t graphicsFamily, VkQueue transferQueue, uint32_t transferFamily, VkDeviceSize arenaSize, bool immediate)
+{
+    ctx.device = device;
+    ctx.graphicsQueue = graphicsQueue;
+    ctx.transferQueue = transferQueue;
+    ctx.graphicsFamily = graphicsFamily;
+    ctx.transferFamily = transferFamily;
+    ctx.dedicatedTransfer = (transferFamily != graphicsFamily);
+    ctx.memoryAllocator = &memoryAllocator;
+    ctx.frameTimeline = &frameTimeline;
+    ctx.immediate = immediate;
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; //batches are re-recorded after they retire
+    poolInfo.queueFamilyIndex = graphicsFamily;
+
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &ctx.commandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool!");
+    }
+
+    if (ctx.dedicatedTransfer) {
+        poolInfo.queueFamilyIndex = transferFamily;
+
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &ctx.transferCommandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload command pool!");
+        }
+    }
+
+    createStagingBuffer(ctx, arenaSize, ctx.stagingBuffer, ctx.stagingMemory);
+    ctx.stagingHead = 0;
+}
+
+void upload::destroy(context& ctx)
+{
+    flush(ctx);
+
+    for (batch& idle : ctx.freeBatches) {
+        if (idle.transferComplete != VK_NULL_HANDLE) {
+            vkDestroySemaphore(ctx.device, idle.transferComplete, nullptr);
+        }
+    }
+    ctx.freeBatches.clear();
+
+    vkDestroyCommandPool(ctx.device, ctx.commandPool, nullptr); //frees the command buffers
+    if (ctx.transferCommandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(ctx.device, ctx.transferCommandPool, nullptr);
+    }
+    vkDestroyBuffer(ctx.device, ctx.stagingBuffer, nullptr);
+    memalloc::free(*ctx.memoryAllocator, ctx.stagingMemory);
+}
+
+VkCommandBuffer upload::commands(context& ctx)
+{
+    beginBatch(ctx);
+    return ctx.recording.commandBuffer;
+}
+
+void* upload::stage(context& ctx, VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset)
+{
+    ctx.stats.bytes += size;
+
+    //bigger than the whole arena, gets its own buffer that lives until the batch retires
+    if (size > ctx.stagingMemory.size) {
+        beginBatch(ctx);
+
+        memalloc::allocation memory;
+        createStagingBuffer(ctx, size, buffer, memory);
+        ctx.recording.overflowBuffers.push_back(buffer);
+        ctx.recording.overflowMemory.push_back(memory);
+
+        offset = 0;
+        return memory.mapped;
+    }
+
+    VkDeviceSize start = alignUp(ctx.stagingHead, STAGING_ALIGNMENT);
+    if (start + size > ctx.stagingMemory.size) {
+        retire(ctx, 0);
+
+        //arena still full, drain everything so it can rewind
+        if (ctx.stagingHead != 0) {
+            flush(ctx);
+        }
+        start = 0;
+    }
+
+    beginBatch(ctx);
+
+    ctx.stagingHead = start + size;
+    buffer = ctx.stagingBuffer;
+    offset = start;
+    return static_cast<char*>(ctx.stagingMemory.mapped) + start;
+}
+
+void upload::copyToBuffer(context& ctx, const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset)
+{
+    VkBuffer staging;
+    VkDeviceSize stagingOffset;
+    memcpy(stage(ctx, size, staging, stagingOffset), data, static_cast<size_t>(size));
+
+    VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset = stagingOffset;
+    copyRegion.dstOffset = dstOffset;
+    copyRegion.size = size;
+    vkCmdCopyBuffer(ctx.recording.transferCommandBuffer, staging, dst, 1, &copyRegion);
+
+    if (ctx.dedicatedTransfer) {
+        transferBufferOwnership(ctx, dst, dstOffset, size);
+    }
+
+    ctx.stats.copies++;
+    submitIfImmediate(ctx);
+}
+
+void upload::copyToImage(context& ctx, VkBuffer staging, VkDeviceSize stagingOffset, VkImage image, const std::vector<VkBufferImageCopy>& regions)
+{
+    std::vector<VkBufferImageCopy> offsetRegions = regions;
+    for (VkBufferImageCopy& region : offsetRegions) {
+        region.bufferOffset += stagingOffset;
+    }
+
+    beginBatch(ctx);
+    vkCmdCopyBufferToImage(ctx.recording.transferCommandBuffer, staging, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(offsetRegions.size()), offsetRegions.data());
+
+    ctx.stats.copies++;
+    submitIfImmediate(ctx);
+}
+
+void upload::transitionImage(context& ctx, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    VkPipelineStageFlags sourceStage;
+    VkPipelineStageFlags destinationStage;
+
+    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+        //the layout change happens as part of the release to the graphics family, recorded at submit
+        if (ctx.dedicatedTransfer) {
+            beginBatch(ctx);
+            barrier.srcQueueFamilyIndex = ctx.transferFamily;
+            barrier.dstQueueFamilyIndex = ctx.graphicsFamily;
+            ctx.recording.imageOwnership.push_back(barrier);
+            ctx.stats.ownershipTransfers++;
+            ctx.stats.transitions++;
+            submitIfImmediate(ctx);
+            return;
+        }
+    }
+    else {
+        throw std::invalid_argument("unsupported layout transition!");
+    }
+
+    beginBatch(ctx);
+    vkCmdPipelineBarrier(ctx.recording.transferCommandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    ctx.stats.transitions++;
+    submitIfImmediate(ctx);
+}
+
+void upload::generateMipmaps(context& ctx, VkImage image, uint32_t width, uint32_t height, uint32_t mipLevels)
+{
+    //blits need the graphics queue, the image moves over in TRANSFER_DST with its level 0 written
+    if (ctx.dedicatedTransfer) {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcQueueFamilyIndex = ctx.transferFamily;
+        barrier.dstQueueFamilyIndex = ctx.graphicsFamily;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        beginBatch(ctx);
+        ctx.recording.imageOwnership.push_back(barrier);
+        ctx.stats.ownershipTransfers++;
+    }
+
+    mipgen::recordBlits(commands(ctx), image, width, height, mipLevels);
+
+    ctx.stats.blits += mipLevels - 1;
+    ctx.stats.transitions++;
+    submitIfImmediate(ctx);
+}
+
+ticket upload::submit(context& ctx)
+{
+    if (ctx.recording.commandBuffer == VK_NULL_HANDLE) {
+        return ctx.lastTicket;
+    }
+
+    batch& submitted = ctx.recording;
+
+    if (ctx.dedicatedTransfer) {
+        //release on the transfer queue: the writes only need to be made available, the acquire makes them visible
+        std::vector<VkBufferMemoryBarrier> bufferBarriers = submitted.bufferOwnership;
+        std::vector<VkImageMemoryBarrier> imageBarriers = submitted.imageOwnership;
+        for (VkBufferMemoryBarrier& release : bufferBarriers) {
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.dstAccessMask = 0;
+        }
+        for (VkImageMemoryBarrier& release : imageBarriers) {
+            release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            release.dstAccessMask = 0;
+        }
+
+        if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+            vkCmdPipelineBarrier(submitted.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+        }
+
+        if (vkEndCommandBuffer(submitted.transferCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record upload command buffer!");
+        }
+
+        VkSubmitInfo transferSubmit = {};
+        transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        transferSubmit.commandBufferCount = 1;
+        transferSubmit.pCommandBuffers = &submitted.transferCommandBuffer;
+        transferSubmit.signalSemaphoreCount = 1;
+        transferSubmit.pSignalSemaphores = &submitted.transferComplete;
+
+        if (vkQueueSubmit(ctx.transferQueue, 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("failed to submit upload command buffer!");
+        }
+
+        //acquire on the graphics queue, ahead of anything recorded through commands()
+        bufferBarriers = submitted.bufferOwnership;
+        imageBarriers = submitted.imageOwnership;
+        for (VkBufferMemoryBarrier& acquire : bufferBarriers) {
+            acquire.srcAccessMask = 0;
+            acquire.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        }
+        for (VkImageMemoryBarrier& acquire : imageBarriers) {
+            acquire.srcAccessMask = 0;
+            acquire.dstAccessMask = acquire.newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+        }
+
+        beginCommandBuffer(submitted.acquireCommandBuffer);
+        if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+            vkCmdPipelineBarrier(submitted.acquireCommandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+                0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+        }
+        if (vkEndCommandBuffer(submitted.acquireCommandBuffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to record upload command buffer!");
+        }
+    }
+
+    //copies and fills are made visible to every later consumer, images carry their own barriers
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(submitted.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    if (vkEndCommandBuffer(submitted.commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record upload command buffer!");
+    }
+
+    VkCommandBuffer graphicsCommands[] = { submitted.acquireCommandBuffer, submitted.commandBuffer };
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &submitted.commandBuffer;
+    if (ctx.dedicatedTransfer) {
+        submitInfo.commandBufferCount = 2;
+        submitInfo.pCommandBuffers = graphicsCommands;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &submitted.transferComplete;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+
+    //frames submitted after this one queue behind it, so a frame's value covers every upload before it
+    submitted.id = timeline::submit(*ctx.frameTimeline, ctx.graphicsQueue, submitInfo);
+    ctx.lastTicket = submitted.id;
+    ctx.inFlight.push_back(submitted);
+    ctx.recording = batch();
+    ctx.stats.submits++;
+
+    return ctx.inFlight.back().id;
+}
+
+bool upload::isComplete(context& ctx, ticket id)
+{
+    if (id > ctx.completedTicket) {
+        retire(ctx, 0);
+    }
+    return id <= ctx.completedTicket;
+}
+
+void upload::wait(context& ctx, ticket id)
+{
+    if (id > ctx.completedTicket) {
+        retire(ctx, id);
+    }
+}
+
+void upload::flush(context& ctx)
+{
+    wait(ctx, submit(ctx));
+}
+
+void upload::printStats(const context& ctx)
+{
+    std::cout << "uploads: " << std::fixed << std::setprecision(2)
+        << ctx.stats.bytes / (1024.0 * 1024.0) << " MB, "
+        << ctx.stats.copies << " copies, "
+        << ctx.stats.transitions << " transitions, "
+        << ctx.stats.blits << " mip blits, "
+        << ctx.stats.submits << " submits, "
+        << ctx.stats.waits << " waits (" << ctx.stats.waitMilliseconds << " ms blocked), "
+        << ctx.stats.ownershipTransfers << " ownership transfers"
+        << (ctx.dedicatedTransfer ? " [transfer queue]" : " [graphics queue]")
+        << (ctx.immediate ? " [immediate]" : "") << std::endl;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+#include "memalloc.h"
+#include "timeline.h"
+
+// Batched upload context. Staging copies, fills and layout transitions are recorded into one command buffer
+// and go to the GPU in a single submit, instead of one submit and vkQueueWaitIdle per copy.
+// Source data is copied into a persistently mapped staging arena that is reused once its batches retire.
+// submit() returns a ticket, the timeline value its graphics submit signals, callers only wait for it when they
+// actually need the results.
+// With a dedicated transfer queue family the copies run on the transfer queue, every destination is released to the
+// graphics family there and acquired again by a short graphics command buffer that waits on the transfer's semaphore.
+namespace upload
+{
+    typedef timeline::value ticket;
+
+    struct batch
+    {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;                 // graphics queue, the only command buffer without a dedicated transfer queue
+        VkCommandBuffer transferCommandBuffer = VK_NULL_HANDLE;         // transfer queue, same as commandBuffer without a dedicated transfer queue
+        VkCommandBuffer acquireCommandBuffer = VK_NULL_HANDLE;          // graphics queue, acquires the released resources ahead of commandBuffer
+        VkSemaphore transferComplete = VK_NULL_HANDLE;                  // signalled by the transfer submit, waited on by the graphics submit
+        ticket id = 0;                                                  // signalled by the graphics submit, which finishes last
+        std::vector<VkBuffer> overflowBuffers;                  // staging for uploads larger than the arena, freed when the batch retires
+        std::vector<memalloc::allocation> overflowMemory;
+        std::vector<VkBufferMemoryBarrier> bufferOwnership;             // queue family transfers recorded when the batch is submitted
+        std::vector<VkImageMemoryBarrier> imageOwnership;
+    };
+
+    struct uploadStats
+    {
+        VkDeviceSize bytes = 0;         // staged through the arena or overflow buffers
+        uint32_t copies = 0;
+        uint32_t transitions = 0;
+        uint32_t blits = 0;             // mip levels generated on the GPU
+        uint32_t submits = 0;
+        uint32_t ownershipTransfers = 0;
+        uint32_t waits = 0;             // blocking waits on the timeline
+        double waitMilliseconds = 0.0;
+    };
+
+    struct context
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        VkQueue graphicsQueue = VK_NULL_HANDLE;
+        VkQueue transferQueue = VK_NULL_HANDLE;
+        uint32_t graphicsFamily = 0;
+        uint32_t transferFamily = 0;
+        bool dedicatedTransfer = false;                         // transferFamily differs from graphicsFamily
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandPool transferCommandPool = VK_NULL_HANDLE;     // null without a dedicated transfer queue
+        memalloc::allocator* memoryAllocator = nullptr;
+        timeline::scheduler* frameTimeline = nullptr;
+        bool immediate = false;                                 // submit and wait after every command, the unbatched path, kept for comparison
+
+        VkBuffer stagingBuffer = VK_NULL_HANDLE;
+        memalloc::allocation stagingMemory;
+        VkDeviceSize stagingHead = 0;                           // first free byte, the arena rewinds when no batch is in flight
+
+        batch recording;                                        // commands not yet submitted, commandBuffer is null when empty
+        std::vector<batch> inFlight;                            // oldest first
+        std::vector<batch> freeBatches;                         // retired, command buffers ready for reuse
+        ticket lastTicket = 0;
+        ticket completedTicket = 0;
+
+        uploadStats stats;
+    };
+
+    // Creates the command pools and the staging arena. Pass the graphics queue as the transfer queue when there is no dedicated one.
+    void init(context&, memalloc::allocator&, timeline::scheduler&, VkDevice, VkQueue graphicsQueue, uint32_t graphicsFamily, VkQueue transferQueue, uint32_t transferFamily, VkDeviceSize arenaSize, bool immediate);
+
+    // Waits for every batch and releases all resources.
+    void destroy(context&);
+
+    // Graphics command buffer of the open batch, for commands the helpers below do not cover. These are batched even in
+    // immediate mode and execute after the batch's copies.
+    VkCommandBuffer commands(context&);
+
+    // Reserves size bytes of staging memory and returns the host pointer to fill, buffer and offset locate it for the copy.
+    void* stage(context&, VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset);
+
+    // Stages size bytes of data and records a copy into dst at dstOffset, dst must not be in use by the graphics queue.
+    void copyToBuffer(context&, const void* data, VkDeviceSize size, VkBuffer dst, VkDeviceSize dstOffset);
+
+    // Records a copy of staged memory into an image in TRANSFER_DST_OPTIMAL, region offsets are relative to stagingOffset.
+    void copyToImage(context&, VkBuffer staging, VkDeviceSize stagingOffset, VkImage, const std::vector<VkBufferImageCopy>& regions);
+
+    // Records a layout transition of the colour mips, supports UNDEFINED -> TRANSFER_DST and TRANSFER_DST -> SHADER_READ_ONLY.
+    void transitionImage(context&, VkImage, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
+
+    // Fills levels [1, mipLevels) of an image whose level 0 was copied in with linear blits on the graphics queue.
+    // Every level must be in TRANSFER_DST_OPTIMAL, they end in SHADER_READ_ONLY_OPTIMAL. Check mipgen::supportsLinearBlit first.
+    void generateMipmaps(context&, VkImage, uint32_t width, uint32_t height, uint32_t mipLevels);
+
+    // Submits the open batch and returns its ticket, returns the last ticket when nothing was recorded.
+    ticket submit(context&);
+
+    // Returns true once the batch with this ticket has executed, retires finished batches.
+    bool isComplete(context&, ticket);
+
+    // Blocks until the batch with this ticket has executed.
+    void wait(context&, ticket);
+
+    // Submits anything recorded and waits for all batches.
+    void flush(context&);
+
+    void printStats(const context&);
+}
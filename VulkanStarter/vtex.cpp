@@ -0,0 +1,780 @@
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <algorithm>
+#include <cstring>
+
+#include "vtex.h"
+#include "mipgen.h"
+
+using namespace vtex;
+
+namespace
+{
+    const uint32_t FILE_VERSION = 1;
+    const VkDeviceSize PAGE_BYTES = static_cast<VkDeviceSize>(PAGE_SLOT) * PAGE_SLOT * 4;
+
+    uint32_t levelExtent(uint32_t extent, uint32_t level)
+    {
+        return std::max(extent >> level, 1u);
+    }
+
+    uint32_t pageCount(uint32_t extent)
+    {
+        return (extent + PAGE_SIZE - 1) / PAGE_SIZE;
+    }
+
+    // Levels down to the first one that fits in a single page
+    uint32_t levelCount(uint32_t width, uint32_t height)
+    {
+        uint32_t levels = 1;
+        while (std::max(levelExtent(width, levels - 1), levelExtent(height, levels - 1)) > PAGE_SIZE) {
+            levels++;
+        }
+        return levels;
+    }
+
+    // Pages follow the header level by level, each level in row order
+    uint64_t pageOffset(const fileHeader& header, uint32_t level, uint32_t x, uint32_t y)
+    {
+        uint64_t index = 0;
+        for (uint32_t previous = 0; previous < level; previous++) {
+            index += static_cast<uint64_t>(pageCount(levelExtent(header.width, previous))) * pageCount(levelExtent(header.height, previous));
+        }
+        index += static_cast<uint64_t>(y) * pageCount(levelExtent(header.width, level)) + x;
+
+        return sizeof(fileHeader) + index * PAGE_BYTES;
+    }
+
+    // First feedback entry of a level within a texture's entries, the levels are laid out like the page table mips
+    uint32_t feedbackOffset(uint32_t level)
+    {
+        uint32_t offset = 0;
+        for (uint32_t previous = 0; previous < level; previous++) {
+            offset += (PAGE_TABLE_SIZE >> previous) * (PAGE_TABLE_SIZE >> previous);
+        }
+        return offset;
+    }
+
+    uint32_t addressTexel(int64_t coordinate, uint32_t extent, bool repeat)
+    {
+        if (repeat) {
+            int64_t wrapped = coordinate % extent;
+            return static_cast<uint32_t>(wrapped < 0 ? wrapped + extent : wrapped);
+        }
+        return static_cast<uint32_t>(std::min<int64_t>(std::max<int64_t>(coordinate, 0), extent - 1));
+    }
+
+    void readLoop(pager* virtualPager)
+    {
+        std::map<std::string, std::ifstream> files;
+
+        for (;;) {
+            pageRequest request;
+            {
+                std::unique_lock<std::mutex> lock(virtualPager->mutex);
+                virtualPager->wake.wait(lock, [virtualPager]() { return virtualPager->stopping || !virtualPager->requests.empty(); });
+                if (virtualPager->stopping) {
+                    return;
+                }
+                request = std::move(virtualPager->requests.front());
+                virtualPager->requests.pop_front();
+            }
+
+            std::ifstream& file = files[request.path];
+            if (!file.is_open()) {
+                file.open(request.path, std::ios::binary);
+            }
+
+            loadedPage result;
+            result.key = request.key;
+            result.texels.resize(static_cast<size_t>(PAGE_BYTES));
+            file.seekg(static_cast<std::streamoff>(request.offset));
+            file.read(reinterpret_cast<char*>(result.texels.data()), static_cast<std::streamsize>(PAGE_BYTES));
+            if (!file) {
+                result.error = "failed to read page from " + request.path;
+                file.clear();
+            }
+
+            std::lock_guard<std::mutex> lock(virtualPager->mutex);
+            virtualPager->finished.push_back(std::move(result));
+        }
+    }
+
+    void requestPage(pager& virtualPager, const page& key)
+    {
+        virtualTexture& texture = virtualPager.textures[key.texture];
+        texture.pending[key.level][key.y * texture.columns[key.level] + key.x] = 1;
+        virtualPager.pendingCount++;
+
+        pageRequest request;
+        request.key = key;
+        request.path = texture.path;
+        request.offset = pageOffset(texture.header, key.level, key.x, key.y);
+        {
+            std::lock_guard<std::mutex> lock(virtualPager.mutex);
+            virtualPager.requests.push_back(std::move(request));
+        }
+        virtualPager.wake.notify_one();
+    }
+
+    // Marks the page, or the ancestor the shader fell back to, as used this frame and collects the missing pages on the way
+    void markWanted(pager& virtualPager, uint32_t textureIndex, uint32_t level, uint32_t x, uint32_t y)
+    {
+        virtualTexture& texture = virtualPager.textures[textureIndex];
+
+        for (; level < texture.header.levels; level++, x /= 2, y /= 2) {
+            x = std::min(x, texture.columns[level] - 1);
+            y = std::min(y, texture.rows[level] - 1);
+            uint32_t index = y * texture.columns[level] + x;
+
+            int32_t slot = texture.slots[level][index];
+            if (slot >= 0) {
+                virtualPager.slots[slot].lastUsedFrame = virtualPager.frame;
+                return;
+            }
+            if (!texture.pending[level][index]) {
+                virtualPager.wanted.push_back({ textureIndex, level, x, y, false });
+            }
+        }
+    }
+
+    // A free slot, or the least recently used one not needed this frame, -1 when every slot is in use
+    int32_t allocateSlot(pager& virtualPager)
+    {
+        int32_t victim = -1;
+        for (uint32_t i = 0; i < virtualPager.slots.size(); i++) {
+            const cacheSlot& candidate = virtualPager.slots[i];
+            if (candidate.texture < 0) {
+                return static_cast<int32_t>(i);
+            }
+            if (candidate.pinned || candidate.lastUsedFrame >= virtualPager.frame) {
+                continue;
+            }
+            if (victim < 0 || candidate.lastUsedFrame < virtualPager.slots[victim].lastUsedFrame) {
+                victim = static_cast<int32_t>(i);
+            }
+        }
+
+        if (victim >= 0) {
+            cacheSlot& evicted = virtualPager.slots[victim];
+            virtualTexture& texture = virtualPager.textures[evicted.texture];
+            texture.slots[evicted.level][evicted.y * texture.columns[evicted.level] + evicted.x] = -1;
+            texture.dirty = true;
+            evicted.texture = -1;
+            virtualPager.pagesEvicted++;
+        }
+        return victim;
+    }
+
+    // Entries point at the page's own slot, or inherit the entry of the page one level down that covers it
+    void rebuildEntries(const pager& virtualPager, virtualTexture& texture)
+    {
+        for (uint32_t level = texture.header.levels; level-- > 0;) {
+            for (uint32_t y = 0; y < texture.rows[level]; y++) {
+                for (uint32_t x = 0; x < texture.columns[level]; x++) {
+                    uint32_t index = y * texture.columns[level] + x;
+                    int32_t slot = texture.slots[level][index];
+
+                    uint32_t entry = 0;
+                    if (slot >= 0) {
+                        uint32_t slotX = static_cast<uint32_t>(slot) % virtualPager.slotsPerSide;
+                        uint32_t slotY = static_cast<uint32_t>(slot) / virtualPager.slotsPerSide;
+                        entry = slotX | (slotY << 8) | (level << 16) | (1u << 24);
+                    }
+                    else if (level + 1 < texture.header.levels) {
+                        uint32_t parentX = std::min(x / 2, texture.columns[level + 1] - 1);
+                        uint32_t parentY = std::min(y / 2, texture.rows[level + 1] - 1);
+                        entry = texture.entries[level + 1][parentY * texture.columns[level + 1] + parentX];
+                    }
+                    texture.entries[level][index] = entry;
+                }
+            }
+        }
+        texture.dirty = false;
+    }
+
+    // The cache and the page table are sampled by frames still in flight, every update waits for them in queue order
+    void recordImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+        VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, uint32_t mipLevels, uint32_t layers)
+    {
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = mipLevels;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = layers;
+        barrier.srcAccessMask = srcAccessMask;
+        barrier.dstAccessMask = dstAccessMask;
+
+        vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+
+    void recordCopies(VkCommandBuffer commandBuffer, VkImage image, VkBuffer staging, const std::vector<VkBufferImageCopy>& regions, uint32_t mipLevels, uint32_t layers)
+    {
+        recordImageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, mipLevels, layers);
+        vkCmdCopyBufferToImage(commandBuffer, staging, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+        recordImageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, mipLevels, layers);
+    }
+
+    // Clears a new image to zero and leaves it ready for sampling, a zero page table entry means not resident
+    void recordClear(VkCommandBuffer commandBuffer, VkImage image, uint32_t mipLevels, uint32_t layers)
+    {
+        recordImageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, mipLevels, layers);
+
+        VkClearColorValue clearColor = {};
+        VkImageSubresourceRange range = {};
+        range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        range.baseMipLevel = 0;
+        range.levelCount = mipLevels;
+        range.baseArrayLayer = 0;
+        range.layerCount = layers;
+        vkCmdClearColorImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColor, 1, &range);
+
+        recordImageBarrier(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, mipLevels, layers);
+    }
+
+    VkImage createImage(pager& virtualPager, VkFormat format, uint32_t size, uint32_t mipLevels, uint32_t layers, VkImageCreateFlags flags, memalloc::allocation& memory)
+    {
+        VkImageCreateInfo imageInfo = {};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.flags = flags;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent = { size, size, 1 };
+        imageInfo.mipLevels = mipLevels;
+        imageInfo.arrayLayers = layers;
+        imageInfo.format = format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VkImage image;
+        if (vkCreateImage(virtualPager.device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create virtual texture image!");
+        }
+
+        memory = memalloc::allocateForImage(*virtualPager.memoryAllocator, image, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        return image;
+    }
+
+    VkImageView createView(pager& virtualPager, VkImage image, VkImageViewType viewType, VkFormat format, uint32_t mipLevels, uint32_t layers)
+    {
+        VkImageViewCreateInfo viewInfo = {};
+        viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        viewInfo.image = image;
+        viewInfo.viewType = viewType;
+        viewInfo.format = format;
+        viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        viewInfo.subresourceRange.baseMipLevel = 0;
+        viewInfo.subresourceRange.levelCount = mipLevels;
+        viewInfo.subresourceRange.baseArrayLayer = 0;
+        viewInfo.subresourceRange.layerCount = layers;
+
+        VkImageView view;
+        if (vkCreateImageView(virtualPager.device, &viewInfo, nullptr, &view) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create virtual texture image view!");
+        }
+        return view;
+    }
+
+    VkSampler createSampler(pager& virtualPager, VkFilter filter, float maxLod)
+    {
+        VkSamplerCreateInfo samplerInfo = {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = filter;
+        samplerInfo.minFilter = filter;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.anisotropyEnable = VK_FALSE;
+        samplerInfo.maxAnisotropy = 1.0f;
+        samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+        samplerInfo.unnormalizedCoordinates = VK_FALSE;
+        samplerInfo.compareEnable = VK_FALSE;
+        samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.minLod = 0.0f;
+        samplerInfo.maxLod = maxLod;
+        samplerInfo.mipLodBias = 0.0f;
+
+        VkSampler sampler;
+        if (vkCreateSampler(virtualPager.device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create virtual texture sampler!");
+        }
+        return sampler;
+    }
+
+    void destroyFeedback(pager& virtualPager)
+    {
+        for (auto& buffer : virtualPager.feedback) {
+            vkDestroyBuffer(virtualPager.device, buffer.buffer, nullptr);
+            memalloc::free(*virtualPager.memoryAllocator, buffer.memory);
+        }
+        virtualPager.feedback.clear();
+    }
+}
+
+void vtex::tile(const std::string& path, uint32_t width, uint32_t height, bool srgb, bool repeat, const regionProducer& produce)
+{
+    if (width == 0 || height == 0 || width > PAGE_TABLE_SIZE * PAGE_SIZE || height > PAGE_TABLE_SIZE * PAGE_SIZE) {
+        throw std::runtime_error("virtual texture size is out of range!");
+    }
+
+    fileHeader header = {};
+    memcpy(header.magic, "VTEX", 4);
+    header.version = FILE_VERSION;
+    header.width = width;
+    header.height = height;
+    header.pageSize = PAGE_SIZE;
+    header.border = PAGE_BORDER;
+    header.levels = levelCount(width, height);
+    header.srgb = srgb ? 1 : 0;
+    header.repeat = repeat ? 1 : 0;
+
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file) {
+        throw std::runtime_error("failed to create virtual texture file " + path + "!");
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<uint8_t> pageTexels(static_cast<size_t>(PAGE_BYTES));
+
+    for (uint32_t level = 0; level < header.levels; level++) {
+        uint32_t levelWidth = levelExtent(width, level);
+        uint32_t levelHeight = levelExtent(height, level);
+        uint32_t columns = pageCount(levelWidth);
+        uint32_t rows = pageCount(levelHeight);
+
+        //a strip is one row of pages without borders, level 0 strips come from the producer and the others are filtered
+        //from the interiors of the two strips above them, read back from the file
+        auto makeStrip = [&](uint32_t row) {
+            uint32_t stripHeight = std::min(PAGE_SIZE, levelHeight - row * PAGE_SIZE);
+            std::vector<uint8_t> strip(static_cast<size_t>(levelWidth) * stripHeight * 4);
+            if (level == 0) {
+                produce(0, row * PAGE_SIZE, levelWidth, stripHeight, strip.data());
+                return strip;
+            }
+
+            uint32_t sourceWidth = levelExtent(width, level - 1);
+            uint32_t sourceHeight = levelExtent(height, level - 1);
+            uint32_t firstRow = row * 2;
+            uint32_t lastRow = std::min(firstRow + 2, pageCount(sourceHeight));
+            uint32_t sourceStripHeight = std::min(2 * PAGE_SIZE, sourceHeight - firstRow * PAGE_SIZE);
+            std::vector<uint8_t> source(static_cast<size_t>(sourceWidth) * sourceStripHeight * 4);
+
+            for (uint32_t sourceRow = firstRow; sourceRow < lastRow; sourceRow++) {
+                for (uint32_t column = 0; column < pageCount(sourceWidth); column++) {
+                    file.seekg(static_cast<std::streamoff>(pageOffset(header, level - 1, column, sourceRow)));
+                    file.read(reinterpret_cast<char*>(pageTexels.data()), static_cast<std::streamsize>(PAGE_BYTES));
+
+                    uint32_t pageWidth = std::min(PAGE_SIZE, sourceWidth - column * PAGE_SIZE);
+                    uint32_t pageHeight = std::min(PAGE_SIZE, sourceHeight - sourceRow * PAGE_SIZE);
+                    for (uint32_t y = 0; y < pageHeight; y++) {
+                        size_t destination = (static_cast<size_t>((sourceRow - firstRow) * PAGE_SIZE + y) * sourceWidth + column * PAGE_SIZE) * 4;
+                        size_t interior = (static_cast<size_t>(y + PAGE_BORDER) * PAGE_SLOT + PAGE_BORDER) * 4;
+                        memcpy(&source[destination], &pageTexels[interior], pageWidth * 4);
+                    }
+                }
+            }
+
+            mipgen::downsample(source.data(), sourceWidth, sourceStripHeight, strip.data(), srgb);
+            return strip;
+        };
+
+        //borders reach into the neighbouring strips, or around to the opposite edge of a repeating texture
+        std::vector<uint8_t> above;
+        std::vector<uint8_t> current = makeStrip(0);
+        std::vector<uint8_t> below;
+        std::vector<uint8_t> first = repeat ? current : std::vector<uint8_t>();
+        std::vector<uint8_t> last = (repeat && rows > 1) ? makeStrip(rows - 1) : std::vector<uint8_t>();
+
+        for (uint32_t row = 0; row < rows; row++) {
+            below = (row + 1 < rows) ? makeStrip(row + 1) : std::vector<uint8_t>();
+
+            auto stripOf = [&](uint32_t stripRow) -> const std::vector<uint8_t>& {
+                if (stripRow == row) {
+                    return current;
+                }
+                if (stripRow + 1 == row) {
+                    return above;
+                }
+                if (stripRow == row + 1) {
+                    return below;
+                }
+                return stripRow == 0 ? first : last;
+            };
+
+            for (uint32_t column = 0; column < columns; column++) {
+                for (uint32_t y = 0; y < PAGE_SLOT; y++) {
+                    uint32_t texelY = addressTexel(static_cast<int64_t>(row) * PAGE_SIZE + y - PAGE_BORDER, levelHeight, repeat);
+                    const std::vector<uint8_t>& strip = stripOf(texelY / PAGE_SIZE);
+                    const uint8_t* stripRow = &strip[static_cast<size_t>(texelY % PAGE_SIZE) * levelWidth * 4];
+
+                    for (uint32_t x = 0; x < PAGE_SLOT; x++) {
+                        uint32_t texelX = addressTexel(static_cast<int64_t>(column) * PAGE_SIZE + x - PAGE_BORDER, levelWidth, repeat);
+                        memcpy(&pageTexels[(static_cast<size_t>(y) * PAGE_SLOT + x) * 4], stripRow + static_cast<size_t>(texelX) * 4, 4);
+                    }
+                }
+
+                file.seekp(static_cast<std::streamoff>(pageOffset(header, level, column, row)));
+                file.write(reinterpret_cast<const char*>(pageTexels.data()), static_cast<std::streamsize>(PAGE_BYTES));
+            }
+
+            above = std::move(current);
+            current = std::move(below);
+        }
+    }
+
+    file.flush();
+    if (!file) {
+        throw std::runtime_error("failed to write virtual texture file " + path + "!");
+    }
+}
+
+bool vtex::readHeader(const std::string& path, fileHeader& header)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        return false;
+    }
+
+    return memcmp(header.magic, "VTEX", 4) == 0 && header.version == FILE_VERSION && header.pageSize == PAGE_SIZE && header.border == PAGE_BORDER
+        && header.levels == levelCount(header.width, header.height) && header.width <= PAGE_TABLE_SIZE * PAGE_SIZE && header.height <= PAGE_TABLE_SIZE * PAGE_SIZE;
+}
+
+void vtex::init(pager& virtualPager, VkDevice device, memalloc::allocator& memoryAllocator, upload::context& uploadContext, uint32_t slotsPerSide)
+{
+    virtualPager.device = device;
+    virtualPager.memoryAllocator = &memoryAllocator;
+    virtualPager.uploadContext = &uploadContext;
+    virtualPager.slotsPerSide = slotsPerSide;
+    virtualPager.slots.assign(static_cast<size_t>(slotsPerSide) * slotsPerSide, cacheSlot());
+    virtualPager.stopping = false;
+
+    //pages are stored as they were authored, colour maps are decoded by the sRGB view
+    virtualPager.cacheImage = createImage(virtualPager, VK_FORMAT_R8G8B8A8_UNORM, slotsPerSide * PAGE_SLOT, 1, 1, VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT, virtualPager.cacheMemory);
+    virtualPager.cacheViews[0] = createView(virtualPager, virtualPager.cacheImage, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8G8B8A8_UNORM, 1, 1);
+    virtualPager.cacheViews[1] = createView(virtualPager, virtualPager.cacheImage, VK_IMAGE_VIEW_TYPE_2D, VK_FORMAT_R8G8B8A8_SRGB, 1, 1);
+    virtualPager.cacheSampler = createSampler(virtualPager, VK_FILTER_LINEAR, 0.0f);
+
+    virtualPager.pageTableImage = createImage(virtualPager, VK_FORMAT_R8G8B8A8_UINT, PAGE_TABLE_SIZE, PAGE_TABLE_LEVELS, MAX_VIRTUAL_TEXTURES, 0, virtualPager.pageTableMemory);
+    virtualPager.pageTableView = createView(virtualPager, virtualPager.pageTableImage, VK_IMAGE_VIEW_TYPE_2D_ARRAY, VK_FORMAT_R8G8B8A8_UINT, PAGE_TABLE_LEVELS, MAX_VIRTUAL_TEXTURES);
+    virtualPager.pageTableSampler = createSampler(virtualPager, VK_FILTER_NEAREST, static_cast<float>(PAGE_TABLE_LEVELS));
+
+    VkCommandBuffer commandBuffer = upload::commands(uploadContext);
+    recordClear(commandBuffer, virtualPager.cacheImage, 1, 1);
+    recordClear(commandBuffer, virtualPager.pageTableImage, PAGE_TABLE_LEVELS, MAX_VIRTUAL_TEXTURES);
+
+    virtualPager.worker = std::thread(readLoop, &virtualPager);
+}
+
+void vtex::destroy(pager& virtualPager)
+{
+    {
+        std::lock_guard<std::mutex> lock(virtualPager.mutex);
+        virtualPager.stopping = true;
+    }
+    virtualPager.wake.notify_all();
+    if (virtualPager.worker.joinable()) {
+        virtualPager.worker.join();
+    }
+
+    destroyFeedback(virtualPager);
+
+    vkDestroySampler(virtualPager.device, virtualPager.cacheSampler, nullptr);
+    vkDestroyImageView(virtualPager.device, virtualPager.cacheViews[0], nullptr);
+    vkDestroyImageView(virtualPager.device, virtualPager.cacheViews[1], nullptr);
+    vkDestroyImage(virtualPager.device, virtualPager.cacheImage, nullptr);
+    memalloc::free(*virtualPager.memoryAllocator, virtualPager.cacheMemory);
+
+    vkDestroySampler(virtualPager.device, virtualPager.pageTableSampler, nullptr);
+    vkDestroyImageView(virtualPager.device, virtualPager.pageTableView, nullptr);
+    vkDestroyImage(virtualPager.device, virtualPager.pageTableImage, nullptr);
+    memalloc::free(*virtualPager.memoryAllocator, virtualPager.pageTableMemory);
+
+    virtualPager.textures.clear();
+    virtualPager.slots.clear();
+    virtualPager.wanted.clear();
+    virtualPager.requests.clear();
+    virtualPager.finished.clear();
+    virtualPager.pendingCount = 0;
+}
+
+uint32_t vtex::add(pager& virtualPager, const std::string& path)
+{
+    if (virtualPager.textures.size() >= MAX_VIRTUAL_TEXTURES) {
+        throw std::runtime_error("too many virtual textures!");
+    }
+
+    virtualTexture texture;
+    texture.path = path;
+    if (!readHeader(path, texture.header)) {
+        throw std::runtime_error("failed to open virtual texture " + path + "!");
+    }
+
+    for (uint32_t level = 0; level < texture.header.levels; level++) {
+        uint32_t columns = pageCount(levelExtent(texture.header.width, level));
+        uint32_t rows = pageCount(levelExtent(texture.header.height, level));
+        texture.columns.push_back(columns);
+        texture.rows.push_back(rows);
+        texture.slots.emplace_back(static_cast<size_t>(columns) * rows, -1);
+        texture.pending.emplace_back(static_cast<size_t>(columns) * rows, 0);
+        texture.entries.emplace_back(static_cast<size_t>(columns) * rows, 0);
+    }
+
+    uint32_t id = static_cast<uint32_t>(virtualPager.textures.size());
+    uint32_t coarsest = texture.header.levels - 1;
+    virtualPager.textures.push_back(std::move(texture));
+
+    //the single page of the coarsest level is every other page's last fallback
+    requestPage(virtualPager, { id, coarsest, 0, 0, true });
+
+    return id;
+}
+
+const fileHeader& vtex::header(const pager& virtualPager, uint32_t texture)
+{
+    return virtualPager.textures[texture].header;
+}
+
+void vtex::resetFeedback(pager& virtualPager, uint32_t imageCount)
+{
+    destroyFeedback(virtualPager);
+
+    VkDeviceSize size = static_cast<VkDeviceSize>(MAX_VIRTUAL_TEXTURES) * FEEDBACK_ENTRIES * sizeof(uint32_t);
+    virtualPager.feedback.resize(imageCount);
+    for (auto& buffer : virtualPager.feedback) {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(virtualPager.device, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create virtual texture feedback buffer!");
+        }
+
+        buffer.memory = memalloc::allocateForBuffer(*virtualPager.memoryAllocator, buffer.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        memset(buffer.memory.mapped, 0, static_cast<size_t>(size));
+    }
+}
+
+void vtex::readFeedback(pager& virtualPager, uint32_t imageIndex)
+{
+    uint32_t* marks = static_cast<uint32_t*>(virtualPager.feedback[imageIndex].memory.mapped);
+
+    for (uint32_t textureIndex = 0; textureIndex < virtualPager.textures.size(); textureIndex++) {
+        const virtualTexture& texture = virtualPager.textures[textureIndex];
+
+        for (uint32_t level = 0; level < texture.header.levels; level++) {
+            uint32_t* levelMarks = marks + textureIndex * FEEDBACK_ENTRIES + feedbackOffset(level);
+            uint32_t stride = PAGE_TABLE_SIZE >> level;
+
+            for (uint32_t y = 0; y < texture.rows[level]; y++) {
+                for (uint32_t x = 0; x < texture.columns[level]; x++) {
+                    uint32_t& mark = levelMarks[y * stride + x];
+                    if (mark == 0) {
+                        continue;
+                    }
+                    mark = 0;
+                    markWanted(virtualPager, textureIndex, level, x, y);
+                }
+            }
+        }
+    }
+}
+
+void vtex::update(pager& virtualPager)
+{
+    std::vector<loadedPage> finished;
+    {
+        std::lock_guard<std::mutex> lock(virtualPager.mutex);
+        finished.swap(virtualPager.finished);
+
+        //pages over this frame's copy budget wait for the next update
+        if (finished.size() > PAGE_UPLOADS_PER_FRAME) {
+            virtualPager.finished.insert(virtualPager.finished.end(), std::make_move_iterator(finished.begin() + PAGE_UPLOADS_PER_FRAME), std::make_move_iterator(finished.end()));
+            finished.resize(PAGE_UPLOADS_PER_FRAME);
+        }
+    }
+
+    if (!finished.empty()) {
+        VkBuffer stagingBuffer;
+        VkDeviceSize stagingOffset;
+        uint8_t* staged = static_cast<uint8_t*>(upload::stage(*virtualPager.uploadContext, PAGE_BYTES * finished.size(), stagingBuffer, stagingOffset));
+
+        std::vector<VkBufferImageCopy> regions;
+        for (auto& loaded : finished) {
+            if (!loaded.error.empty()) {
+                throw std::runtime_error("failed to load virtual texture page: " + loaded.error);
+            }
+
+            const page& key = loaded.key;
+            virtualTexture& texture = virtualPager.textures[key.texture];
+            uint32_t index = key.y * texture.columns[key.level] + key.x;
+            texture.pending[key.level][index] = 0;
+            virtualPager.pendingCount--;
+
+            int32_t slot = allocateSlot(virtualPager);
+            if (slot < 0) {
+                virtualPager.pagesDropped++;
+                continue;
+            }
+
+            cacheSlot& target = virtualPager.slots[slot];
+            target.texture = static_cast<int32_t>(key.texture);
+            target.level = key.level;
+            target.x = key.x;
+            target.y = key.y;
+            target.lastUsedFrame = virtualPager.frame;
+            target.pinned = key.pinned;
+            texture.slots[key.level][index] = slot;
+            texture.dirty = true;
+
+            VkDeviceSize offset = PAGE_BYTES * regions.size();
+            memcpy(staged + offset, loaded.texels.data(), static_cast<size_t>(PAGE_BYTES));
+
+            VkBufferImageCopy region = {};
+            region.bufferOffset = stagingOffset + offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = 0;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { static_cast<int32_t>((slot % virtualPager.slotsPerSide) * PAGE_SLOT), static_cast<int32_t>((slot / virtualPager.slotsPerSide) * PAGE_SLOT), 0 };
+            region.imageExtent = { PAGE_SLOT, PAGE_SLOT, 1 };
+            regions.push_back(region);
+
+            virtualPager.pagesLoaded++;
+        }
+
+        if (!regions.empty()) {
+            recordCopies(upload::commands(*virtualPager.uploadContext), virtualPager.cacheImage, stagingBuffer, regions, 1, 1);
+        }
+    }
+
+    //coarse pages first, they are small in number and replace the blurriest fallbacks
+    std::stable_sort(virtualPager.wanted.begin(), virtualPager.wanted.end(), [](const page& a, const page& b) {
+        return a.level > b.level;
+    });
+    for (const auto& key : virtualPager.wanted) {
+        if (virtualPager.pendingCount >= MAX_PENDING_PAGES) {
+            break;
+        }
+        const virtualTexture& texture = virtualPager.textures[key.texture];
+        uint32_t index = key.y * texture.columns[key.level] + key.x;
+        if (texture.pending[key.level][index] || texture.slots[key.level][index] >= 0) {
+            continue;
+        }
+        requestPage(virtualPager, key);
+    }
+    virtualPager.wanted.clear(); //anything skipped is reported again by the next feedback
+
+    std::vector<VkBufferImageCopy> tableRegions;
+    std::vector<const virtualTexture*> uploaded;
+    VkDeviceSize tableBytes = 0;
+    for (auto& texture : virtualPager.textures) {
+        if (texture.dirty) {
+            rebuildEntries(virtualPager, texture);
+            for (const auto& level : texture.entries) {
+                tableBytes += level.size() * sizeof(uint32_t);
+            }
+            uploaded.push_back(&texture);
+        }
+    }
+
+    if (tableBytes != 0) {
+        VkBuffer stagingBuffer;
+        VkDeviceSize stagingOffset;
+        uint8_t* staged = static_cast<uint8_t*>(upload::stage(*virtualPager.uploadContext, tableBytes, stagingBuffer, stagingOffset));
+
+        VkDeviceSize offset = 0;
+        for (const virtualTexture* texture : uploaded) {
+            uint32_t layer = static_cast<uint32_t>(texture - virtualPager.textures.data());
+            for (uint32_t level = 0; level < texture->header.levels; level++) {
+                VkDeviceSize bytes = texture->entries[level].size() * sizeof(uint32_t);
+                memcpy(staged + offset, texture->entries[level].data(), static_cast<size_t>(bytes));
+
+                VkBufferImageCopy region = {};
+                region.bufferOffset = stagingOffset + offset;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = level;
+                region.imageSubresource.baseArrayLayer = layer;
+                region.imageSubresource.layerCount = 1;
+                region.imageOffset = { 0, 0, 0 };
+                region.imageExtent = { texture->columns[level], texture->rows[level], 1 };
+                tableRegions.push_back(region);
+
+                offset += bytes;
+            }
+        }
+
+        recordCopies(upload::commands(*virtualPager.uploadContext), virtualPager.pageTableImage, stagingBuffer, tableRegions, PAGE_TABLE_LEVELS, MAX_VIRTUAL_TEXTURES);
+    }
+
+    upload::submit(*virtualPager.uploadContext);
+
+    virtualPager.frame++;
+}
+
+void vtex::recordFeedbackBarrier(VkCommandBuffer commandBuffer)
+{
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+VkDescriptorImageInfo vtex::pageTableInfo(const pager& virtualPager)
+{
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = virtualPager.pageTableView;
+    imageInfo.sampler = virtualPager.pageTableSampler;
+    return imageInfo;
+}
+
+void vtex::cacheInfos(const pager& virtualPager, VkDescriptorImageInfo* imageInfos)
+{
+    for (uint32_t i = 0; i < 2; i++) {
+        imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfos[i].imageView = virtualPager.cacheViews[i];
+        imageInfos[i].sampler = virtualPager.cacheSampler;
+    }
+}
+
+VkDescriptorBufferInfo vtex::feedbackInfo(const pager& virtualPager, uint32_t imageIndex)
+{
+    VkDescriptorBufferInfo bufferInfo = {};
+    bufferInfo.buffer = virtualPager.feedback[imageIndex].buffer;
+    bufferInfo.offset = 0;
+    bufferInfo.range = VK_WHOLE_SIZE;
+    return bufferInfo;
+}
+
+void vtex::printStats(const pager& virtualPager)
+{
+    uint32_t resident = 0;
+    for (const auto& slot : virtualPager.slots) {
+        if (slot.texture >= 0) {
+            resident++;
+        }
+    }
+
+    std::cout << "virtual texturing: " << resident << " of " << virtualPager.slots.size() << " cache slots resident, " << virtualPager.pagesLoaded << " pages loaded, "
+        << virtualPager.pagesEvicted << " evicted, " << virtualPager.pagesDropped << " dropped" << std::endl;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "memalloc.h"
+#include "upload.h"
+
+// Software virtual texturing for maps too large to keep resident. A tiled file stores every mip level cut into
+// PAGE_SIZE pages, each with a PAGE_BORDER texel border for filtering, and only pages recently seen on screen live in
+// a physical page cache texture of PAGE_SLOT sized slots. Every virtual texture owns a layer of the page table image,
+// whose mips match the page grids of its levels. An entry holds the cache slot of that page, or of its closest
+// resident ancestor while the page is missing, so shaders translate addresses themselves and no sparse binding is needed.
+// Shaders also mark the pages they wanted in a feedback buffer per swap chain image. Once that image's last frame
+// has completed the marks are read back, missing pages are read from the file by a worker thread and copied into the
+// least recently used slots. The coarsest level of each texture is a single page that stays resident.
+namespace vtex
+{
+    const uint32_t PAGE_SIZE = 120;                 // texels of a page, without its border
+    const uint32_t PAGE_BORDER = 4;
+    const uint32_t PAGE_SLOT = PAGE_SIZE + 2 * PAGE_BORDER;
+    const uint32_t PAGE_TABLE_SIZE = 256;           // pages across level 0, virtual textures are at most PAGE_TABLE_SIZE * PAGE_SIZE texels wide
+    const uint32_t PAGE_TABLE_LEVELS = 9;           // down to a 1x1 page table
+    const uint32_t MAX_VIRTUAL_TEXTURES = 4;        // page table layers, the shaders declare the same counts
+    const uint32_t FEEDBACK_ENTRIES = 87381;        // one per page table texel of a layer, every level
+    const uint32_t MAX_PENDING_PAGES = 64;          // page reads queued to the worker at once
+    const uint32_t PAGE_UPLOADS_PER_FRAME = 16;     // bounds the copy time of a frame at 1 MB
+
+    // Fills width x height RGBA8 texels of level 0 starting at x, y.
+    typedef std::function<void(uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint8_t* rgba)> regionProducer;
+
+    struct fileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t pageSize;
+        uint32_t border;
+        uint32_t levels;                            // the last level fits in one page
+        uint32_t srgb;
+        uint32_t repeat;                            // borders wrap around the edges instead of clamping
+    };
+
+    struct page
+    {
+        uint32_t texture;
+        uint32_t level;
+        uint32_t x;
+        uint32_t y;
+        bool pinned;
+    };
+
+    struct pageRequest
+    {
+        page key;
+        std::string path;
+        uint64_t offset;                            // of the page in the file
+    };
+
+    struct loadedPage
+    {
+        page key;
+        std::vector<uint8_t> texels;                // PAGE_SLOT * PAGE_SLOT RGBA8 texels, border included
+        std::string error;
+    };
+
+    struct virtualTexture
+    {
+        std::string path;
+        fileHeader header;
+        std::vector<uint32_t> columns;              // page grid of each level
+        std::vector<uint32_t> rows;
+        std::vector<std::vector<int32_t>> slots;    // cache slot of each page, -1 when it is not resident
+        std::vector<std::vector<uint8_t>> pending;  // page read queued or in flight
+        std::vector<std::vector<uint32_t>> entries; // page table contents, RGBA8_UINT: slot x, slot y, mapped level, valid
+        bool dirty = true;                          // entries changed since the last page table upload
+    };
+
+    struct cacheSlot
+    {
+        int32_t texture = -1;                       // -1 when free
+        uint32_t level = 0;
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint64_t lastUsedFrame = 0;
+        bool pinned = false;
+    };
+
+    struct feedbackBuffer
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        memalloc::allocation memory;
+    };
+
+    struct pager
+    {
+        VkDevice device = VK_NULL_HANDLE;
+        memalloc::allocator* memoryAllocator = nullptr;
+        upload::context* uploadContext = nullptr;
+        uint32_t slotsPerSide = 0;
+        uint64_t frame = 1;
+
+        VkImage cacheImage = VK_NULL_HANDLE;        // created mutable so colour maps read it through an sRGB view
+        memalloc::allocation cacheMemory;
+        VkImageView cacheViews[2] = {};             // UNORM, SRGB
+        VkSampler cacheSampler = VK_NULL_HANDLE;
+
+        VkImage pageTableImage = VK_NULL_HANDLE;
+        memalloc::allocation pageTableMemory;
+        VkImageView pageTableView = VK_NULL_HANDLE;
+        VkSampler pageTableSampler = VK_NULL_HANDLE;
+
+        std::vector<feedbackBuffer> feedback;       // one per swap chain image, host visible
+        std::vector<virtualTexture> textures;
+        std::vector<cacheSlot> slots;
+        std::vector<page> wanted;                   // missing pages reported by the last feedback read
+        uint32_t pendingCount = 0;                  // page reads queued or in flight
+        uint64_t pagesLoaded = 0;
+        uint64_t pagesEvicted = 0;
+        uint64_t pagesDropped = 0;                  // arrived while every slot was in use this frame
+
+        std::thread worker;
+        std::mutex mutex;                           // guards everything below
+        std::condition_variable wake;
+        bool stopping = false;
+        std::deque<pageRequest> requests;
+        std::vector<loadedPage> finished;
+    };
+
+    // Writes a tiled file for a width x height RGBA8 texture, level 0 comes from the producer a row of pages at a time
+    // and the levels below are filtered from the pages already written, so memory use stays a few rows of pages.
+    void tile(const std::string& path, uint32_t width, uint32_t height, bool srgb, bool repeat, const regionProducer&);
+
+    // Reads the header of a tiled file, false when it is missing or was written with other page dimensions.
+    bool readHeader(const std::string& path, fileHeader&);
+
+    // Creates the page cache with slotsPerSide * slotsPerSide slots, the page table and the samplers, and starts the worker.
+    void init(pager&, VkDevice, memalloc::allocator&, upload::context&, uint32_t slotsPerSide);
+
+    // Stops the worker and destroys everything, the device must be idle.
+    void destroy(pager&);
+
+    // Opens a tiled file as the next page table layer and queues its coarsest page. Returns the layer.
+    uint32_t add(pager&, const std::string& path);
+
+    const fileHeader& header(const pager&, uint32_t texture);
+
+    // Recreates the feedback buffers for imageCount swap chain images, cleared. The device must be idle.
+    void resetFeedback(pager&, uint32_t imageCount);
+
+    // Reads and clears the pages requested by the last frame rendered to this swap chain image, call once that frame has completed.
+    void readFeedback(pager&, uint32_t imageIndex);
+
+    // Copies finished pages into the cache, updates the page table, queues missing pages and submits the uploads.
+    void update(pager&);
+
+    // Makes this command buffer's feedback writes visible to the host once the submit completes, record it last.
+    void recordFeedbackBarrier(VkCommandBuffer);
+
+    VkDescriptorImageInfo pageTableInfo(const pager&);
+
+    // UNORM and SRGB views of the page cache, in that order.
+    void cacheInfos(const pager&, VkDescriptorImageInfo* imageInfos);
+
+    VkDescriptorBufferInfo feedbackInfo(const pager&, uint32_t imageIndex);
+
+    void printStats(const pager&);
+}